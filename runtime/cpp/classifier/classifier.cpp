@@ -46,12 +46,17 @@ int argmax(std::vector<T, A> const& vec) {
 template <typename T, typename A>
 std::vector<T, A> softmax(std::vector<T, A> const& vec) {
     std::vector<T, A> result;
+    result.reserve(vec.size());
     float m = -INFINITY;
     float sum = 0.0;
 
+    // exp is evaluated once per logit, then normalized in place
     for (const auto &val : vec) m = (val>m) ? val : m;
-    for (const auto &val : vec) sum += expf(val - m);
-    for (const auto &val : vec) result.push_back(expf(val-m)/sum);
+    for (const auto &val : vec) {
+        result.push_back(expf(val - m));
+        sum += result.back();
+    }
+    for (auto &val : result) val /= sum;
     
     return result;   
 }
@@ -0,0 +1,178 @@
+/**
+ * Mask decoding time: crop-first decoding (RoiMaskDecoder) of random boxes against the full-frame
+ * path it replaced.
+ *
+ * Random quantized prototypes (HWC, as the network writes them), random coefficients and random
+ * boxes for N detections. The full-frame path dequantizes the prototypes, walks them in HWC order
+ * once per detection with a scalar product, applies the sigmoid in a second pass, resizes every
+ * mask to the whole image and crops it to its box. Crop-first dequantizes and transposes once
+ * (included in its time) and decodes each box only, through the same kernel as the postprocess.
+ * Both outputs are compared inside the boxes and must agree within 1e-5; the run fails (exit
+ * code 1) otherwise.
+ *
+ * Usage: mask_gemm_bench [-iterations=N] [-proto=SIZE] [-features=K] [-image=WIDTHxHEIGHT] [-box=MAX_FRACTION]
+ **/
+#include "common/mask_gemm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+// Dequantize everything, then one detection at a time over the HWC prototypes, as decode_masks did
+// before the prototype transpose (minus the xtensor views, so the reference is faster than the old code)
+static void reference_masks(const std::vector<float> &coefficients, size_t count, const std::vector<uint8_t> &proto_raw,
+                            const common::QuantLut &lut, std::vector<float> &proto_hwc, size_t pixels, size_t features,
+                            std::vector<float> &masks)
+{
+    common::dequantize(proto_raw.data(), proto_hwc.data(), proto_raw.size(), lut);
+    for (size_t n = 0; n < count; n++) {
+        float *mask = masks.data() + n * pixels;
+        for (size_t p = 0; p < pixels; p++) {
+            float sum = 0.0f;
+            for (size_t k = 0; k < features; k++)
+                sum += coefficients[n * features + k] * proto_hwc[p * features + k];
+            mask[p] = sum;
+        }
+        for (size_t p = 0; p < pixels; p++)
+            mask[p] = 1.0f / (1.0f + std::exp(-mask[p]));
+    }
+}
+
+struct Box {
+    int x, y, width, height;
+};
+
+// Full-frame bilinear resize of a prototype-resolution mask, then everything outside the box zeroed
+static void full_frame_mask(const float *mask, int proto_width, int proto_height, int image_width, int image_height,
+                            const Box &box, std::vector<float> &out)
+{
+    for (int y = 0; y < image_height; y++) {
+        const auto row_tap = common::bilinear_tap(y, proto_height, image_height);
+        for (int x = 0; x < image_width; x++) {
+            const auto column_tap = common::bilinear_tap(x, proto_width, image_width);
+            const float *top = mask + row_tap.first * proto_width;
+            const float *bottom = mask + row_tap.second * proto_width;
+            const float upper = top[column_tap.first] + (top[column_tap.second] - top[column_tap.first]) * column_tap.weight;
+            const float lower = bottom[column_tap.first] + (bottom[column_tap.second] - bottom[column_tap.first]) * column_tap.weight;
+            out[size_t(y) * size_t(image_width) + size_t(x)] = upper + (lower - upper) * row_tap.weight;
+        }
+    }
+    for (int y = 0; y < image_height; y++)
+        for (int x = 0; x < image_width; x++)
+            if (x < box.x || x >= box.x + box.width || y < box.y || y >= box.y + box.height)
+                out[size_t(y) * size_t(image_width) + size_t(x)] = 0.0f;
+}
+
+template <typename Function>
+static double time_ms(size_t iterations, Function &&function)
+{
+    function();     // Warm up caches and buffers
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        function();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(iterations);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t iterations = std::stoul(get_option(argc, argv, "-iterations=", "20"));
+    const size_t size = std::stoul(get_option(argc, argv, "-proto=", "160"));
+    const size_t features = std::stoul(get_option(argc, argv, "-features=", "32"));
+    const size_t pixels = size * size;
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> raw(0, 255);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+
+    const common::QuantLut lut(0.02f, 128.0f);
+    std::vector<uint8_t> proto_raw(pixels * features);
+    for (auto &value : proto_raw)
+        value = static_cast<uint8_t>(raw(rng));
+    std::vector<float> proto_hwc(proto_raw.size());
+
+#if defined(__AVX2__)
+    const char *path = "AVX2";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const char *path = "NEON";
+#else
+    const char *path = "scalar";
+#endif
+    std::printf("Prototypes %zux%zux%zu, %s kernel, %zu iterations\n", size, size, features, path, iterations);
+
+    const std::string image = get_option(argc, argv, "-image=", "1920x1080");
+    const int image_width = std::stoi(image.substr(0, image.find('x')));
+    const int image_height = std::stoi(image.substr(image.find('x') + 1));
+    const float max_box = std::stof(get_option(argc, argv, "-box=", "0.3"));
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    std::printf("Masks resized to %dx%d, boxes up to %.0f%% of each side\n", image_width, image_height, double(max_box) * 100.0);
+    std::printf("%-6s %14s %14s %9s %12s %12s\n", "N", "full-frame ms", "crop-first ms", "speedup", "max error", "KiB/mask");
+
+    common::PrototypeMatrix prototypes;
+    common::RoiMaskDecoder decoder;
+    bool passed = true;
+    std::vector<float> full(size_t(image_width) * size_t(image_height));
+    for (size_t count : {1, 10, 50}) {
+        std::vector<float> coefficients(count * features);
+        for (auto &value : coefficients)
+            value = normal(rng);
+        std::vector<Box> boxes(count);
+        size_t box_pixels = 0;
+        for (auto &box : boxes) {
+            box.width = std::max(1, int(float(image_width) * max_box * uniform(rng)));
+            box.height = std::max(1, int(float(image_height) * max_box * uniform(rng)));
+            box.x = int(float(image_width - box.width) * uniform(rng));
+            box.y = int(float(image_height - box.height) * uniform(rng));
+            box_pixels += size_t(box.width) * size_t(box.height);
+        }
+
+        std::vector<float> masks(count * pixels);
+        const double full_frame = time_ms(iterations, [&] {
+            reference_masks(coefficients, count, proto_raw, lut, proto_hwc, pixels, features, masks);
+            for (size_t n = 0; n < count; n++)
+                full_frame_mask(masks.data() + n * pixels, int(size), int(size), image_width, image_height, boxes[n], full);
+        });
+
+        std::vector<std::vector<float>> roi_masks(count);
+        for (size_t n = 0; n < count; n++)
+            roi_masks[n].resize(size_t(boxes[n].width) * size_t(boxes[n].height));
+        const double crop_first = time_ms(iterations, [&] {
+            prototypes.load(proto_raw.data(), size, size, features, lut);
+            for (size_t n = 0; n < count; n++) {
+                const Box &box = boxes[n];
+                decoder.decode(coefficients.data() + n * features, prototypes, image_width, image_height,
+                               box.x, box.y, box.width, box.height, roi_masks[n].data());
+            }
+        });
+
+        float max_error = 0.0f;
+        for (size_t n = 0; n < count; n++) {
+            const Box &box = boxes[n];
+            full_frame_mask(masks.data() + n * pixels, int(size), int(size), image_width, image_height, box, full);
+            for (int y = 0; y < box.height; y++)
+                for (int x = 0; x < box.width; x++)
+                    max_error = std::max(max_error, std::fabs(roi_masks[n][size_t(y) * size_t(box.width) + size_t(x)] -
+                                                              full[size_t(box.y + y) * size_t(image_width) + size_t(box.x + x)]));
+        }
+        std::printf("%-6zu %14.3f %14.3f %8.1fx %12.2e %12.1f\n", count, full_frame, crop_first, full_frame / crop_first,
+                    double(max_error), double(box_pixels * sizeof(float)) / double(count) / 1024.0);
+        passed &= max_error <= 1e-5f;
+    }
+    if (!passed)
+        std::printf("FAILED: crop-first masks differ from the full-frame ones\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+/**
+ * Run-length mask encode, decode and IoU time against their dense equivalents.
+ *
+ * Every synthetic instance is an ellipse of mask probabilities with noise, filling a random box of
+ * the image. Encode is thresholding the box into an RleMask; decode expands it back to bytes; IoU
+ * is computed for every pair, from the runs and from dense full-frame byte masks. Round trips,
+ * export counts and IoUs are checked against the dense results.
+ *
+ * Usage: mask_rle_bench [-iterations=N] [-instances=N] [-image=WIDTHxHEIGHT] [-box=MAX_FRACTION]
+ **/
+#include "common/mask_rle.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+struct Instance {
+    int x, y, width, height;
+    std::vector<float> probabilities;   // Over the box
+    std::vector<uint8_t> dense;         // Thresholded over the whole image
+};
+
+template <typename Function>
+static double time_us(size_t iterations, Function &&function)
+{
+    function();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        function();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(iterations);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t iterations = std::stoul(get_option(argc, argv, "-iterations=", "20"));
+    const size_t count = std::stoul(get_option(argc, argv, "-instances=", "20"));
+    const std::string image = get_option(argc, argv, "-image=", "1920x1080");
+    const int image_width = std::stoi(image.substr(0, image.find('x')));
+    const int image_height = std::stoi(image.substr(image.find('x') + 1));
+    const float max_box = std::stof(get_option(argc, argv, "-box=", "0.4"));
+    const float threshold = 0.5f;
+    const size_t image_pixels = size_t(image_width) * size_t(image_height);
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.15f);
+
+    std::vector<Instance> instances(count);
+    size_t box_pixels = 0;
+    for (auto &instance : instances) {
+        instance.width = std::max(1, int(float(image_width) * max_box * uniform(rng)));
+        instance.height = std::max(1, int(float(image_height) * max_box * uniform(rng)));
+        instance.x = int(float(image_width - instance.width) * uniform(rng));
+        instance.y = int(float(image_height - instance.height) * uniform(rng));
+        box_pixels += size_t(instance.width) * size_t(instance.height);
+
+        instance.probabilities.resize(size_t(instance.width) * size_t(instance.height));
+        instance.dense.assign(image_pixels, 0);
+        for (int r = 0; r < instance.height; r++) {
+            for (int c = 0; c < instance.width; c++) {
+                const float dx = (float(c) + 0.5f) / float(instance.width) - 0.5f;
+                const float dy = (float(r) + 0.5f) / float(instance.height) - 0.5f;
+                const float value = 1.0f - 2.0f * std::sqrt(dx * dx + dy * dy) + 0.3f + noise(rng);
+                instance.probabilities[size_t(r) * size_t(instance.width) + size_t(c)] = value;
+                instance.dense[size_t(instance.y + r) * size_t(image_width) + size_t(instance.x + c)] = value > threshold;
+            }
+        }
+    }
+
+    std::vector<common::RleMask> masks(count);
+    std::vector<uint64_t> bits;
+    const double encode = time_us(iterations, [&] {
+        for (size_t i = 0; i < count; i++) {
+            const auto &instance = instances[i];
+            common::encode_mask(instance.probabilities.data(), instance.x, instance.y, instance.width, instance.height,
+                                threshold, masks[i], bits);
+        }
+    });
+
+    std::vector<uint8_t> decoded(box_pixels);
+    const double decode = time_us(iterations, [&] {
+        size_t offset = 0;
+        for (const auto &mask : masks) {
+            common::decode_mask(mask, decoded.data() + offset, size_t(mask.width));
+            offset += size_t(mask.width) * size_t(mask.height);
+        }
+    });
+
+    float rle_sum = 0.0f;
+    const double rle_iou = time_us(iterations, [&] {
+        rle_sum = 0.0f;
+        for (size_t i = 0; i < count; i++)
+            for (size_t j = i + 1; j < count; j++)
+                rle_sum += common::mask_iou(masks[i], masks[j]);
+    });
+
+    std::vector<float> dense_ious;
+    const double dense_iou = time_us(std::max<size_t>(1, iterations / 10), [&] {
+        dense_ious.clear();
+        for (size_t i = 0; i < count; i++) {
+            for (size_t j = i + 1; j < count; j++) {
+                uint64_t intersection = 0, union_area = 0;
+                for (size_t p = 0; p < image_pixels; p++) {
+                    intersection += instances[i].dense[p] & instances[j].dense[p];
+                    union_area += instances[i].dense[p] | instances[j].dense[p];
+                }
+                dense_ious.push_back(0 == union_area ? 0.0f : float(double(intersection) / double(union_area)));
+            }
+        }
+    });
+
+    // Checks: round trip, export counts and IoU against the dense masks
+    size_t errors = 0;
+    size_t offset = 0, rle_bytes = 0;
+    std::vector<uint32_t> counts;
+    for (size_t i = 0; i < count; i++) {
+        const auto &mask = masks[i];
+        const auto &instance = instances[i];
+        size_t area = 0;
+        for (int r = 0; r < mask.height; r++) {
+            for (int c = 0; c < mask.width; c++) {
+                const uint8_t expected = instance.dense[size_t(mask.y + r) * size_t(image_width) + size_t(mask.x + c)];
+                errors += decoded[offset + size_t(r) * size_t(mask.width) + size_t(c)] != expected;
+                area += expected;
+            }
+        }
+        errors += area != mask.area;
+        offset += size_t(mask.width) * size_t(mask.height);
+        rle_bytes += mask.runs.size() * sizeof(uint16_t) + mask.row_starts.size() * sizeof(uint32_t);
+
+        common::mask_counts(mask, counts);
+        size_t total = 0, foreground = 0;
+        for (size_t k = 0; k < counts.size(); k++) {
+            total += counts[k];
+            foreground += (k % 2) ? counts[k] : 0;
+        }
+        errors += total != size_t(mask.width) * size_t(mask.height) || foreground != mask.area;
+    }
+    float max_iou_error = 0.0f;
+    size_t pair = 0;
+    for (size_t i = 0; i < count; i++)
+        for (size_t j = i + 1; j < count; j++)
+            max_iou_error = std::max(max_iou_error, std::fabs(common::mask_iou(masks[i], masks[j]) - dense_ious[pair++]));
+
+    const size_t pairs = count * (count - 1) / 2;
+    std::printf("%zu instances in %dx%d, boxes up to %.0f%% of each side, %zu iterations\n", count, image_width, image_height,
+                double(max_box) * 100.0, iterations);
+    std::printf("encode       %10.1f us total, %8.3f ns/pixel\n", encode, encode * 1e3 / double(box_pixels));
+    std::printf("decode       %10.1f us total, %8.3f ns/pixel\n", decode, decode * 1e3 / double(box_pixels));
+    std::printf("IoU (RLE)    %10.1f us for %zu pairs, mean %.4f\n", rle_iou, pairs, double(rle_sum) / double(std::max<size_t>(1, pairs)));
+    std::printf("IoU (dense)  %10.1f us for %zu pairs\n", dense_iou, pairs);
+    std::printf("size         %10.1f KiB RLE, %.1f KiB float boxes, %.1f KiB byte frames\n", double(rle_bytes) / 1024.0,
+                double(box_pixels * sizeof(float)) / 1024.0, double(count * image_pixels) / 1024.0);
+    std::printf("check        %zu pixel/area/count errors, max IoU error %.2e\n", errors, double(max_iou_error));
+    return errors == 0 && max_iou_error < 1e-6f ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+/**
+ * NMS time against the candidate count: common::nms over HailoDetections (common/nms.hpp) and
+ * NmsEngine over SoA boxes (common/nms_engine.hpp).
+ *
+ * Every synthetic object is proposed by 5 anchors with jittered boxes and scores, the way a yolov8
+ * head proposes it, spread over a 640x640 frame with 80 classes. Both run on the same boxes for
+ * 10 to 5000 candidates, across classes and per class, and must keep the same boxes in the same
+ * order; the run fails (exit code 1) otherwise.
+ *
+ * Usage: nms_bench [-iterations=N] [-iou=THRESHOLD]
+ **/
+#include "common/nms.hpp"
+#include "common/nms_engine.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+struct Candidates {
+    std::vector<float> xmin, ymin, xmax, ymax, scores;
+    std::vector<int> class_ids;
+
+    common::NmsBoxes nms_boxes() const
+    {
+        return common::NmsBoxes{xmin.data(), ymin.data(), xmax.data(), ymax.data(), scores.data(), class_ids.data(), scores.size()};
+    }
+};
+
+static Candidates make_candidates(size_t count, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> position(0.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.02f, 0.3f);
+    std::uniform_real_distribution<float> score(0.3f, 1.0f);
+    std::uniform_int_distribution<int> class_id(0, 79);
+    std::normal_distribution<float> jitter(0.0f, 0.01f);
+    Candidates candidates;
+    std::set<float> used_scores;
+    while (candidates.scores.size() < count) {
+        const float w = size(rng), h = size(rng);
+        const float x = position(rng) * (1.0f - w), y = position(rng) * (1.0f - h);
+        const float object_score = score(rng);
+        const int object_class = class_id(rng);
+        for (size_t anchor = 0; anchor < 5 && candidates.scores.size() < count; anchor++) {
+            candidates.xmin.push_back(x + jitter(rng));
+            candidates.ymin.push_back(y + jitter(rng));
+            candidates.xmax.push_back(x + w + jitter(rng));
+            candidates.ymax.push_back(y + h + jitter(rng));
+            // Unique scores: common::nms sorts unstably, so equal scores could come out in either order
+            float anchor_score = object_score * (1.0f - 0.05f * position(rng));
+            while (!used_scores.insert(anchor_score).second)
+                anchor_score = std::nextafter(anchor_score, 0.0f);
+            candidates.scores.push_back(anchor_score);
+            candidates.class_ids.push_back(object_class);
+        }
+    }
+    return candidates;
+}
+
+static std::vector<HailoDetection> to_detections(const Candidates &candidates)
+{
+    std::vector<HailoDetection> detections;
+    detections.reserve(candidates.scores.size());
+    for (size_t i = 0; i < candidates.scores.size(); i++) {
+        HailoBBox bbox(candidates.xmin[i], candidates.ymin[i], candidates.xmax[i] - candidates.xmin[i], candidates.ymax[i] - candidates.ymin[i]);
+        detections.emplace_back(bbox, candidates.class_ids[i], "", candidates.scores[i]);
+    }
+    return detections;
+}
+
+static bool same_result(std::vector<HailoDetection> &expected, const Candidates &candidates, const std::vector<uint32_t> &keep)
+{
+    if (expected.size() != keep.size())
+        return false;
+    for (size_t i = 0; i < keep.size(); i++) {
+        HailoDetection &detection = expected[i];
+        if (detection.get_confidence() != candidates.scores[keep[i]] || detection.get_bbox().xmin() != candidates.xmin[keep[i]])
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t iterations = std::stoul(get_option(argc, argv, "-iterations=", "20"));
+    const float iou_thr = std::stof(get_option(argc, argv, "-iou=", "0.7"));
+    const size_t counts[] = {10, 50, 100, 250, 500, 1000, 2000, 5000};
+
+    std::mt19937 rng(1234);
+    std::printf("%-6s %10s %14s %14s %9s %7s\n", "cross", "candidates", "nms.hpp us", "NmsEngine us", "speedup", "kept");
+    bool passed = true;
+    for (bool cross_classes : {true, false}) {
+        for (size_t count : counts) {
+            const Candidates candidates = make_candidates(count, rng);
+            const std::vector<HailoDetection> detections = to_detections(candidates);
+
+            // common::nms sorts and filters its input in place, every iteration gets a fresh copy
+            std::vector<HailoDetection> expected;
+            double previous_us = 0.0;
+            for (size_t i = 0; i < iterations; i++) {
+                expected = detections;
+                auto start = std::chrono::steady_clock::now();
+                common::nms(expected, iou_thr, cross_classes);
+                previous_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            }
+            previous_us /= double(iterations);
+
+            common::NmsEngine engine;
+            engine.run(candidates.nms_boxes(), iou_thr, cross_classes);
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++)
+                engine.run(candidates.nms_boxes(), iou_thr, cross_classes);
+            const double engine_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(iterations);
+            const auto &keep = engine.run(candidates.nms_boxes(), iou_thr, cross_classes);
+
+            std::printf("%-6s %10zu %14.2f %14.2f %8.1fx %7zu\n", cross_classes ? "yes" : "no", count, previous_us, engine_us,
+                        previous_us / engine_us, keep.size());
+            if (!same_result(expected, candidates, keep)) {
+                std::printf("FAILED: NmsEngine kept different boxes than common::nms\n");
+                passed = false;
+            }
+        }
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/**
+ * Hand-off throughput of RingBuffer (BLOCK mode, 2 to 8 slots) against DoubleBuffer, one producer
+ * and one consumer thread, for buffer sizes from a few results to a 640x640x3 frame.
+ *
+ * The producer fills every buffer and the consumer reads it back, so large buffers measure the
+ * copy as much as the hand-off. Both are lossless here; every buffer must arrive, in order.
+ *
+ * Usage: ring_buffer_bench [-buffers=N]
+ **/
+#include "double_buffer.hpp"
+#include "ring_buffer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+// Buffers per second through `buffer`; false if one arrived out of order
+template <typename Buffer>
+static bool measure(Buffer &buffer, uint32_t buffers, double &per_second)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        for (uint32_t sequence = 0; sequence < buffers; sequence++) {
+            std::vector<uint8_t> &data = buffer.get_write_buffer();
+            std::fill(data.begin(), data.end(), uint8_t(sequence));
+            buffer.release_write_buffer();
+        }
+    });
+    bool in_order = true;
+    for (uint32_t sequence = 0; sequence < buffers; sequence++) {
+        std::vector<uint8_t> &data = buffer.get_read_buffer();
+        const uint64_t sum = std::accumulate(data.begin(), data.end(), uint64_t(0));
+        in_order &= sum == uint64_t(uint8_t(sequence)) * data.size();
+        buffer.release_read_buffer();
+    }
+    producer.join();
+    per_second = double(buffers) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return in_order;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t buffers = static_cast<uint32_t>(std::stoul(get_option(argc, argv, "-buffers=", "20000")));
+    const uint32_t sizes[] = {64, 4096, 640 * 640 * 3};
+
+    std::printf("%-14s %10s %14s\n", "buffer", "bytes", "buffers/s");
+    bool passed = true;
+    for (uint32_t size : sizes) {
+        // Large buffers take a while, fewer of them are enough
+        const uint32_t count = std::max<uint32_t>(100, buffers / std::max<uint32_t>(1, size / 4096));
+        double per_second = 0.0;
+        DoubleBuffer<uint8_t> double_buffer(size);
+        passed &= measure(double_buffer, count, per_second);
+        std::printf("%-14s %10u %14.0f\n", "DoubleBuffer", size, per_second);
+        for (uint32_t slots : {2u, 4u, 8u}) {
+            RingBuffer<uint8_t> ring(size, slots, BackpressureMode::BLOCK);
+            passed &= measure(ring, count, per_second);
+            std::printf("RingBuffer x%-2u %10u %14.0f\n", slots, size, per_second);
+        }
+    }
+    if (!passed)
+        std::printf("FAILED: a buffer arrived out of order\n");
+    return passed ? 0 : 1;
+}
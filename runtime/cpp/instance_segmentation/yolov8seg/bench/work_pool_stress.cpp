@@ -0,0 +1,189 @@
+/**
+ * WorkPool stress: several caller threads share one pool and run parallel_for jobs of random
+ * sizes with uneven tasks, scratch allocations and the odd throwing task, all at once.
+ *
+ * Every index of every job must run exactly once, scratch memory must not be shared between
+ * tasks running at the same time, over-aligned scratch (alignas(64)) must come back aligned in
+memory, and a throwing task must surface in its own caller only. With
+ * -cpus=LIST the workers are pinned, and every task a worker runs checks that its thread already
+ * had that affinity. A CPU that does not exist must make the constructor throw. The
+ * work_pool_stress_tsan and work_pool_stress_asan targets run the same under the sanitizers.
+ *
+ * Usage: work_pool_stress [-jobs=N] [-callers=N] [-threads=N] [-cpus=LIST]
+ **/
+#include "common/work_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+// True if the calling thread may only run on `cpus`
+static bool pinned_to(const std::vector<int> &cpus)
+{
+#if defined(__linux__)
+    cpu_set_t expected, actual;
+    CPU_ZERO(&expected);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &expected);
+    if (0 != pthread_getaffinity_np(pthread_self(), sizeof(actual), &actual))
+        return false;
+    return CPU_EQUAL(&expected, &actual);
+#else
+    return true;
+#endif
+}
+
+// Wider than max_align_t, like __m256 or a cache line
+struct alignas(64) Line
+{
+    uint8_t bytes[64];
+};
+
+struct Failure : std::runtime_error
+{
+    Failure() : std::runtime_error("expected") {}
+};
+
+static bool stress(common::WorkPool &pool, const std::vector<int> &cpus, uint32_t caller, uint32_t jobs)
+{
+    std::mt19937 rng(caller);
+    const std::thread::id self = std::this_thread::get_id();
+    bool passed = true;
+    for (uint32_t job = 0; job < jobs; job++) {
+        const size_t count = rng() % 200;
+        const size_t throwing = 0 == job % 7 && count > 0 ? rng() % count : SIZE_MAX;
+        std::vector<std::atomic<uint32_t>> runs(count);
+        std::atomic<bool> unpinned{false};
+        std::atomic<bool> misaligned{false};
+        bool thrown = false;
+        try {
+            pool.parallel_for(count, [&](size_t index, common::ScratchArena &scratch) {
+                if (!cpus.empty() && std::this_thread::get_id() != self && !pinned_to(cpus))
+                    unpinned.store(true);
+                // Uneven: most tasks are tiny, a few are a hundred times bigger
+                const size_t words = 0 == index % 16 ? 4096 : 40;
+                uint32_t *data = scratch.allocate<uint32_t>(words);
+                for (size_t i = 0; i < words; i++)
+                    data[i] = uint32_t(index);
+                // An odd-sized allocation first, so only the address can be aligned
+                scratch.allocate<uint8_t>(1 + index % 5);
+                Line *lines = scratch.allocate<Line>(1 + index % 3);
+                if (0 != reinterpret_cast<uintptr_t>(lines) % alignof(Line))
+                    misaligned.store(true);
+                for (size_t i = 0; i < 1 + index % 3; i++)
+                    lines[i].bytes[63] = uint8_t(index);
+                std::this_thread::yield();
+                for (size_t i = 0; i < words; i++) {
+                    if (data[i] != uint32_t(index)) {
+                        std::printf("FAILED: scratch of task %zu overwritten\n", index);
+                        runs[index].fetch_add(100);
+                        break;
+                    }
+                }
+                runs[index].fetch_add(1);
+                if (index == throwing)
+                    throw Failure();
+            });
+        } catch (const Failure &) {
+            thrown = true;
+        }
+        for (size_t index = 0; index < count; index++) {
+            if (1 != runs[index].load()) {
+                std::printf("FAILED: caller %u job %u index %zu ran %u times\n", caller, job, index, runs[index].load());
+                passed = false;
+            }
+        }
+        if (thrown != (SIZE_MAX != throwing)) {
+            std::printf("FAILED: caller %u job %u %s\n", caller, job, thrown ? "threw without a throwing task" : "lost its exception");
+            passed = false;
+        }
+        if (misaligned.load()) {
+            std::printf("FAILED: caller %u job %u got misaligned scratch\n", caller, job);
+            passed = false;
+        }
+        if (unpinned.load()) {
+            std::printf("FAILED: caller %u job %u ran on a worker without the requested affinity\n", caller, job);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t jobs = static_cast<uint32_t>(std::stoul(get_option(argc, argv, "-jobs=", "2000")));
+    const uint32_t callers = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(get_option(argc, argv, "-callers=", "4"))));
+    common::WorkPoolConfig config;
+    config.threads = std::stoul(get_option(argc, argv, "-threads=", "3"));
+    config.cpus = common::WorkPoolConfig::parse_cpus(get_option(argc, argv, "-cpus=", ""));
+#if defined(__linux__)
+    // Pin to the first CPU this process may use unless told otherwise, so the affinity check runs
+    if (config.cpus.empty()) {
+        cpu_set_t allowed;
+        if (0 == sched_getaffinity(0, sizeof(allowed), &allowed)) {
+            for (int cpu = 0; cpu < CPU_SETSIZE && config.cpus.empty(); cpu++)
+                if (CPU_ISSET(cpu, &allowed))
+                    config.cpus.push_back(cpu);
+        }
+    }
+#endif
+
+    bool passed = true;
+    auto start = std::chrono::steady_clock::now();
+    {
+        common::WorkPool pool(config);
+        std::vector<std::thread> threads;
+        std::vector<char> results(callers, 0);
+        for (uint32_t caller = 0; caller < callers; caller++)
+            threads.emplace_back([&, caller]() { results[caller] = stress(pool, config.cpus, caller, jobs); });
+        for (auto &thread : threads)
+            thread.join();
+        for (char result : results)
+            passed &= 0 != result;
+    }
+    std::printf("%u callers x %u jobs on %zu workers: %.2f s %s\n", callers, jobs, config.threads,
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), passed ? "ok" : "FAILED");
+
+    // No workers at all: everything on the caller, exceptions included
+    {
+        common::WorkPoolConfig inline_config;
+        inline_config.threads = 0;
+        common::WorkPool pool(inline_config);
+        const bool inline_passed = stress(pool, {}, callers, jobs / 10 + 1);
+        std::printf("%-34s %s\n", "0 workers", inline_passed ? "ok" : "FAILED");
+        passed &= inline_passed;
+    }
+
+#if defined(__linux__)
+    // A CPU that cannot exist: the constructor must throw and leave no thread behind
+    {
+        common::WorkPoolConfig bad_config;
+        bad_config.threads = 2;
+        bad_config.cpus = {CPU_SETSIZE - 1};
+        bool thrown = false;
+        try {
+            common::WorkPool pool(bad_config);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        std::printf("%-34s %s\n", "pinning to a missing CPU throws", thrown ? "ok" : "FAILED");
+        passed &= thrown;
+    }
+#endif
+    return passed ? 0 : 1;
+}
@@ -23,7 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "hailo/hailort.h"
-#include "double_buffer.hpp"
+#include "ring_buffer.hpp"
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/highgui.hpp>
@@ -51,12 +51,15 @@
 template <typename T>
 class FeatureData {
 public:
-    FeatureData(uint32_t buffers_size, float32_t qp_zp, float32_t qp_scale, uint32_t width, hailo_vstream_info_t vstream_info) :
-    m_buffers(buffers_size), m_qp_zp(qp_zp), m_qp_scale(qp_scale), m_width(width), m_vstream_info(vstream_info)
+    // Default: 4 slots, lossless. Every output stream must deliver the same frames for the
+    // postprocess to pair them, so only drop if all streams of a network drop together.
+    FeatureData(uint32_t buffers_size, float32_t qp_zp, float32_t qp_scale, uint32_t width, hailo_vstream_info_t vstream_info,
+                uint32_t slots = 4, BackpressureMode mode = BackpressureMode::BLOCK) :
+    m_buffers(buffers_size, slots, mode), m_qp_zp(qp_zp), m_qp_scale(qp_scale), m_width(width), m_vstream_info(vstream_info)
     {}
     static bool sort_tensors_by_size (std::shared_ptr<FeatureData> i, std::shared_ptr<FeatureData> j) { return i->m_width < j->m_width; };
 
-    DoubleBuffer<T> m_buffers;
+    RingBuffer<T> m_buffers;
     float32_t m_qp_zp;
     float32_t m_qp_scale;
     uint32_t m_width;
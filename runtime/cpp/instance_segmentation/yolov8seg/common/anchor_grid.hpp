@@ -0,0 +1,147 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace common
+{
+    /**
+     * @brief Anchor centers of every output level of a yolov8 head, in network pixels.
+     *        All levels share one 64-byte aligned allocation; each level starts on a
+     *        64-byte boundary and stores interleaved (x, y) pairs in anchor order
+     *        (row * width + col), matching the HWC layout of the output tensors.
+     */
+    class AnchorGrid
+    {
+    public:
+        static constexpr size_t ALIGNMENT = 64;
+
+        AnchorGrid(int network_width, int network_height, const std::vector<int> &strides)
+        {
+            size_t total_floats = 0;
+            for (int stride : strides)
+            {
+                size_t anchors = static_cast<size_t>(network_width / stride) * static_cast<size_t>(network_height / stride);
+                m_levels.push_back({total_floats, anchors});
+                total_floats += round_up(anchors * 2, ALIGNMENT / sizeof(float));
+            }
+            void *data = std::aligned_alloc(ALIGNMENT, std::max<size_t>(total_floats, 1) * sizeof(float));
+            if (nullptr == data)
+                throw std::bad_alloc();
+            m_data.reset(static_cast<float *>(data));
+
+            for (size_t level = 0; level < strides.size(); level++)
+            {
+                const int stride = strides[level];
+                const int width = network_width / stride;
+                const int height = network_height / stride;
+                float *centers = m_data.get() + m_levels[level].first;
+                for (int row = 0; row < height; row++)
+                {
+                    for (int col = 0; col < width; col++)
+                    {
+                        *centers++ = (static_cast<float>(col) + 0.5f) * static_cast<float>(stride);
+                        *centers++ = (static_cast<float>(row) + 0.5f) * static_cast<float>(stride);
+                    }
+                }
+            }
+        }
+
+        AnchorGrid(const AnchorGrid &) = delete;
+        AnchorGrid &operator=(const AnchorGrid &) = delete;
+
+        /**
+         * @brief Centers of one output level: centers[2 * anchor] is x, centers[2 * anchor + 1] is y.
+         */
+        std::span<const float> centers(size_t level) const
+        {
+            return std::span<const float>(m_data.get() + m_levels[level].first, m_levels[level].second * 2);
+        }
+
+        size_t anchors(size_t level) const { return m_levels[level].second; }
+        size_t levels() const { return m_levels.size(); }
+
+    private:
+        struct FreeDeleter
+        {
+            void operator()(float *data) const { std::free(data); }
+        };
+
+        static size_t round_up(size_t value, size_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        std::unique_ptr<float, FreeDeleter> m_data;
+        std::vector<std::pair<size_t, size_t>> m_levels; // (offset in floats, number of anchors)
+    };
+
+    /**
+     * @brief Process-wide cache of anchor grids keyed by (network_dims, strides).
+     *        A grid is built on first use and shared by every decoder with the same geometry.
+     */
+    class AnchorGridCache
+    {
+    public:
+        static std::shared_ptr<const AnchorGrid> get(const std::array<int, 2> &network_dims, const std::vector<int> &strides)
+        {
+            static std::mutex mutex;
+            static std::vector<Entry> grids;
+
+            // Only a handful of geometries ever exist, a linear scan avoids building a key per lookup.
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &entry : grids)
+            {
+                if (entry.network_dims == network_dims && entry.strides == strides)
+                    return entry.grid;
+            }
+            auto grid = std::make_shared<const AnchorGrid>(network_dims[0], network_dims[1], strides);
+            grids.push_back(Entry{network_dims, strides, grid});
+            return grid;
+        }
+
+    private:
+        struct Entry
+        {
+            std::array<int, 2> network_dims;
+            std::vector<int> strides;
+            std::shared_ptr<const AnchorGrid> grid;
+        };
+    };
+
+    /**
+     * @brief One decoder's grid, kept across frames. It only goes back to AnchorGridCache (and its
+     *        mutex) when the geometry changes. Not shared between threads.
+     */
+    class AnchorGridSlot
+    {
+    public:
+        const AnchorGrid &get(const std::array<int, 2> &network_dims, const std::vector<int> &strides)
+        {
+            if (!m_grid || m_network_dims != network_dims || m_strides != strides)
+            {
+                m_grid = AnchorGridCache::get(network_dims, strides);
+                m_network_dims = network_dims;
+                m_strides = strides;
+            }
+            return *m_grid;
+        }
+
+    private:
+        std::shared_ptr<const AnchorGrid> m_grid;
+        std::array<int, 2> m_network_dims{};
+        std::vector<int> m_strides;
+    };
+
+}
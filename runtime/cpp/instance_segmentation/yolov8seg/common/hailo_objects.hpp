@@ -13,6 +13,7 @@
 #include <map>
 #include <algorithm>
 #include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -261,6 +262,23 @@ public:
         return _tensors;
     };
 
+    /**
+     * @brief Get the tensors attached to this main object, in a vector allocated from `memory`.
+     *
+     * @return std::pmr::vector<HailoTensorPtr>
+     */
+    std::pmr::vector<HailoTensorPtr> get_tensors(std::pmr::memory_resource *memory)
+    {
+        std::lock_guard<std::mutex> lock(*mutex);
+        std::pmr::vector<HailoTensorPtr> _tensors(memory);
+        _tensors.reserve(m_tensors.size());
+        for (auto &tensor_pair : m_tensors)
+        {
+            _tensors.emplace_back(tensor_pair.second);
+        }
+        return _tensors;
+    };
+
     std::map<std::string, HailoTensorPtr> get_tensors_by_name()
     {
         std::map<std::string, HailoTensorPtr> tensors_by_name;
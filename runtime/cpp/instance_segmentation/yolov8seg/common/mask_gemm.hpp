@@ -0,0 +1,240 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "quant_lut.hpp"
+#include "simd_kernels.hpp"
+
+namespace common
+{
+    /**
+     * @brief Prototype masks as a row-major [features x pixels] matrix, so every mask coefficient
+     *        multiplies one contiguous row. Dequantized and transposed once per frame straight from
+     *        the HWC output buffer; the buffer is reused across frames and only grows.
+     */
+    struct PrototypeMatrix
+    {
+        std::vector<float> data;
+        size_t features = 0;
+        size_t height = 0;
+        size_t width = 0;
+        std::vector<float> tile;    // Dequantization scratch
+
+        size_t pixels() const { return height * width; }
+
+        void load(const uint8_t *hwc, size_t proto_height, size_t proto_width, size_t proto_features, const QuantLut &lut)
+        {
+            height = proto_height;
+            width = proto_width;
+            features = proto_features;
+            const size_t count = pixels();
+            if (data.size() < count * features)
+                data.resize(count * features);
+
+            // A tile of pixels is dequantized contiguously with SIMD, then transposed out of L1
+            constexpr size_t TILE = 64;
+            if (tile.size() < TILE * features)
+                tile.resize(TILE * features);
+            for (size_t start = 0; start < count; start += TILE)
+            {
+                const size_t end = std::min(count, start + TILE);
+                simd::dequantize(hwc + start * features, tile.data(), (end - start) * features, lut.qp_scale, lut.qp_zp);
+                for (size_t c = 0; c < features; c++)
+                {
+                    float *row = data.data() + c * count;
+                    for (size_t p = start; p < end; p++)
+                        row[p] = tile[(p - start) * features + c];
+                }
+            }
+        }
+    };
+
+    //-------------------------------
+    // MASK GEMM
+    //-------------------------------
+    /**
+     * @brief One detection over `length` consecutive pixels: accumulated row by row into the output,
+     *        which stays in L1, then the sigmoid. Used where there is no SIMD micro-kernel; the
+     *        compiler vectorizes the row loops with whatever the target has.
+     *
+     * @param proto        The first pixel in feature row 0; feature k is `proto_stride` floats further.
+     */
+    inline void mask_block(const float *coefficients, size_t features, const float *proto, size_t proto_stride,
+                           size_t length, float *mask)
+    {
+        for (size_t p = 0; p < length; p++)
+            mask[p] = coefficients[0] * proto[p];
+        for (size_t k = 1; k < features; k++)
+        {
+            const float a = coefficients[k];
+            const float *row = proto + k * proto_stride;
+            for (size_t p = 0; p < length; p++)
+                mask[p] += a * row[p];
+        }
+        for (size_t p = 0; p < length; p++)
+            mask[p] = 1.0f / (1.0f + std::exp(-mask[p]));
+    }
+
+#if defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    // Output pixels per micro-kernel call
+    constexpr size_t MASK_TILE_PIXELS = 16;
+
+    /**
+     * @brief sigmoid(coefficients x prototypes) of one detection over MASK_TILE_PIXELS pixels.
+     *        Accumulators stay in registers across the feature loop.
+     *
+     * @param proto        The first pixel in feature row 0; feature k is `proto_stride` floats further.
+     */
+    inline void mask_tile(const float *coefficients, size_t features, const float *proto, size_t proto_stride, float *mask)
+    {
+#if defined(__AVX2__)
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (size_t k = 0; k < features; k++)
+        {
+            const float *row = proto + k * proto_stride;
+            const __m256 a = _mm256_set1_ps(coefficients[k]);
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(a, _mm256_loadu_ps(row)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(a, _mm256_loadu_ps(row + 8)));
+        }
+        _mm256_storeu_ps(mask, simd::sigmoid_ps(acc0));
+        _mm256_storeu_ps(mask + 8, simd::sigmoid_ps(acc1));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        float32x4_t acc[4];
+        for (size_t v = 0; v < 4; v++)
+            acc[v] = vdupq_n_f32(0.0f);
+        for (size_t k = 0; k < features; k++)
+        {
+            const float *row = proto + k * proto_stride;
+            for (size_t v = 0; v < 4; v++)
+                acc[v] = vfmaq_n_f32(acc[v], vld1q_f32(row + 4 * v), coefficients[k]);
+        }
+        for (size_t v = 0; v < 4; v++)
+            vst1q_f32(mask + 4 * v, simd::sigmoid_ps(acc[v]));
+#endif
+    }
+#endif
+
+    /**
+     * @brief sigmoid(coefficients x prototypes) of one detection over `length` consecutive pixels.
+     */
+    inline void mask_run_sigmoid(const float *coefficients, size_t features, const float *proto, size_t proto_stride,
+                                 size_t length, float *mask)
+    {
+        size_t p = 0;
+#if defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+        for (; p + MASK_TILE_PIXELS <= length; p += MASK_TILE_PIXELS)
+            mask_tile(coefficients, features, proto + p, proto_stride, mask + p);
+#endif
+        if (p < length)
+            mask_block(coefficients, features, proto + p, proto_stride, length - p, mask + p);
+    }
+
+    //-------------------------------
+    // CROP-FIRST DECODING
+    //-------------------------------
+    /**
+     * @brief Where a destination pixel of a bilinear resize reads its source, mapped exactly like
+     *        cv::resize INTER_LINEAR (pixel centers aligned, clamped at the borders):
+     *        value = src[first] * (1 - weight) + src[second] * weight.
+     */
+    struct BilinearTap
+    {
+        int first;
+        int second;
+        float weight;
+    };
+
+    inline BilinearTap bilinear_tap(int dst, int src_size, int dst_size)
+    {
+        const float position = (float(dst) + 0.5f) * (float(src_size) / float(dst_size)) - 0.5f;
+        int first = static_cast<int>(std::floor(position));
+        float weight = position - float(first);
+        if (first < 0)
+        {
+            first = 0;
+            weight = 0.0f;
+        }
+        if (first >= src_size - 1)
+        {
+            first = src_size - 1;
+            weight = 0.0f;
+        }
+        return BilinearTap{first, std::min(first + 1, src_size - 1), weight};
+    }
+
+    /**
+     * @brief Decodes the mask of one detection over a region of the original image only. The
+     *        product with the prototypes is computed over just the prototype pixels the region's
+     *        bilinear taps read, and only the region is resampled, so the cost follows the object's
+     *        area. Values equal the full-frame sigmoid -> resize -> crop of the region.
+     *        Scratch buffers are reused across calls: one decoder per thread.
+     */
+    class RoiMaskDecoder
+    {
+    public:
+        /**
+         * @param coefficients  prototypes.features mask coefficients.
+         * @param image_width   Original image size the prototypes are resized to.
+         * @param x, y, width, height Region in original image pixels, inside the image and not empty.
+         * @param mask          Row-major width x height output.
+         */
+        void decode(const float *coefficients, const PrototypeMatrix &prototypes, int image_width, int image_height,
+                    int x, int y, int width, int height, float *mask)
+        {
+            const int proto_width = static_cast<int>(prototypes.width);
+            const int proto_height = static_cast<int>(prototypes.height);
+            m_columns.resize(size_t(width));
+            m_rows.resize(size_t(height));
+            for (int c = 0; c < width; c++)
+                m_columns[size_t(c)] = bilinear_tap(x + c, proto_width, image_width);
+            for (int r = 0; r < height; r++)
+                m_rows[size_t(r)] = bilinear_tap(y + r, proto_height, image_height);
+
+            // Taps are monotonic, the patch spans from the first tap of the first pixel to the last of the last
+            const int patch_x = m_columns.front().first;
+            const int patch_y = m_rows.front().first;
+            const size_t patch_width = size_t(m_columns.back().second - patch_x + 1);
+            const size_t patch_height = size_t(m_rows.back().second - patch_y + 1);
+            if (m_patch.size() < patch_width * patch_height)
+                m_patch.resize(patch_width * patch_height);
+
+            const size_t pixels = prototypes.pixels();
+            for (size_t r = 0; r < patch_height; r++)
+            {
+                const float *proto = prototypes.data.data() + (size_t(patch_y) + r) * prototypes.width + size_t(patch_x);
+                mask_run_sigmoid(coefficients, prototypes.features, proto, pixels, patch_width, m_patch.data() + r * patch_width);
+            }
+
+            for (int r = 0; r < height; r++)
+            {
+                const BilinearTap &row_tap = m_rows[size_t(r)];
+                const float *top = m_patch.data() + size_t(row_tap.first - patch_y) * patch_width;
+                const float *bottom = m_patch.data() + size_t(row_tap.second - patch_y) * patch_width;
+                float *out = mask + size_t(r) * size_t(width);
+                for (int c = 0; c < width; c++)
+                {
+                    const BilinearTap &column_tap = m_columns[size_t(c)];
+                    const size_t left = size_t(column_tap.first - patch_x);
+                    const size_t right = size_t(column_tap.second - patch_x);
+                    const float upper = top[left] + (top[right] - top[left]) * column_tap.weight;
+                    const float lower = bottom[left] + (bottom[right] - bottom[left]) * column_tap.weight;
+                    out[c] = upper + (lower - upper) * row_tap.weight;
+                }
+            }
+        }
+
+    private:
+        std::vector<BilinearTap> m_columns;
+        std::vector<BilinearTap> m_rows;
+        std::vector<float> m_patch;
+    };
+}
@@ -0,0 +1,256 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace common
+{
+    /**
+     * @brief Binary instance mask, run-length encoded row by row over its box.
+     *
+     *        Row r of the box holds the foreground runs runs[row_starts[r] .. row_starts[r + 1]) as
+     *        [begin, end) column pairs relative to x, in increasing order. Runs never cross rows, so
+     *        any image row is found in O(1) and two masks intersect without decompressing.
+     *        The runs live in `memory` (the default resource unless given); assigning a mask copies
+     *        the runs into the destination's memory.
+     */
+    struct RleMask
+    {
+        RleMask() = default;
+        explicit RleMask(std::pmr::memory_resource *memory) : row_starts(memory), runs(memory) {}
+
+        int x = 0;                          // Box in image pixels
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        std::pmr::vector<uint32_t> row_starts;  // height + 1 offsets into runs
+        std::pmr::vector<uint16_t> runs;
+        uint32_t area = 0;                  // Foreground pixels
+
+        bool empty() const { return 0 == area; }
+        const uint16_t *row_begin(int row) const { return runs.data() + row_starts[size_t(row)]; }
+        const uint16_t *row_end(int row) const { return runs.data() + row_starts[size_t(row) + 1]; }
+    };
+
+    //-------------------------------
+    // ENCODE
+    //-------------------------------
+    /**
+     * @brief Bit-packs `values > threshold` into 64-bit words, bit i of words[i / 64] is value i.
+     *        Bits past `size` in the last word are cleared.
+     */
+    inline void threshold_bits(const float *values, size_t size, float threshold, uint64_t *words)
+    {
+        const size_t word_count = (size + 63) / 64;
+        for (size_t w = 0; w < word_count; w++)
+        {
+            const size_t base = w * 64;
+            const size_t count = std::min<size_t>(64, size - base);
+            uint64_t word = 0;
+            size_t i = 0;
+#if defined(__AVX2__)
+            const __m256 limit = _mm256_set1_ps(threshold);
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m256 above = _mm256_cmp_ps(_mm256_loadu_ps(values + base + i), limit, _CMP_GT_OQ);
+                word |= uint64_t(uint32_t(_mm256_movemask_ps(above))) << i;
+            }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            const float32x4_t limit = vdupq_n_f32(threshold);
+            const uint32x4_t lanes = {1, 2, 4, 8};
+            for (; i + 4 <= count; i += 4)
+            {
+                const uint32x4_t above = vcgtq_f32(vld1q_f32(values + base + i), limit);
+                word |= uint64_t(vaddvq_u32(vandq_u32(above, lanes))) << i;
+            }
+#endif
+            for (; i < count; i++)
+                word |= uint64_t(values[base + i] > threshold) << i;
+            words[w] = word;
+        }
+    }
+
+    /**
+     * @brief Thresholds a row-major width x height probability mask covering the box (x, y, width,
+     *        height) and run-length encodes it into `rle`, reusing its buffers. Runs are found a
+     *        word at a time from the packed bits: each transition is one count-trailing-zeros.
+     *
+     * @param bits Scratch, grown as needed.
+     */
+    inline void encode_mask(const float *mask, int x, int y, int width, int height, float threshold, RleMask &rle,
+                            std::vector<uint64_t> &bits)
+    {
+        rle.x = x;
+        rle.y = y;
+        rle.width = width;
+        rle.height = height;
+        rle.area = 0;
+        rle.runs.clear();
+        rle.row_starts.resize(size_t(height) + 1);
+
+        const size_t word_count = (size_t(width) + 63) / 64;
+        if (bits.size() < word_count)
+            bits.resize(word_count);
+
+        for (int r = 0; r < height; r++)
+        {
+            rle.row_starts[size_t(r)] = uint32_t(rle.runs.size());
+            threshold_bits(mask + size_t(r) * size_t(width), size_t(width), threshold, bits.data());
+
+            bool inside = false;
+            uint32_t begin = 0;
+            for (size_t w = 0; w < word_count; w++)
+            {
+                const uint64_t word = bits[w];
+                // Looking for the next pixel that differs from the current state
+                uint64_t search = inside ? ~word : word;
+                while (0 != search)
+                {
+                    const uint32_t bit = uint32_t(__builtin_ctzll(search));
+                    const uint32_t column = uint32_t(w * 64) + bit;
+                    if (column >= uint32_t(width))
+                        break;
+                    if (inside)
+                    {
+                        rle.runs.push_back(uint16_t(begin));
+                        rle.runs.push_back(uint16_t(column));
+                        rle.area += column - begin;
+                    }
+                    else
+                    {
+                        begin = column;
+                    }
+                    inside = !inside;
+                    search = (inside ? ~word : word) & (~uint64_t(0) << bit);
+                }
+            }
+            if (inside)
+            {
+                rle.runs.push_back(uint16_t(begin));
+                rle.runs.push_back(uint16_t(width));
+                rle.area += uint32_t(width) - begin;
+            }
+        }
+        rle.row_starts[size_t(height)] = uint32_t(rle.runs.size());
+    }
+
+    //-------------------------------
+    // DECODE
+    //-------------------------------
+    /**
+     * @brief Calls span(image_y, image_x_begin, image_x_end) for every foreground run, in row order.
+     *        Lets drawing and export work on the runs without a dense mask.
+     */
+    template <typename Span>
+    inline void for_each_run(const RleMask &rle, Span &&span)
+    {
+        for (int r = 0; r < rle.height; r++)
+            for (const uint16_t *run = rle.row_begin(r); run != rle.row_end(r); run += 2)
+                span(rle.y + r, rle.x + int(run[0]), rle.x + int(run[1]));
+    }
+
+    /**
+     * @brief Expands the mask over its box: `value` on the foreground, 0 elsewhere.
+     *
+     * @param dst    Row-major, rle.height rows of rle.width bytes, `stride` bytes apart.
+     */
+    inline void decode_mask(const RleMask &rle, uint8_t *dst, size_t stride, uint8_t value = 1)
+    {
+        for (int r = 0; r < rle.height; r++)
+        {
+            uint8_t *row = dst + size_t(r) * stride;
+            std::memset(row, 0, size_t(rle.width));
+            for (const uint16_t *run = rle.row_begin(r); run != rle.row_end(r); run += 2)
+                std::memset(row + run[0], value, size_t(run[1] - run[0]));
+        }
+    }
+
+    /**
+     * @brief Run lengths of the mask over its box in row-major order, alternating background and
+     *        foreground and starting with background (0 when the first pixel is foreground).
+     *        Runs of consecutive rows are merged, so this is plain uncompressed RLE for export.
+     */
+    inline void mask_counts(const RleMask &rle, std::vector<uint32_t> &counts)
+    {
+        counts.clear();
+        uint32_t position = 0;  // Row-major index where the pending background run started
+        uint32_t last_end = 0;
+        bool any = false;
+        for (int r = 0; r < rle.height; r++)
+        {
+            const uint32_t row_base = uint32_t(r) * uint32_t(rle.width);
+            for (const uint16_t *run = rle.row_begin(r); run != rle.row_end(r); run += 2)
+            {
+                const uint32_t begin = row_base + run[0];
+                const uint32_t end = row_base + run[1];
+                if (any && begin == last_end)
+                {
+                    counts.back() += end - begin;   // Continues the run that ended the previous row
+                }
+                else
+                {
+                    counts.push_back(begin - position);
+                    counts.push_back(end - begin);
+                }
+                position = last_end = end;
+                any = true;
+            }
+        }
+        const uint32_t total = uint32_t(rle.width) * uint32_t(rle.height);
+        if (position < total)
+            counts.push_back(total - position);
+    }
+
+    //-------------------------------
+    // IOU
+    //-------------------------------
+    /**
+     * @brief Intersection over union of two masks straight from their runs. Only the rows both
+     *        boxes cover are visited, each with a merge of the two sorted run lists.
+     */
+    inline float mask_iou(const RleMask &a, const RleMask &b)
+    {
+        const int top = std::max(a.y, b.y);
+        const int bottom = std::min(a.y + a.height, b.y + b.height);
+        const int left = std::max(a.x, b.x);
+        const int right = std::min(a.x + a.width, b.x + b.width);
+
+        uint64_t intersection = 0;
+        if (top < bottom && left < right && !a.empty() && !b.empty())
+        {
+            for (int y = top; y < bottom; y++)
+            {
+                const uint16_t *run_a = a.row_begin(y - a.y), *end_a = a.row_end(y - a.y);
+                const uint16_t *run_b = b.row_begin(y - b.y), *end_b = b.row_end(y - b.y);
+                while (run_a != end_a && run_b != end_b)
+                {
+                    const int a_begin = a.x + run_a[0], a_end = a.x + run_a[1];
+                    const int b_begin = b.x + run_b[0], b_end = b.x + run_b[1];
+                    const int overlap = std::min(a_end, b_end) - std::max(a_begin, b_begin);
+                    if (overlap > 0)
+                        intersection += uint64_t(overlap);
+                    if (a_end < b_end)
+                        run_a += 2;
+                    else
+                        run_b += 2;
+                }
+            }
+        }
+        const uint64_t union_area = uint64_t(a.area) + uint64_t(b.area) - intersection;
+        return 0 == union_area ? 0.0f : float(double(intersection) / double(union_area));
+    }
+}
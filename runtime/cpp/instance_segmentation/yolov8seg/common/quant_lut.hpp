@@ -0,0 +1,146 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace common
+{
+    /**
+     * @brief Lookup tables over every value a uint8 tensor element can take, for one (qp_scale, qp_zp).
+     *        Replaces per-element dequantize / exp / sigmoid calls with a single load.
+     *
+     *        exp_delta[d] = exp(-d * qp_scale) is exp(x - max) for two raw values d apart, so a softmax
+     *        with max subtraction needs only the raw maximum of the row and never overflows.
+     */
+    struct QuantLut
+    {
+        float qp_scale;
+        float qp_zp;
+        std::array<float, 256> dequantized; // (q - qp_zp) * qp_scale
+        std::array<float, 256> exp;         // exp(dequantized[q])
+        std::array<float, 256> exp_delta;   // exp(-d * qp_scale)
+        std::array<float, 256> sigmoid;     // 1 / (1 + exp(-dequantized[q]))
+
+        QuantLut(float scale, float zp) : qp_scale(scale), qp_zp(zp)
+        {
+            for (int q = 0; q < 256; q++)
+            {
+                const double value = (double(q) - zp) * scale;
+                dequantized[q] = static_cast<float>(value);
+                exp[q] = static_cast<float>(std::exp(value));
+                exp_delta[q] = static_cast<float>(std::exp(-double(q) * scale));
+                sigmoid[q] = static_cast<float>(1.0 / (1.0 + std::exp(-value)));
+            }
+        }
+    };
+
+    /**
+     * @brief Process-wide cache of QuantLuts keyed by (qp_scale, qp_zp). A table is built the first
+     *        time a tensor with those quantization parameters is seen and shared afterwards.
+     */
+    class QuantLutCache
+    {
+    public:
+        static std::shared_ptr<const QuantLut> get(float qp_scale, float qp_zp)
+        {
+            static std::mutex mutex;
+            static std::vector<std::shared_ptr<const QuantLut>> luts;
+
+            // A network has a handful of distinct quantization parameters, a linear scan is enough
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &lut : luts)
+            {
+                if (lut->qp_scale == qp_scale && lut->qp_zp == qp_zp)
+                    return lut;
+            }
+            auto lut = std::make_shared<const QuantLut>(qp_scale, qp_zp);
+            luts.push_back(lut);
+            return lut;
+        }
+    };
+
+    /**
+     * @brief One decoder's table per tensor slot, kept across frames. A slot only goes back to
+     *        QuantLutCache (and its mutex) when its tensor's quantization changes; otherwise a
+     *        lookup compares the parameters. Not shared between threads.
+     */
+    class QuantLutSlots
+    {
+    public:
+        const QuantLut &get(size_t slot, float qp_scale, float qp_zp)
+        {
+            if (slot >= m_luts.size())
+                m_luts.resize(slot + 1);
+            std::shared_ptr<const QuantLut> &lut = m_luts[slot];
+            if (!lut || lut->qp_scale != qp_scale || lut->qp_zp != qp_zp)
+                lut = QuantLutCache::get(qp_scale, qp_zp);
+            return *lut;
+        }
+
+    private:
+        std::vector<std::shared_ptr<const QuantLut>> m_luts;
+    };
+
+    /**
+     * @brief Dequantizes `size` raw values through the table.
+     */
+    inline void dequantize(const uint8_t *src, float *dst, size_t size, const QuantLut &lut)
+    {
+        for (size_t i = 0; i < size; i++)
+            dst[i] = lut.dequantized[src[i]];
+    }
+
+    /**
+     * @brief Decodes one DFL distribution from raw bins: softmax with max subtraction followed by
+     *        the expectation sum(i * p_i). exp is evaluated once per bin, as a table load.
+     *
+     * @param bins       Pointer to `bins_count` quantized logits.
+     * @param bins_count Number of bins (regression_length + 1).
+     * @return float     Expected distance in units of the stride.
+     */
+    inline float dfl_expectation(const uint8_t *bins, int bins_count, const QuantLut &lut)
+    {
+        uint8_t max = bins[0];
+        for (int i = 1; i < bins_count; i++)
+            max = bins[i] > max ? bins[i] : max;
+        float sum = 0.0f;
+        float weighted = 0.0f;
+        for (int i = 0; i < bins_count; i++)
+        {
+            const float e = lut.exp_delta[max - bins[i]];
+            sum += e;
+            weighted += e * float(i);
+        }
+        return weighted / sum;
+    }
+
+    /**
+     * @brief dfl_expectation with the bin count known at compile time, the loops unroll fully.
+     */
+    template <int BINS>
+    inline float dfl_expectation(const uint8_t *bins, const QuantLut &lut)
+    {
+        uint8_t max = bins[0];
+        for (int i = 1; i < BINS; i++)
+            max = bins[i] > max ? bins[i] : max;
+        float sum = 0.0f;
+        float weighted = 0.0f;
+        for (int i = 0; i < BINS; i++)
+        {
+            const float e = lut.exp_delta[max - bins[i]];
+            sum += e;
+            weighted += e * float(i);
+        }
+        return weighted / sum;
+    }
+
+}
@@ -0,0 +1,175 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace common
+{
+namespace simd
+{
+    //-------------------------------
+    // VECTOR MATH
+    //-------------------------------
+    // exp() approximations follow the Cephes expf polynomial, accurate to ~1 ulp on [-88, 88].
+#if defined(__AVX2__)
+    inline __m256 exp_ps(__m256 x)
+    {
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f)), _mm256_set1_ps(88.3762626647949f));
+        __m256 fx = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _mm256_set1_ps(0.5f)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+        __m256 z = _mm256_mul_ps(x, x);
+        __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507e-3f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073e-3f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894e-2f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459e-1f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201e-1f));
+        y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y, z), x), _mm256_set1_ps(1.0f));
+        __m256i n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+    }
+
+    inline __m256 sigmoid_ps(__m256 x)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        return _mm256_div_ps(one, _mm256_add_ps(one, exp_ps(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+    }
+
+    inline float hsum_ps(__m256 v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+
+    // Widens 8 uint8 values to float and applies (q - zp) * scale.
+    inline __m256 dequantize_8(const uint8_t *src, __m256 scale, __m256 zp)
+    {
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src));
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(raw));
+        return _mm256_mul_ps(_mm256_sub_ps(values, zp), scale);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    inline float32x4_t exp_ps(float32x4_t x)
+    {
+        x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-88.3762626647949f)), vdupq_n_f32(88.3762626647949f));
+        float32x4_t fx = vrndmq_f32(vmlaq_f32(vdupq_n_f32(0.5f), x, vdupq_n_f32(1.44269504088896341f)));
+        x = vmlsq_f32(x, fx, vdupq_n_f32(0.693359375f));
+        x = vmlsq_f32(x, fx, vdupq_n_f32(-2.12194440e-4f));
+        float32x4_t z = vmulq_f32(x, x);
+        float32x4_t y = vdupq_n_f32(1.9875691500e-4f);
+        y = vmlaq_f32(vdupq_n_f32(1.3981999507e-3f), y, x);
+        y = vmlaq_f32(vdupq_n_f32(8.3334519073e-3f), y, x);
+        y = vmlaq_f32(vdupq_n_f32(4.1665795894e-2f), y, x);
+        y = vmlaq_f32(vdupq_n_f32(1.6666665459e-1f), y, x);
+        y = vmlaq_f32(vdupq_n_f32(5.0000001201e-1f), y, x);
+        y = vaddq_f32(vmlaq_f32(x, y, z), vdupq_n_f32(1.0f));
+        int32x4_t n = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(fx), vdupq_n_s32(127)), 23);
+        return vmulq_f32(y, vreinterpretq_f32_s32(n));
+    }
+
+    inline float32x4_t sigmoid_ps(float32x4_t x)
+    {
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        return vdivq_f32(one, vaddq_f32(one, exp_ps(vnegq_f32(x))));
+    }
+
+    // Widens 16 uint8 values to float and applies (q - zp) * scale.
+    inline void dequantize_16(const uint8_t *src, float32x4_t scale, float32x4_t zp, float32x4_t out[4])
+    {
+        uint8x16_t raw = vld1q_u8(src);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(raw));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(raw));
+        out[0] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), zp), scale);
+        out[1] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), zp), scale);
+        out[2] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), zp), scale);
+        out[3] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), zp), scale);
+    }
+#endif
+
+    //-------------------------------
+    // DEQUANTIZATION
+    //-------------------------------
+    inline void dequantize(const uint8_t *src, float *dst, size_t size, float qp_scale, float qp_zp)
+    {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256 scale = _mm256_set1_ps(qp_scale);
+        const __m256 zp = _mm256_set1_ps(qp_zp);
+        for (; i + 8 <= size; i += 8)
+            _mm256_storeu_ps(dst + i, dequantize_8(src + i, scale, zp));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        const float32x4_t scale = vdupq_n_f32(qp_scale);
+        const float32x4_t zp = vdupq_n_f32(qp_zp);
+        float32x4_t values[4];
+        for (; i + 16 <= size; i += 16)
+        {
+            dequantize_16(src + i, scale, zp, values);
+            for (int k = 0; k < 4; k++)
+                vst1q_f32(dst + i + 4 * k, values[k]);
+        }
+#endif
+        for (; i < size; i++)
+            dst[i] = (float(src[i]) - qp_zp) * qp_scale;
+    }
+
+    //-------------------------------
+    // SOFTMAX
+    //-------------------------------
+    /**
+     * @brief In-place softmax with max subtraction. exp is evaluated once per element.
+     */
+    inline void softmax(float *data, size_t size)
+    {
+        if (size == 0)
+            return;
+        float max = *std::max_element(data, data + size);
+        float sum = 0.0f;
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256 max_vec = _mm256_set1_ps(max);
+        __m256 sum_vec = _mm256_setzero_ps();
+        for (; i + 8 <= size; i += 8)
+        {
+            __m256 e = exp_ps(_mm256_sub_ps(_mm256_loadu_ps(data + i), max_vec));
+            _mm256_storeu_ps(data + i, e);
+            sum_vec = _mm256_add_ps(sum_vec, e);
+        }
+        sum = hsum_ps(sum_vec);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        const float32x4_t max_vec = vdupq_n_f32(max);
+        float32x4_t sum_vec = vdupq_n_f32(0.0f);
+        for (; i + 4 <= size; i += 4)
+        {
+            float32x4_t e = exp_ps(vsubq_f32(vld1q_f32(data + i), max_vec));
+            vst1q_f32(data + i, e);
+            sum_vec = vaddq_f32(sum_vec, e);
+        }
+        sum = vaddvq_f32(sum_vec);
+#endif
+        for (; i < size; i++)
+        {
+            data[i] = std::exp(data[i] - max);
+            sum += data[i];
+        }
+        const float inv_sum = 1.0f / sum;
+        for (i = 0; i < size; i++)
+            data[i] *= inv_sum;
+    }
+
+}
+}
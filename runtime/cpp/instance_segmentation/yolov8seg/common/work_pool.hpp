@@ -0,0 +1,434 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace common
+{
+    /**
+     * @brief Per-thread scratch memory. allocate() bumps through a buffer that is reset before every
+     *        task and grows to the high-water mark, so steady state allocates nothing. local<T>() keeps
+     *        one T per arena for the life of the thread, for objects that carry their own buffers.
+     */
+    class ScratchArena
+    {
+    public:
+        template <typename T>
+        T *allocate(size_t count)
+        {
+            const size_t alignment = alignof(T) < alignof(std::max_align_t) ? alignof(std::max_align_t) : alignof(T);
+            const size_t bytes = count * sizeof(T);
+            size_t offset = aligned_offset(m_used, alignment);
+            if (offset + bytes > m_capacity)
+            {
+                // Earlier allocations stay valid in the old block until reset() merges them
+                m_retired.push_back(std::move(m_buffer));
+                m_retired_bytes += m_capacity;
+                m_capacity = std::max(bytes + alignment - 1, m_capacity * 2);
+                m_buffer.reset(new std::max_align_t[(m_capacity + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+                offset = aligned_offset(0, alignment);
+            }
+            m_used = offset + bytes;
+            return reinterpret_cast<T *>(reinterpret_cast<unsigned char *>(m_buffer.get()) + offset);
+        }
+
+        void reset()
+        {
+            if (!m_retired.empty())
+            {
+                // One buffer big enough for everything the last use needed
+                m_retired.clear();
+                m_capacity += m_retired_bytes;
+                m_retired_bytes = 0;
+                m_buffer.reset(new std::max_align_t[(m_capacity + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+            }
+            m_used = 0;
+        }
+
+        template <typename T>
+        T &local()
+        {
+            static const char key = 0;  // One address per type
+            for (auto &entry : m_locals)
+                if (entry.first == &key)
+                    return *static_cast<T *>(entry.second.get());
+            m_locals.emplace_back(&key, std::shared_ptr<void>(std::make_shared<T>()));
+            return *static_cast<T *>(m_locals.back().second.get());
+        }
+
+    private:
+        // The block is only max_align_t aligned, so over-aligned types (__m256) pad the address, not the offset
+        size_t aligned_offset(size_t offset, size_t alignment) const
+        {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(m_buffer.get()) + offset;
+            return offset + ((alignment - address % alignment) % alignment);
+        }
+
+        std::unique_ptr<std::max_align_t[]> m_buffer;
+        size_t m_capacity = 0;
+        size_t m_used = 0;
+        std::vector<std::unique_ptr<std::max_align_t[]>> m_retired;
+        size_t m_retired_bytes = 0;
+        std::vector<std::pair<const void *, std::shared_ptr<void>>> m_locals;
+    };
+
+    /**
+     * @brief How many workers the pool runs and where. cpus empty leaves placement to the scheduler,
+     *        otherwise every worker may only run on those cores (keep them off the capture and NPU
+     *        I/O threads). threads 0 runs all the work on the calling thread.
+     */
+    struct WorkPoolConfig
+    {
+        size_t threads = 2;
+        std::vector<int> cpus;
+
+        // "2,3" or "2-3", like taskset -c
+        static std::vector<int> parse_cpus(const std::string &list)
+        {
+            std::vector<int> cpus;
+            std::stringstream stream(list);
+            std::string item;
+            while (std::getline(stream, item, ','))
+            {
+                try
+                {
+                    const size_t dash = item.find('-');
+                    const int first = std::stoi(item.substr(0, dash));
+                    const int last = std::string::npos == dash ? first : std::stoi(item.substr(dash + 1));
+                    if (first < 0 || last < first)
+                        throw std::invalid_argument(item);
+                    for (int cpu = first; cpu <= last; cpu++)
+                        cpus.push_back(cpu);
+                }
+                catch (const std::logic_error &)
+                {
+                    throw std::runtime_error("Bad CPU list " + list);
+                }
+            }
+            return cpus;
+        }
+    };
+
+    /**
+     * @brief Persistent work-stealing pool for postprocess fan-out. parallel_for() deals the indices
+     *        round-robin to the workers' task rings and the caller helps until they are done; an idle
+     *        worker pops its own ring from the back and steals from the front of the others, so
+     *        uneven tasks (masks of very different areas) balance out. Every thread gets its own
+     *        ScratchArena. Several postprocessors may share one pool; jobs from different callers
+     *        interleave in the same rings.
+     */
+    class WorkPool
+    {
+    public:
+        explicit WorkPool(const WorkPoolConfig &config) : m_queues(config.threads), m_arenas(config.threads), m_cpus(config.cpus)
+        {
+            for (size_t i = 0; i < config.threads; i++)
+                m_threads.emplace_back(&WorkPool::worker_loop, this, i);
+
+            // Every worker pins itself before its first take(); no task can exist before this returns
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_started == m_threads.size(); });
+            if (m_pin_failed)
+            {
+                lock.unlock();
+                stop();
+                throw std::runtime_error("Failed to pin the postprocess workers to the requested CPUs");
+            }
+        }
+
+        ~WorkPool() { stop(); }
+
+        WorkPool(const WorkPool &) = delete;
+        WorkPool &operator=(const WorkPool &) = delete;
+
+        size_t threads() const { return m_threads.size(); }
+
+        /**
+         * @brief Calls function(index, scratch) for every index in [0, count) and returns when all
+         *        calls have returned. The first exception thrown by a call is rethrown here.
+         */
+        template <typename Function>
+        void parallel_for(size_t count, Function &&function)
+        {
+            using Callable = std::remove_reference_t<Function>;
+            ScratchArena &scratch = caller_arena();
+            if (0 == count)
+                return;
+            if (m_threads.empty() || 1 == count)
+            {
+                // Same contract as the pool: every index runs, the first exception comes out at the end
+                std::exception_ptr error;
+                for (size_t i = 0; i < count; i++)
+                {
+                    scratch.reset();
+                    try
+                    {
+                        function(i, scratch);
+                    }
+                    catch (...)
+                    {
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+                if (error)
+                    std::rethrow_exception(error);
+                return;
+            }
+
+            Job job;
+            job.context = const_cast<void *>(static_cast<const void *>(&function));
+            job.invoke = [](void *context, size_t index, ScratchArena &arena) { (*static_cast<Callable *>(context))(index, arena); };
+            job.pending.store(count, std::memory_order_relaxed);
+
+            // Counted before they are pushed, so a worker taking one early never sees the count go negative
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queued += count;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                Queue &queue = m_queues[i % m_queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.push(Task{&job, i});
+            }
+            m_cv.notify_all();
+
+            // Help instead of blocking, then wait for tasks still running on the workers
+            Task task;
+            while (job.pending.load(std::memory_order_acquire) > 0 && take(m_queues.size(), task))
+                run(task, scratch);
+
+            std::unique_lock<std::mutex> lock(job.mutex);
+            job.cv.wait(lock, [&job] { return job.done; });
+            if (job.error)
+                std::rethrow_exception(job.error);
+        }
+
+        // Process-wide pool shared by the postprocessors, created on first use
+        static WorkPool &shared()
+        {
+            started().store(true);
+            static WorkPool pool(shared_config());
+            return pool;
+        }
+
+        // Must be called before the first shared() call
+        static void configure_shared(const WorkPoolConfig &config)
+        {
+            if (started().load())
+                throw std::runtime_error("The shared work pool is already running");
+            shared_config() = config;
+        }
+
+    private:
+        struct Job
+        {
+            void *context;
+            void (*invoke)(void *, size_t, ScratchArena &);
+            std::atomic<size_t> pending{0};
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+            std::exception_ptr error;
+        };
+
+        struct Task
+        {
+            Job *job = nullptr;
+            size_t index = 0;
+        };
+
+        // Ring of tasks: the owner pops the back, thieves pop the front. Only grows.
+        struct Queue
+        {
+            std::mutex mutex;
+            std::vector<Task> ring = std::vector<Task>(64);
+            size_t head = 0;
+            size_t size = 0;
+
+            void push(const Task &task)
+            {
+                if (size == ring.size())
+                {
+                    std::vector<Task> grown(ring.size() * 2);
+                    for (size_t i = 0; i < size; i++)
+                        grown[i] = ring[(head + i) % ring.size()];
+                    ring.swap(grown);
+                    head = 0;
+                }
+                ring[(head + size) % ring.size()] = task;
+                size++;
+            }
+
+            bool pop_back(Task &task)
+            {
+                if (0 == size)
+                    return false;
+                size--;
+                task = ring[(head + size) % ring.size()];
+                return true;
+            }
+
+            bool pop_front(Task &task)
+            {
+                if (0 == size)
+                    return false;
+                task = ring[head];
+                head = (head + 1) % ring.size();
+                size--;
+                return true;
+            }
+        };
+
+        // Callers run tasks too; one arena per calling thread, whatever pool or job
+        static ScratchArena &caller_arena()
+        {
+            thread_local ScratchArena arena;
+            return arena;
+        }
+
+        static WorkPoolConfig &shared_config()
+        {
+            static WorkPoolConfig config;
+            return config;
+        }
+
+        static std::atomic<bool> &started()
+        {
+            static std::atomic<bool> value{false};
+            return value;
+        }
+
+        // Own ring first (self == m_queues.size() for callers, who only steal)
+        bool take(size_t self, Task &task)
+        {
+            bool found = false;
+            if (self < m_queues.size())
+            {
+                std::lock_guard<std::mutex> lock(m_queues[self].mutex);
+                found = m_queues[self].pop_back(task);
+            }
+            for (size_t i = 1; !found && i <= m_queues.size(); i++)
+            {
+                Queue &victim = m_queues[(self + i) % m_queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                found = victim.pop_front(task);
+            }
+            if (found)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queued--;
+            }
+            return found;
+        }
+
+        static void run(const Task &task, ScratchArena &scratch)
+        {
+            Job &job = *task.job;
+            scratch.reset();
+            try
+            {
+                job.invoke(job.context, task.index, scratch);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if (!job.error)
+                    job.error = std::current_exception();
+            }
+            if (1 == job.pending.fetch_sub(1, std::memory_order_acq_rel))
+            {
+                // The caller may return as soon as it sees done, so the job is not touched afterwards
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.done = true;
+                job.cv.notify_all();
+            }
+        }
+
+        // Restricts the calling thread to m_cpus; true when there is nothing to do
+        bool pin_self() const
+        {
+#if defined(__linux__)
+            if (!m_cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (int cpu : m_cpus)
+                    CPU_SET(cpu, &set);
+                return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+#endif
+            return true;
+        }
+
+        void worker_loop(size_t self)
+        {
+            const bool pinned = pin_self();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_started++;
+                m_pin_failed |= !pinned;
+            }
+            m_cv.notify_all();
+
+            Task task;
+            for (;;)
+            {
+                if (take(self, task))
+                {
+                    run(task, m_arenas[self]);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this] { return m_stopping || m_queued > 0; });
+                if (m_stopping)
+                    return;
+            }
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_cv.notify_all();
+            for (auto &thread : m_threads)
+                if (thread.joinable())
+                    thread.join();
+        }
+
+        std::vector<Queue> m_queues;
+        std::vector<ScratchArena> m_arenas;
+        std::vector<int> m_cpus;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        size_t m_queued = 0;
+        size_t m_started = 0;
+        bool m_pin_failed = false;
+        bool m_stopping = false;
+    };
+}
@@ -0,0 +1,211 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file ring_buffer.hpp
+ * @brief Lock-free single-producer/single-consumer ring of reusable buffers, replacing DoubleBuffer
+ **/
+
+#ifndef _HAILO_RING_BUFFER_HPP_
+#define _HAILO_RING_BUFFER_HPP_
+
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * What the producer does when all slots hold unread buffers.
+ */
+enum class BackpressureMode {
+    BLOCK,          // Wait until the consumer releases a slot (lossless, the DoubleBuffer behavior)
+    DROP_OLDEST,    // Evict the oldest unread buffer, the consumer always sees the freshest data
+    DROP_NEWEST,    // Discard the buffer being written, queued buffers are kept
+};
+
+/**
+ * @brief N-slot ring of preallocated std::vector<T> buffers between exactly one producer thread
+ *        and one consumer thread. Same acquire/release interface as DoubleBuffer.
+ *
+ *        The ring carries buffer ids rather than buffers: the producer and the consumer each own the
+ *        buffer they are working on, so an in-progress read is never overwritten, even when the
+ *        producer evicts in DROP_OLDEST mode. Released buffers flow back to the producer through a
+ *        second SPSC ring of free ids. Blocking waits use C++20 atomic wait/notify, no mutexes.
+ */
+template <typename T>
+class RingBuffer {
+public:
+    struct Stats {
+        uint64_t written;       // Buffers published to the consumer
+        uint64_t read;          // Buffers handed to the consumer
+        uint64_t dropped;       // Buffers discarded by DROP_OLDEST / DROP_NEWEST
+        uint32_t occupancy;     // Buffers currently queued
+        uint32_t capacity;
+    };
+
+    RingBuffer(uint32_t size, uint32_t slots = 4, BackpressureMode mode = BackpressureMode::BLOCK) :
+        m_capacity(slots > 0 ? slots : 1), m_mode(mode),
+        // One extra buffer for each side, plus the scratch buffer DROP_NEWEST writes into
+        m_buffers(m_capacity + 3, std::vector<T>(size)),
+        m_queue(std::make_unique<std::atomic<uint32_t>[]>(m_capacity)),
+        m_free(std::make_unique<std::atomic<uint32_t>[]>(m_capacity + 2))
+    {
+        for (uint32_t id = 0; id < m_capacity + 2; id++)
+            m_free[id].store(id, std::memory_order_relaxed);
+        m_free_tail.store(m_capacity + 2, std::memory_order_relaxed);
+    }
+
+    //-------------------------------
+    // PRODUCER
+    //-------------------------------
+    std::vector<T> &get_write_buffer()
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        m_write_discard = false;
+        while (tail - head >= m_capacity) {
+            if (BackpressureMode::DROP_NEWEST == m_mode) {
+                m_write_discard = true;
+                return m_buffers[scratch_id()];
+            }
+            if (BackpressureMode::DROP_OLDEST == m_mode) {
+                // Read the id before claiming it: the slot cannot be reused while head still points at it.
+                // The evicted buffer becomes the next write buffer, it never goes through the free ring.
+                uint32_t id = m_queue[head % m_capacity].load(std::memory_order_relaxed);
+                if (m_head.compare_exchange_strong(head, head + 1, std::memory_order_acq_rel)) {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    assert(NO_ID == m_write_id);
+                    m_write_id = id;
+                    head++;
+                }
+                continue;
+            }
+            m_head.wait(head, std::memory_order_acquire);
+            head = m_head.load(std::memory_order_acquire);
+        }
+        if (NO_ID == m_write_id)
+            m_write_id = pop_free();
+        return m_buffers[m_write_id];
+    }
+
+    void release_write_buffer()
+    {
+        if (m_write_discard) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        m_queue[tail % m_capacity].store(m_write_id, std::memory_order_relaxed);
+        m_write_id = NO_ID;
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_tail.notify_one();
+        m_written.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //-------------------------------
+    // CONSUMER
+    //-------------------------------
+    std::vector<T> &get_read_buffer()
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        for (;;) {
+            uint64_t tail = m_tail.load(std::memory_order_acquire);
+            if (head == tail) {
+                m_tail.wait(tail, std::memory_order_acquire);
+                head = m_head.load(std::memory_order_acquire);
+                continue;
+            }
+            uint32_t id = m_queue[head % m_capacity].load(std::memory_order_relaxed);
+            // Only contended by the producer evicting in DROP_OLDEST mode
+            if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel)) {
+                m_head.notify_one();
+                m_read_id = id;
+                m_read.fetch_add(1, std::memory_order_relaxed);
+                return m_buffers[id];
+            }
+        }
+    }
+
+    void release_read_buffer()
+    {
+        push_free(m_read_id);
+        m_read_id = NO_ID;
+    }
+
+    //-------------------------------
+    // STATISTICS
+    //-------------------------------
+    uint32_t occupancy() const
+    {
+        return static_cast<uint32_t>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    Stats get_stats() const
+    {
+        return Stats{m_written.load(std::memory_order_relaxed), m_read.load(std::memory_order_relaxed),
+                     m_dropped.load(std::memory_order_relaxed), occupancy(), m_capacity};
+    }
+
+    BackpressureMode mode() const { return m_mode; }
+
+private:
+    static constexpr uint32_t NO_ID = UINT32_MAX;
+    static constexpr size_t CACHE_LINE = 64;
+
+    uint32_t scratch_id() const { return m_capacity + 2; }
+
+    // The free ring is pushed by the consumer and popped by the producer
+    void push_free(uint32_t id)
+    {
+        uint64_t tail = m_free_tail.load(std::memory_order_relaxed);
+        m_free[tail % (m_capacity + 2)].store(id, std::memory_order_relaxed);
+        m_free_tail.store(tail + 1, std::memory_order_release);
+    }
+
+    uint32_t pop_free()
+    {
+        // At most capacity - 1 buffers are queued when a free one is requested, at most one is held
+        // by the consumer and none by the producer, so at least two of the capacity + 2 ids are free.
+        uint64_t head = m_free_head;
+        [[maybe_unused]] uint64_t tail = m_free_tail.load(std::memory_order_acquire);
+        assert(tail > head);
+        uint32_t id = m_free[head % (m_capacity + 2)].load(std::memory_order_relaxed);
+        m_free_head = head + 1;
+        return id;
+    }
+
+    const uint32_t m_capacity;
+    const BackpressureMode m_mode;
+    std::vector<std::vector<T>> m_buffers;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_queue;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_free;
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> m_head{0};
+    alignas(CACHE_LINE) std::atomic<uint64_t> m_tail{0};
+    alignas(CACHE_LINE) std::atomic<uint64_t> m_free_tail{0};
+
+    // Producer-owned state
+    alignas(CACHE_LINE) uint64_t m_free_head = 0;
+    uint32_t m_write_id = NO_ID;
+    bool m_write_discard = false;
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_dropped{0};
+
+    // Consumer-owned state
+    alignas(CACHE_LINE) uint32_t m_read_id = NO_ID;
+    std::atomic<uint64_t> m_read{0};
+};
+
+#endif /* _HAILO_RING_BUFFER_HPP_ */
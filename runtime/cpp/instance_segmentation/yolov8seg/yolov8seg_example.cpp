@@ -3,8 +3,11 @@
 
 #include "common/hailo_objects.hpp"
 #include "yolov8seg_postprocess.hpp"
+#include "common/work_pool.hpp"
+#include "common/frame_arena.hpp"
 
 #include <iostream>
+#include <fstream>
 #include <chrono>
 #include <mutex>
 #include <future>
@@ -44,14 +47,44 @@ std::string info_to_str(hailo_vstream_info_t vstream_info) {
 }
 
 
+// One JSON object per line and frame. Each mask is exported as it is kept: uncompressed RLE counts over
+// its box in row-major order, alternating background and foreground, starting with background.
+void write_masks_json(std::ostream &out, size_t frame, const std::vector<HailoDetectionPtr> &detections,
+                      const std::pmr::vector<common::RleMask> &masks) {
+    static std::vector<uint32_t> counts;
+    out << "{\"frame\": " << frame << ", \"instances\": [";
+    for (size_t i = 0; i < std::min(detections.size(), masks.size()); i++) {
+        const common::RleMask &mask = masks[i];
+        common::mask_counts(mask, counts);
+        out << (i ? ", " : "") << "{\"label\": \"" << detections[i]->get_label() << "\", \"confidence\": "
+            << detections[i]->get_confidence() << ", \"box\": [" << mask.x << ", " << mask.y << ", " << mask.width
+            << ", " << mask.height << "], \"area\": " << mask.area << ", \"counts\": [";
+        for (size_t k = 0; k < counts.size(); k++)
+            out << (k ? "," : "") << counts[k];
+        out << "]}";
+    }
+    out << "]}\n";
+}
+
 template <typename T>
 hailo_status post_processing_all(std::vector<std::shared_ptr<FeatureData<T>>> &features, size_t frame_count, 
                                 std::chrono::time_point<std::chrono::system_clock>& postprocess_time, std::vector<cv::Mat>& frames, 
-                                double org_height, double org_width, bool nms_on_hailo, std::string model_type) {
+                                double org_height, double org_width, const common::ModelDescriptor& model, 
+                                bool nms_on_hailo, std::string model_type, std::string masks_path) {
 
     auto status = HAILO_SUCCESS;
 
-    std::sort(features.begin(), features.end(), &FeatureData<T>::sort_tensors_by_size);
+    std::ofstream masks_file;
+    if (!masks_path.empty()) {
+        masks_file.open(masks_path);
+        if (!masks_file) {
+            std::cerr << "Failed to open " << masks_path << std::endl;
+            return HAILO_OPEN_FILE_FAILURE;
+        }
+    }
+
+    // Stable, so outputs of the same size keep the order the HEF lists them in (boxes, scores, masks)
+    std::stable_sort(features.begin(), features.end(), &FeatureData<T>::sort_tensors_by_size);
 
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -63,14 +96,19 @@ hailo_status post_processing_all(std::vector<std::shared_ptr<FeatureData<T>>> &f
     std::cout << YELLOW << "\n-I- Starting postprocessing\n" << std::endl << RESET;
     m.unlock();
 
+    // Everything the postprocess builds for a frame comes from here and is dropped at once when the frame ends
+    common::FrameArena arena;
+
     for (size_t i = 0; i < frame_count; i++){
-        HailoROIPtr roi = std::make_shared<HailoROI>(HailoROI(HailoBBox(0.0f, 0.0f, 1.0f, 1.0f)));
+        common::FrameScope frame_scope(arena);
+        std::pmr::polymorphic_allocator<HailoROI> frame_allocator(&arena);
+        HailoROIPtr roi = std::allocate_shared<HailoROI>(frame_allocator, HailoBBox(0.0f, 0.0f, 1.0f, 1.0f));
         
         for (uint j = 0; j < features.size(); j++) {
-            roi->add_tensor(std::make_shared<HailoTensor>(reinterpret_cast<T*>(features[j]->m_buffers.get_read_buffer().data()), features[j]->m_vstream_info));
+            roi->add_tensor(std::allocate_shared<HailoTensor>(frame_allocator, reinterpret_cast<T*>(features[j]->m_buffers.get_read_buffer().data()), features[j]->m_vstream_info));
         }
 
-        auto filtered_masks = filter(roi, (int)org_height, (int)org_width);
+        auto filtered_masks = filter(roi, model, (int)org_height, (int)org_width, &arena);
     
         for (auto &feature : features) {
             feature->m_buffers.release_read_buffer();
@@ -93,19 +131,21 @@ hailo_status post_processing_all(std::vector<std::shared_ptr<FeatureData<T>>> &f
             std::cout << "Detection: " << detection->get_label() << ", Confidence: " << std::fixed << std::setprecision(2) << detection->get_confidence() * 100.0 << "%" << std::endl;
         }
 
+        if (masks_file.is_open()) {
+            write_masks_json(masks_file, i, detections, filtered_masks);
+        }
+
+        // The overlay is blended straight from the mask runs, half the mask color added to the frame
         for (auto& mask : filtered_masks){
-            cv::Mat overlay = cv::Mat(frames[0].rows, frames[0].cols, CV_8UC3, cv::Scalar(0));
             auto pixel_color = COLORS[random_index(gen)];
-            for (int r = 0; r < mask.rows; r++) {
-                for (int c = 0; c < mask.cols ; c++) {
-                    if (mask.at<float>(r, c) > 0.7) {
-                        overlay.at<cv::Vec3b>(r,c) = pixel_color;
+            common::for_each_run(mask, [&](int y, int x_begin, int x_end) {
+                cv::Vec3b *row = frames[0].ptr<cv::Vec3b>(y);
+                for (int x = x_begin; x < x_end; x++) {
+                    for (int channel = 0; channel < 3; channel++) {
+                        row[x][channel] = cv::saturate_cast<uchar>(row[x][channel] + 0.5 * pixel_color[channel]);
                     }
                 }
-            }
-            cv::addWeighted(frames[0], 1, overlay, 0.5, 0.0, frames[0]);
-            overlay.release();
-            mask.release();
+            });
         }
 
         // cv::imshow("Display window", frames[0]);
@@ -123,6 +163,12 @@ hailo_status post_processing_all(std::vector<std::shared_ptr<FeatureData<T>>> &f
     postprocess_time = std::chrono::high_resolution_clock::now();
     // video.release();
 
+    m.lock();
+    std::cout << YELLOW << "-I- Postprocess frame arena: " << arena.capacity() / 1024 << " KiB, peak frame "
+              << arena.high_water() / 1024 << " KiB, " << arena.total().allocations << " allocations served, "
+              << arena.total().upstream_allocations << " from the heap" << std::endl << RESET;
+    m.unlock();
+
     return status;
 }
 
@@ -250,7 +296,8 @@ template <typename T>
 hailo_status run_inference(std::vector<InputVStream>& input_vstream, std::vector<OutputVStream>& output_vstreams, std::string input_path,
                     std::chrono::time_point<std::chrono::system_clock>& write_time_vec,
                     std::chrono::duration<double>& inference_time, std::chrono::time_point<std::chrono::system_clock>& postprocess_time, 
-                    size_t frame_count, double org_height, double org_width, std::string cmd_img_num) {
+                    size_t frame_count, double org_height, double org_width, std::string cmd_img_num,
+                    std::string model_config, std::string masks_path) {
 
     hailo_status status = HAILO_UNINITIALIZED;
 
@@ -265,6 +312,25 @@ hailo_status run_inference(std::vector<InputVStream>& input_vstream, std::vector
         model_type = output_name.substr(0, output_name.find('/'));
     }
 
+    // Geometry comes from the HEF, -config=FILE sets thresholds (or overrides what the HEF cannot tell)
+    common::ModelDescriptor model = default_seg_model();
+    if (!nms_on_hailo) {
+        std::vector<hailo_vstream_info_t> output_infos;
+        for (auto &output_vstream : output_vstreams)
+            output_infos.push_back(output_vstream.get_info());
+        output_infos = common::postprocess_order(std::move(output_infos));
+        try {
+            common::describe_model(input_vstream[0].get_info(), output_infos, model);
+            if (!model_config.empty())
+                common::load_model_config(model_config, model);
+            common::validate_model(model, output_infos);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Unsupported model: " << e.what() << std::endl;
+            return HAILO_INVALID_HEF;
+        }
+    }
+
     std::vector<std::shared_ptr<FeatureData<T>>> features;
     features.reserve(output_vstreams_size);
     for (size_t i = 0; i < output_vstreams_size; i++) {
@@ -291,7 +357,7 @@ hailo_status run_inference(std::vector<InputVStream>& input_vstream, std::vector
     }
 
     // Create the postprocessing thread
-    auto pp_thread(std::async(post_processing_all<T>, std::ref(features), frame_count, std::ref(postprocess_time), std::ref(frames), org_height, org_width, nms_on_hailo, model_type));
+    auto pp_thread(std::async(post_processing_all<T>, std::ref(features), frame_count, std::ref(postprocess_time), std::ref(frames), org_height, org_width, std::cref(model), nms_on_hailo, model_type, masks_path));
 
     for (size_t i = 0; i < output_threads.size(); i++) {
         status = output_threads[i].get();
@@ -387,6 +453,27 @@ int main(int argc, char** argv) {
     std::string yolov_hef      = getCmdOption(argc, argv, "-hef=");
     std::string input_path      = getCmdOption(argc, argv, "-input=");
     std::string image_num      = getCmdOption(argc, argv, "-num=");
+    // -config=FILE holds key = value model settings, see common/model_descriptor.hpp
+    std::string model_config   = getCmdOption(argc, argv, "-config=");
+    // -masks=PATH writes every frame's detections and run-length masks as JSON lines
+    std::string masks_path     = getCmdOption(argc, argv, "-masks=");
+    // -pp_threads=N mask decoding workers (0: on the postprocess thread), -pp_cpus=LIST the cores they may use
+    std::string pp_threads     = getCmdOption(argc, argv, "-pp_threads=");
+    std::string pp_cpus        = getCmdOption(argc, argv, "-pp_cpus=");
+
+    try {
+        common::WorkPoolConfig pool_config;
+        if (!pp_threads.empty())
+            pool_config.threads = std::stoul(pp_threads);
+        if (!pp_cpus.empty())
+            pool_config.cpus = common::WorkPoolConfig::parse_cpus(pp_cpus);
+        common::WorkPool::configure_shared(pool_config);
+        common::WorkPool::shared();     // Started now, so bad CPUs fail here and not mid-stream
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Bad postprocess pool options: " << e.what() << std::endl;
+        return HAILO_INVALID_ARGUMENT;
+    }
 
     std::chrono::time_point<std::chrono::system_clock> write_time_vec;
     std::chrono::time_point<std::chrono::system_clock> postprocess_end_time;
@@ -444,7 +531,7 @@ int main(int argc, char** argv) {
                         std::ref(vstreams.second), 
                         input_path, 
                         write_time_vec, inference_time, postprocess_end_time, 
-                        frame_count, org_height, org_width, image_num);      
+                        frame_count, org_height, org_width, image_num, model_config, masks_path);      
 
     if (HAILO_SUCCESS != status) {
         std::cerr << "Failed running inference with status = " << status << std::endl;
@@ -4,12 +4,22 @@
 **/
 // General includes
 #include <iostream>
+#include <iterator>
+#include <memory_resource>
 #include <vector>
 #include <cmath>
+#include <stdexcept>
+#include <string>
 
 // Hailo includes
 #include "common/math.hpp"
 #include "common/nms.hpp"
+#include "common/anchor_grid.hpp"
+#include "common/quant_lut.hpp"
+#include "common/nms_engine.hpp"
+#include "common/model_descriptor.hpp"
+#include "common/mask_gemm.hpp"
+#include "common/work_pool.hpp"
 #include "common/hailo_objects.hpp"
 #include "common/tensors.hpp"
 #include "common/labels/coco_eighty.hpp"
@@ -17,300 +27,195 @@
 
 using namespace xt::placeholders;
 
-#define SCORE_THRESHOLD 0.6
-#define IOU_THRESHOLD 0.7
-#define NUM_CLASSES 80
-
-cv::Mat xarray_to_mat(xt::xarray<float> xarr) {
-    cv::Mat mat (xarr.shape()[0], xarr.shape()[1], CV_32FC1, xarr.data(), 0);
-    return mat;
-}
-
-
-void sigmoid(float *data, const int size) {
-    for (int i = 0; i < size; i++)
-        data[i] = 1.0f / (1.0f + std::exp(-1.0 * data[i]));
-}
-
-cv::Mat crop_mask(cv::Mat mask, HailoBBox box) {
+/**
+ * @brief The pixels of the original image inside the box, clipped to the image.
+ */
+cv::Rect mask_roi(HailoBBox box, int rows, int cols) {
     auto x_min = box.xmin();
     auto y_min = box.ymin(); 
     auto x_max = box.xmax(); 
     auto y_max = box.ymax();
 
-    int rows = mask.rows;
-    int cols = mask.cols;
-
     // Ensure ROI coordinates are within the valid range
     int top_start = std::max(0, static_cast<int>(std::ceil(y_min * rows)));
     int bottom_end = std::min(rows, static_cast<int>(std::ceil(y_max * rows)));
     int left_start = std::max(0, static_cast<int>(std::ceil(x_min * cols)));
     int right_end = std::min(cols, static_cast<int>(std::ceil(x_max * cols)));
 
-    // Create ROI rectangles
-    cv::Rect top_roi(0, 0, cols, top_start);
-    cv::Rect bottom_roi(0, bottom_end, cols, rows - bottom_end);
-    cv::Rect left_roi(0, 0, left_start, rows);
-    cv::Rect right_roi(right_end, 0, cols - right_end, rows);
-
-    // Set values to zero in the specified ROIs
-    mask(top_roi) = 0;
-    mask(bottom_roi) = 0;
-    mask(left_roi) = 0;
-    mask(right_roi) = 0;
-    
-    return mask;
-}
-
-xt::xarray<float> dot(xt::xarray<float> mask, xt::xarray<float> reshaped_proto, 
-                    size_t proto_height, size_t proto_width, size_t mask_num = 32){
-    
-    auto shape = {proto_height, proto_width};
-    xt::xarray<float> mask_product(shape);
-
-    for (size_t i = 0; i < mask_product.shape(0); i++) {
-        for (size_t j = 0; j < mask_product.shape(1); j++) {
-            for (size_t k = 0; k < mask_num; k++) {
-                mask_product(i,j) += mask(k) * reshaped_proto(k, i, j);
-            }
-        }
-    }
-    return mask_product;
-}
-
-std::vector<DetectionAndMask> decode_masks(std::vector<std::pair<HailoDetection, xt::xarray<float>>> detections_and_masks_after_nms, 
-                                                                        xt::xarray<float> proto, int org_image_height, int org_image_width){
-    
-    std::vector<DetectionAndMask> detections_and_cropped_masks(detections_and_masks_after_nms.size(), 
-                                                                DetectionAndMask({
-                                                                    HailoDetection(HailoBBox(0.0,0.0,0.0,0.0), "", 0.0), 
-                                                                    cv::Mat(org_image_height, org_image_width, CV_32FC1)}
-                                                                    ));
-
-    int mask_height = static_cast<int>(proto.shape(0));
-    int mask_width = static_cast<int>(proto.shape(1));
-    int mask_features = static_cast<int>(proto.shape(2));
-
-    auto reshaped_proto = xt::reshape_view(xt::transpose(xt::reshape_view(proto, {-1, mask_features}), {1,0}), {-1, mask_height, mask_width});
-    
-    for (int i = 0; i < detections_and_masks_after_nms.size(); i++) {
-
-        auto curr_detection = detections_and_masks_after_nms[i].first;
-        auto curr_mask = detections_and_masks_after_nms[i].second;
-
-        auto mask_product = dot(curr_mask, reshaped_proto, reshaped_proto.shape(1), reshaped_proto.shape(2), curr_mask.shape(0));
-
-        sigmoid(mask_product.data(), mask_product.size());
-
-        cv::Mat mask = xarray_to_mat(mask_product).clone();
-        cv::resize(mask, mask, cv::Size(org_image_width, org_image_height), 0, 0, cv::INTER_LINEAR);
-
-        mask = crop_mask(mask, curr_detection.get_bbox());
-
-        detections_and_cropped_masks[i] = DetectionAndMask({curr_detection, mask});
-    }
-
-    return detections_and_cropped_masks;
+    if (bottom_end <= top_start || right_end <= left_start)
+        return cv::Rect();
+    return cv::Rect(left_start, top_start, right_end - left_start, bottom_end - top_start);
 }
 
-
-float iou_calc(const HailoBBox &box_1, const HailoBBox &box_2)
+/**
+ * @brief Buffers and tables reused across frames, the buffers only grow. Each postprocess thread
+ *        has its own, so filter() may run on several threads at once, and the anchor grid and
+ *        tables are looked up in the process-wide caches only when the model changes. The pool
+ *        workers reach it through the caller's reference, never through thread_workspace().
+ */
+struct SegWorkspace {
+    SegProposals proposals;
+    common::NmsEngine nms_engine;
+    common::PrototypeMatrix prototypes;
+    std::vector<common::RleMask> encoded;   // The workers encode here, never into the frame's memory
+    common::AnchorGridSlot grid;
+    common::QuantLutSlots box_luts;         // One per output level
+    common::QuantLutSlots mask_luts;        // One per output level
+    common::QuantLutSlots proto_lut;        // A single slot
+};
+
+static SegWorkspace &thread_workspace()
 {
-    // Calculate IOU between two detection boxes
-    const float width_of_overlap_area = std::min(box_1.xmax(), box_2.xmax()) - std::max(box_1.xmin(), box_2.xmin());
-    const float height_of_overlap_area = std::min(box_1.ymax(), box_2.ymax()) - std::max(box_1.ymin(), box_2.ymin());
-    const float positive_width_of_overlap_area = std::max(width_of_overlap_area, 0.0f);
-    const float positive_height_of_overlap_area = std::max(height_of_overlap_area, 0.0f);
-    const float area_of_overlap = positive_width_of_overlap_area * positive_height_of_overlap_area;
-    const float box_1_area = (box_1.ymax() - box_1.ymin()) * (box_1.xmax() - box_1.xmin());
-    const float box_2_area = (box_2.ymax() - box_2.ymin()) * (box_2.xmax() - box_2.xmin());
-    // The IOU is a ratio of how much the boxes overlap vs their size outside the overlap.
-    // Boxes that are similar will have a higher overlap threshold.
-    return area_of_overlap / (box_1_area + box_2_area - area_of_overlap);
+    thread_local SegWorkspace workspace;
+    return workspace;
 }
 
-std::vector<std::pair<HailoDetection, xt::xarray<float>>> nms(std::vector<std::pair<HailoDetection, xt::xarray<float>>> &detections_and_masks, 
-                                                            const float iou_thr, bool should_nms_cross_classes = false) {
-
-    std::vector<std::pair<HailoDetection, xt::xarray<float>>> detections_and_masks_after_nms;
+/**
+ * @brief Decodes the mask of every detection inside its box only. The prototypes are dequantized
+ *        and transposed once, then each detection multiplies its coefficients with just the
+ *        prototype pixels under its box and resamples just the box, so the cost follows the
+ *        objects' area. Values are those of the full-frame sigmoid -> resize -> crop, thresholded
+ *        and run-length encoded as soon as each box is decoded. Boxes are independent and are
+ *        decoded in parallel on the shared work pool.
+ */
+std::pmr::vector<DetectionAndMask> decode_masks(const SegDetections &detections, const common::TensorView &proto,
+                                                float mask_threshold, int org_image_height, int org_image_width,
+                                                SegWorkspace &workspace, std::pmr::memory_resource *memory){
+    std::pmr::vector<DetectionAndMask> detections_and_cropped_masks(memory);
+    const size_t count = detections.detections.size();
+    if (0 == count)
+        return detections_and_cropped_masks;
 
-    for (uint index = 0; index < detections_and_masks.size(); index++)
-    {
-        if (detections_and_masks[index].first.get_confidence() != 0.0f)
-        {
-            for (uint jindex = index + 1; jindex < detections_and_masks.size(); jindex++)
-            {
-                if ((should_nms_cross_classes || (detections_and_masks[index].first.get_class_id() == detections_and_masks[jindex].first.get_class_id())) &&
-                    detections_and_masks[jindex].first.get_confidence() != 0.0f)
-                {
-                    // For each detection, calculate the IOU against each following detection.
-                    float iou = iou_calc(detections_and_masks[index].first.get_bbox(), detections_and_masks[jindex].first.get_bbox());
-                    // If the IOU is above threshold, then we have two similar detections,
-                    // and want to delete the one.
-                    if (iou >= iou_thr)
-                    {
-                        // The detections are arranged in highest score order,
-                        // so we want to erase the latter detection.
-                        detections_and_masks[jindex].first.set_confidence(0.0f);
-                    }
-                }
-            }
-        }
-    }
-    for (uint index = 0; index < detections_and_masks.size(); index++)
-    {
-        if (detections_and_masks[index].first.get_confidence() != 0.0f)
-        {
-            detections_and_masks_after_nms.push_back(std::make_pair(detections_and_masks[index].first, detections_and_masks[index].second));
-        }
+    // `memory` may only be allocated from on this thread, the workers encode into the workspace
+    common::PrototypeMatrix &prototypes = workspace.prototypes;
+    std::vector<common::RleMask> &encoded = workspace.encoded;
+
+    const common::QuantLut &proto_lut = workspace.proto_lut.get(0, proto.qp_scale(), proto.qp_zp());
+    prototypes.load(proto.data_uint8(), proto.height(), proto.width(), proto.features(), proto_lut);
+    if (prototypes.features != detections.features)
+        throw std::runtime_error("Detections have " + std::to_string(detections.features) + " mask coefficients, the prototypes " +
+                                 std::to_string(prototypes.features) + " features");
+
+    std::pmr::vector<cv::Rect> rois(count, memory);
+    if (encoded.size() < count)
+        encoded.resize(count);
+    detections_and_cropped_masks.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        detections_and_cropped_masks.push_back(DetectionAndMask{detections.detections[i], common::RleMask(memory)});
+        rois[i] = mask_roi(detections.detections[i].box, org_image_height, org_image_width);
     }
-    return detections_and_masks_after_nms;
-}
-
-float dequantize_value(uint8_t val, float32_t qp_scale, float32_t qp_zp){
-    return (float(val) - qp_zp) * qp_scale;
-}
 
-void dequantize_mask_values(xt::xarray<float>& dequantized_outputs, int index, 
-                        xt::xarray<uint8_t>& quantized_outputs,
-                        size_t dim1, float32_t qp_scale, float32_t qp_zp){
-    for (size_t i = 0; i < dim1; i++){
-        dequantized_outputs(i) = dequantize_value(quantized_outputs(index, i), qp_scale, qp_zp);
-    }
-}
-                   
-void dequantize_box_values(xt::xarray<float>& dequantized_outputs, int index, 
-                        xt::xarray<uint8_t>& quantized_outputs,
-                        size_t dim1, size_t dim2, float32_t qp_scale, float32_t qp_zp){
-    for (size_t i = 0; i < dim1; i++){
-        for (size_t j = 0; j < dim2; j++){
-            dequantized_outputs(i, j) = dequantize_value(quantized_outputs(index, i, j), qp_scale, qp_zp);
-        }
+    // Each task writes only its own mask; decoder and buffers come from the running thread's arena
+    common::WorkPool::shared().parallel_for(count, [&](size_t i, common::ScratchArena &scratch) {
+        const cv::Rect &roi = rois[i];
+        if (roi.empty())
+            return;
+        float *probabilities = scratch.allocate<float>(size_t(roi.width) * size_t(roi.height));
+        auto &decoder = scratch.local<common::RoiMaskDecoder>();
+        auto &bits = scratch.local<std::vector<uint64_t>>();
+        decoder.decode(detections.coefficients.data() + i * detections.features, prototypes,
+                       org_image_width, org_image_height, roi.x, roi.y, roi.width, roi.height, probabilities);
+        common::encode_mask(probabilities, roi.x, roi.y, roi.width, roi.height, mask_threshold, encoded[i], bits);
+    });
+
+    // Assignment copies the runs into the masks' own memory
+    for (size_t i = 0; i < count; i++) {
+        if (!rois[i].empty())
+            detections_and_cropped_masks[i].mask = encoded[i];
     }
+    return detections_and_cropped_masks;
 }
 
-std::vector<xt::xarray<double>> get_centers(std::vector<int>& strides, std::vector<int>& network_dims,
-                                        std::size_t boxes_num, int strided_width, int strided_height){
-
-        std::vector<xt::xarray<double>> centers(boxes_num);
-
-        for (uint i=0; i < boxes_num; i++) {
-            strided_width = network_dims[0] / strides[i];
-            strided_height = network_dims[1] / strides[i];
-
-            // Create a meshgrid of the proper strides
-            xt::xarray<int> grid_x = xt::arange(0, strided_width);
-            xt::xarray<int> grid_y = xt::arange(0, strided_height);
-
-            auto mesh = xt::meshgrid(grid_x, grid_y);
-            grid_x = std::get<1>(mesh);
-            grid_y = std::get<0>(mesh);
 
-            // Use the meshgrid to build up box center prototypes
-            auto ct_row = (xt::flatten(grid_y) + 0.5) * strides[i];
-            auto ct_col = (xt::flatten(grid_x) + 0.5) * strides[i];
-
-            centers[i] = xt::stack(xt::xtuple(ct_col, ct_row, ct_col, ct_row), 1);
-        }
-
-        return centers;
+/**
+ * @brief Decodes the boxes of the candidates into the SoA proposals, slot n holds candidates[n].
+ *        Mask coefficients are left in the raw tensors until NMS has picked the survivors.
+ *        Geometry is a common::Dfl16Geometry or common::DynamicGeometry (see dispatch_geometry).
+ */
+template <typename Geometry>
+void decode_boxes(const Geometry &geometry,
+                  const std::pmr::vector<common::TensorView> &raw_boxes_outputs,
+                  std::pmr::vector<common::Candidate> &candidates,
+                  const common::ModelDescriptor &model,
+                  SegWorkspace &workspace) {
+    // Anchor centers depend only on the geometry, they are built once and shared across frames
+    const common::AnchorGrid &grid = workspace.grid.get(model.network_dims(), model.strides);
+    SegProposals &proposals = workspace.proposals;
+    proposals.count = 0;
+    proposals.reserve(candidates.size());
+
+    // Bbox decoding, only for the anchors that passed the quantized score threshold
+    for (const auto &candidate : candidates) {
+        uint i = candidate.stride_index;
+        uint j = candidate.index;
+
+        // Box distribution to distance: each side is a distribution over the bins,
+        // read straight from the output buffer
+        const uint8_t *box_data = raw_boxes_outputs[i].anchor<uint8_t>(j);
+        const common::QuantLut &box_lut = workspace.box_luts.get(i, raw_boxes_outputs[i].qp_scale(), raw_boxes_outputs[i].qp_zp());
+        float strided_distances[4];
+        for (int side = 0; side < 4; side++)
+            strided_distances[side] = geometry.dfl(box_data + side * geometry.bins(), box_lut) * model.strides[i];
+
+        // Decode box around the anchor center: (x1, y1) = center - d[0:2], (x2, y2) = center + d[2:4]
+        auto centers = grid.centers(i);
+        float center_x = centers[2 * j];
+        float center_y = centers[2 * j + 1];
+
+        size_t index = proposals.count++;
+        proposals.xmin[index] = (center_x - strided_distances[0]) * geometry.inv_width();
+        proposals.ymin[index] = (center_y - strided_distances[1]) * geometry.inv_height();
+        proposals.xmax[index] = (center_x + strided_distances[2]) * geometry.inv_width();
+        proposals.ymax[index] = (center_y + strided_distances[3]) * geometry.inv_height();
+        proposals.scores[index] = candidate.score;
+        proposals.class_ids[index] = candidate.class_id;
+    }
 }
 
-
-std::vector<std::pair<HailoDetection, xt::xarray<float>>> decode_boxes_and_extract_masks(std::vector<HailoTensorPtr> raw_boxes_outputs,
-                                                                                std::vector<HailoTensorPtr> raw_masks_outputs,
-                                                                                xt::xarray<float> scores,
-                                                                                std::vector<int> network_dims,
-                                                                                std::vector<int> strides,
-                                                                                int regression_length) {
-    int strided_width, strided_height, class_index;
-    std::vector<std::pair<HailoDetection, xt::xarray<float>>> detections_and_masks;
-    int instance_index = 0;
-    float confidence = 0.0;
-    std::string label;
-
-    auto centers = get_centers(std::ref(strides), std::ref(network_dims), raw_boxes_outputs.size(), strided_width, strided_height);
-
-    // Box distribution to distance
-    auto regression_distance =  xt::reshape_view(xt::arange(0, regression_length + 1), {1, 1, regression_length + 1});
-
-    for (uint i = 0; i < raw_boxes_outputs.size(); i++)
-    {
-        // Boxes setup
-        float32_t qp_scale = raw_boxes_outputs[i]->vstream_info().quant_info.qp_scale;
-        float32_t qp_zp = raw_boxes_outputs[i]->vstream_info().quant_info.qp_zp;
-
-        auto output_b = common::get_xtensor(raw_boxes_outputs[i]);
-        int num_proposals = output_b.shape(0) * output_b.shape(1);
-        auto output_boxes = xt::view(output_b, xt::all(), xt::all(), xt::all());
-        xt::xarray<uint8_t> quantized_boxes = xt::reshape_view(output_boxes, {num_proposals, 4, regression_length + 1});
-
-        auto shape = {quantized_boxes.shape(1), quantized_boxes.shape(2)};
-
-        // Masks setup
-        float32_t qp_scale_mask = raw_masks_outputs[i]->vstream_info().quant_info.qp_scale;
-        float32_t qp_zp_mask = raw_masks_outputs[i]->vstream_info().quant_info.qp_zp;
-
-        auto output_m = common::get_xtensor(raw_masks_outputs[i]);
-        int num_proposals_masks = output_m.shape(0) * output_m.shape(1);
-        auto output_masks = xt::view(output_m, xt::all(), xt::all(), xt::all());
-        xt::xarray<uint8_t> quantized_masks = xt::reshape_view(output_masks, {num_proposals_masks, 32});
-
-        auto mask_shape = {quantized_masks.shape(1)};
-
-        // Bbox decoding
-        for (uint j = 0; j < num_proposals; j++) {
-            class_index = xt::argmax(xt::row(scores, instance_index))(0);
-            confidence = scores(instance_index, class_index);
-            instance_index++;
-            if (confidence < SCORE_THRESHOLD)
-                continue;
-
-            xt::xarray<float> box(shape);
-    
-            dequantize_box_values(box, j, quantized_boxes, 
-                                    box.shape(0), box.shape(1), 
-                                    qp_scale, qp_zp);
-            common::softmax_2D(box.data(), box.shape(0), box.shape(1));
-
-            xt::xarray<float> mask(mask_shape);
-
-            dequantize_mask_values(mask, j, quantized_masks, 
-                                    mask.shape(0), qp_scale_mask, 
-                                    qp_zp_mask);
-
-            auto box_distance = box * regression_distance;
-            xt::xarray<float> reduced_distances = xt::sum(box_distance, {2});
-            auto strided_distances = reduced_distances * strides[i];
-
-            // Decode box
-            auto distance_view1 = xt::view(strided_distances, xt::all(), xt::range(_, 2)) * -1;
-            auto distance_view2 = xt::view(strided_distances, xt::all(), xt::range(2, _));
-            auto distance_view = xt::concatenate(xt::xtuple(distance_view1, distance_view2), 1);
-            auto decoded_box = centers[i] + distance_view;
-
-            HailoBBox bbox(decoded_box(j, 0) / network_dims[0],
-                           decoded_box(j, 1) / network_dims[1],
-                           (decoded_box(j, 2) - decoded_box(j, 0)) / network_dims[0],
-                           (decoded_box(j, 3) - decoded_box(j, 1)) / network_dims[1]);
-
-            label = common::coco_eighty[class_index + 1];
-            HailoDetection detected_instance(bbox, class_index, label, confidence);
-
-            detections_and_masks.push_back(std::make_pair(detected_instance, mask));
-
-        }
+/**
+ * @brief Builds the detections of the NMS survivors and dequantizes only their mask coefficients,
+ *        one row per detection. decode_masks decodes each row inside that detection's box only.
+ */
+SegDetections extract_masks(const std::pmr::vector<common::TensorView> &raw_masks_outputs,
+                            std::pmr::vector<common::Candidate> &candidates,
+                            const SegProposals &proposals,
+                            const std::vector<uint32_t> &keep,
+                            common::QuantLutSlots &mask_luts,
+                            std::pmr::memory_resource *memory) {
+    SegDetections detections_and_masks{std::pmr::vector<SegBox>(memory), std::pmr::vector<float>(memory), 0};
+    detections_and_masks.features = raw_masks_outputs.empty() ? 0 : raw_masks_outputs[0].features();
+    detections_and_masks.detections.reserve(keep.size());
+    detections_and_masks.coefficients.resize(keep.size() * detections_and_masks.features);
+
+    for (uint32_t n : keep) {
+        uint i = candidates[n].stride_index;
+        uint j = candidates[n].index;
+
+        HailoBBox bbox(proposals.xmin[n],
+                       proposals.ymin[n],
+                       proposals.xmax[n] - proposals.xmin[n],
+                       proposals.ymax[n] - proposals.ymin[n]);
+
+        const size_t mask_features = detections_and_masks.features;
+        if (raw_masks_outputs[i].features() != mask_features)
+            throw std::runtime_error("Output levels disagree on the number of mask coefficients");
+        const common::QuantLut &mask_lut = mask_luts.get(i, raw_masks_outputs[i].qp_scale(), raw_masks_outputs[i].qp_zp());
+
+        float *mask = detections_and_masks.coefficients.data() + detections_and_masks.detections.size() * mask_features;
+        common::dequantize(raw_masks_outputs[i].anchor<uint8_t>(j), mask, mask_features, mask_lut);
+
+        detections_and_masks.detections.push_back(SegBox{bbox, proposals.class_ids[n], proposals.scores[n]});
     }
 
     return detections_and_masks;
 }
 
 
-HailoTensorPtr pop_proto(std::vector<HailoTensorPtr> &tensors){
+HailoTensorPtr pop_proto(std::pmr::vector<HailoTensorPtr> &tensors, const common::ModelDescriptor &model){
     auto it = tensors.begin();
     while (it != tensors.end()) {
         auto tensor = *it;
-        if (tensor->features() == 32 && tensor->height() == 160 && tensor->width() == 160){
+        if (model.is_proto(tensor->vstream_info())){
             auto proto = tensor;
             tensors.erase(it);
             return proto;
@@ -323,116 +228,129 @@ HailoTensorPtr pop_proto(std::vector<HailoTensorPtr> &tensors){
 }
 
 
-Quadruple get_boxes_scores_masks(std::vector<HailoTensorPtr> &tensors, int num_classes, int regression_length){
-
-    auto raw_proto = pop_proto(tensors);
-
-    std::vector<HailoTensorPtr> outputs_boxes(tensors.size() / 3);
-    std::vector<HailoTensorPtr> outputs_masks(tensors.size() / 3);
-    
-    // Prepare the scores xarray at the size we will fill in in-place
-    int total_scores = 0;
-    for (int i = 0; i < tensors.size(); i = i + 3) {
-        total_scores += tensors[i+1]->width() * tensors[i+1]->height();
-    }
-
-    std::vector<size_t> scores_shape = { (long unsigned int)total_scores, (long unsigned int)num_classes };
-    
-    xt::xarray<float> scores(scores_shape);
+Quadruple get_boxes_scores_masks(std::pmr::vector<HailoTensorPtr> &tensors, const common::ModelDescriptor &model,
+                                 std::pmr::memory_resource *memory){
 
-    std::vector<size_t> proto_shape = { {(long unsigned int)raw_proto->height(), 
-                                                (long unsigned int)raw_proto->width(), 
-                                                (long unsigned int)raw_proto->features()} };
-    xt::xarray<float> proto(proto_shape);
+    auto raw_proto = pop_proto(tensors, model);
+    if (nullptr == raw_proto)
+        throw std::runtime_error("No prototype tensor of " + std::to_string(model.proto_height) + "x" +
+                                 std::to_string(model.proto_width) + "x" + std::to_string(model.proto_features));
 
-    int view_index_scores = 0;
+    // Built in place: copying a pmr vector out would allocate the copy from the default resource.
+    // The prototypes stay quantized in the output buffer, decode_masks only reads them when something survived NMS
+    Quadruple outputs{std::pmr::vector<common::TensorView>(tensors.size() / 3, memory),
+                      std::pmr::vector<common::Candidate>(memory),
+                      std::pmr::vector<common::TensorView>(tensors.size() / 3, memory),
+                      common::TensorView(raw_proto)};
 
     for (uint i = 0; i < tensors.size(); i = i + 3)
     {
         // Bounding boxes extraction will be done later on only on the boxes that surpass the score threshold
-        outputs_boxes[i / 3] = tensors[i];
-
-        // Extract and dequantize the scores outputs
-        auto dequantized_output_s = common::dequantize(common::get_xtensor(tensors[i+1]), tensors[i+1]->vstream_info().quant_info.qp_scale, tensors[i+1]->vstream_info().quant_info.qp_zp);
-        int num_proposals_scores = dequantized_output_s.shape(0)*dequantized_output_s.shape(1);
+        outputs.boxes[i / 3] = common::TensorView(tensors[i]);
 
-        // From the layer extract the scores
-        auto output_scores = xt::view(dequantized_output_s, xt::all(), xt::all(), xt::all());
-        xt::view(scores, xt::range(view_index_scores, view_index_scores + num_proposals_scores), xt::all()) = xt::reshape_view(output_scores, {num_proposals_scores, num_classes});
-        view_index_scores += num_proposals_scores;
+        // Compare the raw scores against the threshold in the quantized domain, only survivors get dequantized
+        common::TensorView scores(tensors[i+1]);
+        common::gather_candidates(scores.data_uint8(), scores.anchors(), model.num_classes,
+                                  common::quantize_threshold(model.score_threshold, scores.qp_scale(), scores.qp_zp()),
+                                  scores.qp_scale(), scores.qp_zp(), i / 3, outputs.candidates);
 
-        // Keypoints extraction will be done later according to the boxes that surpass the threshold
-        outputs_masks[i / 3] = tensors[i+2];
+        // Mask coefficients extraction will be done later according to the boxes that surpass the threshold
+        outputs.masks[i / 3] = common::TensorView(tensors[i+2]);
     }
-    
-    proto = common::dequantize(common::get_xtensor(raw_proto), raw_proto->vstream_info().quant_info.qp_scale, raw_proto->vstream_info().quant_info.qp_zp);
-    
-    return Quadruple{outputs_boxes, scores, outputs_masks, proto};
+    return outputs;
 }
 
-std::vector<DetectionAndMask> yolov8seg_postprocess(std::vector<HailoTensorPtr> &tensors,
-                                                                                std::vector<int> network_dims,
-                                                                                std::vector<int> strides,
-                                                                                int regression_length,
-                                                                                int num_classes,
-                                                                                int org_image_height, 
-                                                                                int org_image_width) {
-    std::vector<DetectionAndMask> detections_and_cropped_masks;
+std::pmr::vector<DetectionAndMask> yolov8seg_postprocess(std::pmr::vector<HailoTensorPtr> &tensors,
+                                                         const common::ModelDescriptor &model,
+                                                         int org_image_height, 
+                                                         int org_image_width,
+                                                         std::pmr::memory_resource *memory) {
+    std::pmr::vector<DetectionAndMask> detections_and_cropped_masks(memory);
     if (tensors.size() == 0)
     {
         return detections_and_cropped_masks;
     }
 
-    Quadruple boxes_scores_masks_mask_matrix = get_boxes_scores_masks(tensors, num_classes, regression_length);
+    Quadruple boxes_scores_masks_mask_matrix = get_boxes_scores_masks(tensors, model, memory);
 
-    std::vector<HailoTensorPtr> raw_boxes = boxes_scores_masks_mask_matrix.boxes;
-    xt::xarray<float> scores = boxes_scores_masks_mask_matrix.scores;
-    std::vector<HailoTensorPtr> raw_masks = boxes_scores_masks_mask_matrix.masks;
-    xt::xarray<float> proto = boxes_scores_masks_mask_matrix.proto_data;
+    const std::pmr::vector<common::TensorView> &raw_boxes = boxes_scores_masks_mask_matrix.boxes;
+    std::pmr::vector<common::Candidate> &candidates = boxes_scores_masks_mask_matrix.candidates;
+    const std::pmr::vector<common::TensorView> &raw_masks = boxes_scores_masks_mask_matrix.masks;
+    const common::TensorView &proto = boxes_scores_masks_mask_matrix.proto;
 
-    // Decode the boxes and get masks
-    auto detections_and_masks = decode_boxes_and_extract_masks(raw_boxes, raw_masks, scores, network_dims, strides, regression_length);
+    // Decode the boxes
+    SegWorkspace &workspace = thread_workspace();
+    SegProposals &proposals = workspace.proposals;
+    // The default 16-bin DFL gets a decoder with the bin count fixed at compile time
+    common::dispatch_geometry(model, [&](const auto &geometry) {
+        decode_boxes(geometry, raw_boxes, candidates, model, workspace);
+    });
 
-    // Filter with NMS
-    auto detections_and_masks_after_nms = nms(detections_and_masks, IOU_THRESHOLD, true);
+    // Filter with NMS, then get the mask coefficients of the survivors
+    const auto &keep = workspace.nms_engine.run(proposals.nms_boxes(), model.iou_threshold, true);
+    auto detections_and_masks_after_nms = extract_masks(raw_masks, candidates, proposals, keep, workspace.mask_luts, memory);
 
     // Decode the masking
-    auto detections_and_decoded_masks = decode_masks(detections_and_masks_after_nms, proto, org_image_height, org_image_width);
+    auto detections_and_decoded_masks = decode_masks(detections_and_masks_after_nms, proto, model.mask_threshold, org_image_height, org_image_width,
+                                                     workspace, memory);
 
     return detections_and_decoded_masks;
 }
 
 
-std::vector<cv::Mat> yolov8(HailoROIPtr roi, int org_image_height, int org_image_width)
+std::pmr::vector<common::RleMask> yolov8(HailoROIPtr roi, const common::ModelDescriptor &model, int org_image_height, int org_image_width,
+                                         std::pmr::memory_resource *memory)
 {
-    // anchor params
-    int regression_length = 15;
-    std::vector<int> strides = {8, 16, 32};
-    std::vector<int> network_dims = {640, 640};
-
-    std::vector<HailoTensorPtr> tensors = roi->get_tensors();
+    std::pmr::vector<HailoTensorPtr> tensors = roi->get_tensors(memory);
     auto filtered_detections_and_masks = yolov8seg_postprocess(tensors, 
-                                                            network_dims, 
-                                                            strides, 
-                                                            regression_length, 
-                                                            NUM_CLASSES, 
+                                                            model, 
                                                             org_image_height, 
-                                                            org_image_width);
+                                                            org_image_width,
+                                                            memory);
 
-    std::vector<HailoDetection> detections;
-    std::vector<cv::Mat> masks;
+    std::pmr::vector<common::RleMask> masks(memory);
+    masks.reserve(filtered_detections_and_masks.size());
 
     for (auto& det_and_msk : filtered_detections_and_masks){
-        detections.push_back(det_and_msk.detection);
-        masks.push_back(det_and_msk.mask);
+        const SegBox &detection = det_and_msk.detection;
+        hailo_common::add_object(roi, std::make_shared<HailoDetection>(detection.box, detection.class_id,
+                                                                       common::coco_eighty[detection.class_id + 1], detection.score));
+        masks.push_back(std::move(det_and_msk.mask));
     }
 
-    hailo_common::add_detections(roi, detections);
-
     return masks;
 }
 
-std::vector<cv::Mat> filter(HailoROIPtr roi, int org_image_height, int org_image_width)
+// Moves the masks out for the callers that keep them past the frame
+std::vector<common::RleMask> to_std_vector(std::pmr::vector<common::RleMask> &&masks)
+{
+    return std::vector<common::RleMask>(std::make_move_iterator(masks.begin()), std::make_move_iterator(masks.end()));
+}
+
+common::ModelDescriptor default_seg_model()
+{
+    // yolov8 seg at 640x640: 80 COCO classes, 32 mask coefficients over 160x160 prototypes
+    common::ModelDescriptor model;
+    model.head_features = 32;
+    model.proto_width = 160;
+    model.proto_height = 160;
+    model.proto_features = 32;
+    return model;
+}
+
+std::vector<common::RleMask> filter(HailoROIPtr roi, int org_image_height, int org_image_width)
+{
+    static const common::ModelDescriptor model = default_seg_model();
+    return to_std_vector(yolov8(roi, model, org_image_height, org_image_width, std::pmr::get_default_resource()));
+}
+
+std::vector<common::RleMask> filter(HailoROIPtr roi, const common::ModelDescriptor &model, int org_image_height, int org_image_width)
+{
+    return to_std_vector(yolov8(roi, model, org_image_height, org_image_width, std::pmr::get_default_resource()));
+}
+
+std::pmr::vector<common::RleMask> filter(HailoROIPtr roi, const common::ModelDescriptor &model, int org_image_height, int org_image_width,
+                                         std::pmr::memory_resource *memory)
 {
-    return yolov8(roi, org_image_height, org_image_width);
+    return yolov8(roi, model, org_image_height, org_image_width, memory);
 }
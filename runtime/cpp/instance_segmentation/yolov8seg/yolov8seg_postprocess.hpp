@@ -5,6 +5,14 @@
 #pragma once
 #include "common/hailo_objects.hpp"
 #include "common/hailo_common.hpp"
+#include "common/tensors.hpp"
+#include "common/candidates.hpp"
+#include "common/nms_engine.hpp"
+#include "common/model_descriptor.hpp"
+#include "common/mask_rle.hpp"
+#include "common/frame_arena.hpp"
+
+#include <memory_resource>
 
 #include <opencv2/opencv.hpp>
 
@@ -13,17 +21,77 @@
 #include <xtensor-blas/xlinalg.hpp>
 
 struct Quadruple {
-    std::vector<HailoTensorPtr> boxes;
-    xt::xarray<float> scores;
-    std::vector<HailoTensorPtr> masks;
-    xt::xarray<float> proto_data;
+    std::pmr::vector<common::TensorView> boxes;
+    std::pmr::vector<common::Candidate> candidates;
+    std::pmr::vector<common::TensorView> masks;
+    common::TensorView proto;
+};
+
+/**
+ * @brief Structure-of-arrays holding the decoded boxes of the candidates, normalized to the network dims.
+ *        Buffers are reused across frames and only grow.
+ */
+struct SegProposals {
+    std::vector<float> xmin, ymin, xmax, ymax;
+    std::vector<float> scores;
+    std::vector<int> class_ids;
+    size_t count = 0;
+
+    void reserve(size_t capacity)
+    {
+        if (scores.size() >= capacity)
+            return;
+        for (auto *column : {&xmin, &ymin, &xmax, &ymax, &scores})
+            column->resize(capacity);
+        class_ids.resize(capacity);
+    }
+
+    common::NmsBoxes nms_boxes() const
+    {
+        return common::NmsBoxes{xmin.data(), ymin.data(), xmax.data(), ymax.data(), scores.data(), class_ids.data(), count};
+    }
+};
+
+/**
+ * @brief A kept detection as plain values, the HailoDetection is only built when the result is
+ *        attached to the ROI.
+ */
+struct SegBox {
+    HailoBBox box;
+    int class_id;
+    float score;
+};
+
+/**
+ * @brief The NMS survivors and their dequantized mask coefficients, row n of the
+ *        [detections x features] coefficient matrix belongs to detections[n].
+ */
+struct SegDetections {
+    std::pmr::vector<SegBox> detections;
+    std::pmr::vector<float> coefficients;
+    size_t features = 0;
 };
 
+/**
+ * @brief A detection and its mask over its box in original image pixels, thresholded at
+ *        model.mask_threshold and run-length encoded. The mask is empty when the box has no
+ *        pixel inside the image.
+ */
 struct DetectionAndMask {
-    HailoDetection detection;
-    cv::Mat mask;
+    SegBox detection;
+    common::RleMask mask;
 };
 
 __BEGIN_DECLS
-std::vector<cv::Mat> filter(HailoROIPtr roi, int org_width, int org_height);
+std::vector<common::RleMask> filter(HailoROIPtr roi, int org_width, int org_height);
 __END_DECLS
+
+// Geometry and thresholds from `model` instead of the 640x640 COCO defaults
+std::vector<common::RleMask> filter(HailoROIPtr roi, const common::ModelDescriptor &model, int org_height, int org_width);
+
+// Every temporary and the returned masks are allocated from `memory`, usually a common::FrameArena
+// reset at the end of the frame. Detections attached to the ROI stay on the heap, they may outlive it.
+std::pmr::vector<common::RleMask> filter(HailoROIPtr roi, const common::ModelDescriptor &model, int org_height, int org_width,
+                                         std::pmr::memory_resource *memory);
+
+common::ModelDescriptor default_seg_model();
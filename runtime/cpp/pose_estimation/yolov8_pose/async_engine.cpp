@@ -0,0 +1,326 @@
+#include "async_engine.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace hailort;
+
+// Upper bound for one in-flight job to finish when the backend goes away
+static constexpr std::chrono::milliseconds JOB_DRAIN_TIMEOUT(1000);
+
+//-------------------------------
+// HAILO BACKEND
+//-------------------------------
+
+HailoBackend::HailoBackend(const std::string &hef_path)
+{
+    auto vdevice_exp = VDevice::create();
+    if (!vdevice_exp) {
+        std::cerr << "Failed to create VDevice, status = " << vdevice_exp.status() << std::endl;
+        throw std::runtime_error("Failed to create VDevice");
+    }
+    m_vdevice = vdevice_exp.release();
+
+    auto infer_model_exp = m_vdevice->create_infer_model(hef_path);
+    if (!infer_model_exp) {
+        std::cerr << "Failed to create infer model, status = " << infer_model_exp.status() << std::endl;
+        throw std::runtime_error("Failed to create infer model");
+    }
+    m_infer_model = infer_model_exp.release();
+
+    auto input_infos = m_infer_model->hef().get_input_vstream_infos();
+    auto output_infos = m_infer_model->hef().get_output_vstream_infos();
+    if (!input_infos || !output_infos || input_infos->empty()) {
+        throw std::runtime_error("Failed to get vstream infos from " + hef_path);
+    }
+
+    // The postprocess reads raw quantized tensors
+    m_input_info = input_infos->at(0);
+    m_infer_model->input(m_input_info.name)->set_format_type(HAILO_FORMAT_TYPE_UINT8);
+    m_input_frame_size = m_infer_model->input(m_input_info.name)->get_frame_size();
+    for (const auto &info : output_infos.value()) {
+        m_infer_model->output(info.name)->set_format_type(HAILO_FORMAT_TYPE_UINT8);
+        m_output_infos.push_back(info);
+        m_output_frame_sizes.push_back(m_infer_model->output(info.name)->get_frame_size());
+    }
+}
+
+HailoBackend::~HailoBackend()
+{
+    // The bindings point at the caller's buffers and the completions write into them
+    for (auto &job : m_jobs) {
+        if (!job)
+            continue;
+        auto status = job->wait(JOB_DRAIN_TIMEOUT);
+        if (HAILO_SUCCESS != status)
+            std::cerr << "Failed waiting for an async infer job, status = " << status << std::endl;
+    }
+}
+
+hailo_status HailoBackend::configure(uint32_t jobs)
+{
+    auto configured_exp = m_infer_model->configure();
+    if (!configured_exp) {
+        std::cerr << "Failed to configure infer model, status = " << configured_exp.status() << std::endl;
+        return configured_exp.status();
+    }
+    m_configured_infer_model = configured_exp.release();
+
+    m_bindings.clear();
+    m_jobs.clear();
+    m_jobs.resize(jobs);
+    for (uint32_t i = 0; i < jobs; i++) {
+        auto bindings_exp = m_configured_infer_model.create_bindings();
+        if (!bindings_exp) {
+            std::cerr << "Failed to create infer bindings, status = " << bindings_exp.status() << std::endl;
+            return bindings_exp.status();
+        }
+        m_bindings.push_back(bindings_exp.release());
+    }
+    return HAILO_SUCCESS;
+}
+
+hailo_status HailoBackend::run_async(uint32_t job, const uint8_t *input, const std::vector<MemoryView> &outputs,
+                                     Completion done)
+{
+    auto &bindings = m_bindings[job];
+    auto status = bindings.input(m_input_info.name)->set_buffer(
+        MemoryView(const_cast<uint8_t*>(input), m_input_frame_size));
+    if (HAILO_SUCCESS != status) {
+        std::cerr << "Failed to set infer input buffer, status = " << status << std::endl;
+        return status;
+    }
+    for (size_t i = 0; i < outputs.size(); i++) {
+        status = bindings.output(m_output_infos[i].name)->set_buffer(outputs[i]);
+        if (HAILO_SUCCESS != status) {
+            std::cerr << "Failed to set infer output buffer, status = " << status << std::endl;
+            return status;
+        }
+    }
+
+    status = m_configured_infer_model.wait_for_async_ready(std::chrono::milliseconds(1000));
+    if (HAILO_SUCCESS != status) {
+        std::cerr << "Failed wait_for_async_ready, status = " << status << std::endl;
+        return status;
+    }
+    auto job_exp = m_configured_infer_model.run_async(bindings,
+        [done](const AsyncInferCompletionInfo &info) { done(info.status); });
+    if (!job_exp) {
+        std::cerr << "Failed to start async infer job, status = " << job_exp.status() << std::endl;
+        return job_exp.status();
+    }
+    // The previous job on these bindings has completed, this one is waited for on destruction
+    m_jobs[job].reset();
+    m_jobs[job].emplace(job_exp.release());
+    return HAILO_SUCCESS;
+}
+
+//-------------------------------
+// FILE REPLAY BACKEND
+//-------------------------------
+
+FileReplayBackend::FileReplayBackend(const std::string &hef_path, const std::string &replay_path,
+                                     std::chrono::microseconds latency) :
+    m_latency(latency)
+{
+    auto hef_exp = Hef::create(hef_path);
+    if (!hef_exp) {
+        std::cerr << "Failed to parse HEF, status = " << hef_exp.status() << std::endl;
+        throw std::runtime_error("Failed to parse HEF");
+    }
+    auto hef = hef_exp.release();
+    auto input_infos = hef.get_input_vstream_infos();
+    auto output_infos = hef.get_output_vstream_infos();
+    if (!input_infos || !output_infos || input_infos->empty()) {
+        throw std::runtime_error("Failed to get vstream infos from " + hef_path);
+    }
+
+    // Same uint8 NHWC frames HailoBackend produces
+    m_input_info = input_infos->at(0);
+    m_input_frame_size = size_t(m_input_info.shape.height) * m_input_info.shape.width * m_input_info.shape.features;
+    for (const auto &info : output_infos.value()) {
+        m_output_infos.push_back(info);
+        m_output_frame_sizes.push_back(size_t(info.shape.height) * info.shape.width * info.shape.features);
+    }
+
+    m_file = std::fopen(replay_path.c_str(), "rb");
+    if (nullptr == m_file) {
+        throw std::runtime_error("Failed to open replay file " + replay_path);
+    }
+    m_worker = std::thread(&FileReplayBackend::worker_loop, this);
+}
+
+FileReplayBackend::~FileReplayBackend()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+    if (m_file)
+        std::fclose(m_file);
+}
+
+hailo_status FileReplayBackend::configure(uint32_t /*jobs*/)
+{
+    return HAILO_SUCCESS;
+}
+
+hailo_status FileReplayBackend::run_async(uint32_t /*job*/, const uint8_t * /*input*/, const std::vector<MemoryView> &outputs,
+                                          Completion done)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(Job{std::chrono::steady_clock::now() + m_latency, outputs, std::move(done)});
+    }
+    m_cv.notify_one();
+    return HAILO_SUCCESS;
+}
+
+void FileReplayBackend::worker_loop()
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stopped || !m_jobs.empty(); });
+            // Pending jobs still complete on shutdown, their slots are waited on
+            if (m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        std::this_thread::sleep_until(job.due);
+        job.done(read_outputs(job.outputs));
+    }
+}
+
+hailo_status FileReplayBackend::read_outputs(const std::vector<MemoryView> &outputs)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t i = 0;
+        for (; i < outputs.size(); i++) {
+            if (std::fread(outputs[i].data(), 1, outputs[i].size(), m_file) != outputs[i].size())
+                break;
+        }
+        if (i == outputs.size())
+            return HAILO_SUCCESS;
+        // End of the recording: loop back to the first frame
+        std::rewind(m_file);
+    }
+    std::cerr << "Replay file holds no complete frame" << std::endl;
+    return HAILO_FILE_OPERATION_FAILURE;
+}
+
+//-------------------------------
+// ENGINE
+//-------------------------------
+
+AsyncInferenceEngine::AsyncInferenceEngine(std::unique_ptr<InferenceBackend> backend, uint32_t slots) :
+    m_backend(std::move(backend))
+{
+    // The postprocess expects the outputs ordered by size. Stable, so outputs of the same size keep
+    // the order the backend (the HEF) lists them in.
+    const auto &infos = m_backend->output_infos();
+    m_backend_index.resize(infos.size());
+    std::iota(m_backend_index.begin(), m_backend_index.end(), 0);
+    std::stable_sort(m_backend_index.begin(), m_backend_index.end(),
+                     [&infos](size_t a, size_t b) { return infos[a].shape.width < infos[b].shape.width; });
+
+    std::vector<size_t> output_sizes;
+    for (size_t index : m_backend_index) {
+        m_output_infos.push_back(infos[index]);
+        output_sizes.push_back(m_backend->output_frame_sizes()[index]);
+    }
+    m_gather = std::make_unique<FrameGather<uint8_t>>(output_sizes, slots);
+
+    auto status = m_backend->configure(m_gather->slots());
+    if (HAILO_SUCCESS != status) {
+        throw std::runtime_error("Failed to configure inference backend");
+    }
+}
+
+AsyncInferenceEngine::~AsyncInferenceEngine()
+{
+    m_backend.reset();
+    if (m_record_file)
+        std::fclose(m_record_file);
+}
+
+bool AsyncInferenceEngine::record_outputs(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_record_mutex);
+    m_record_file = std::fopen(path.c_str(), "wb");
+    return nullptr != m_record_file;
+}
+
+void AsyncInferenceEngine::prepare_input(FrameSlot<uint8_t> &slot)
+{
+    const cv::Size network_size(input_info().shape.width, input_info().shape.height);
+    const cv::Size image_size = slot.image.size();
+    cv::Rect region(cvRound(slot.roi.x * image_size.width), cvRound(slot.roi.y * image_size.height),
+                    cvRound(slot.roi.width * image_size.width), cvRound(slot.roi.height * image_size.height));
+    region &= cv::Rect(cv::Point(0, 0), image_size);
+    if (region.empty())
+        region = cv::Rect(cv::Point(0, 0), image_size);
+
+    if (region.size() == image_size && image_size == network_size && slot.image.isContinuous()) {
+        // Already what the network takes
+        slot.input = slot.image;
+        return;
+    }
+    // The slot's input buffer is reused once allocated; the resize runs on the submitting thread
+    cv::resize(slot.image(region), slot.input, network_size, 0, 0, cv::INTER_LINEAR);
+}
+
+hailo_status AsyncInferenceEngine::submit(const cv::Mat &image, std::chrono::steady_clock::time_point capture_time,
+                                          FrameHandle &&frame, const cv::Rect2f &roi)
+{
+    FrameSlot<uint8_t> *claimed = m_gather->push_frame(image, capture_time, std::move(frame), roi);
+    if (nullptr == claimed) {
+        // Postprocess stopped and closed the gather
+        return HAILO_STREAM_ABORT;
+    }
+    FrameSlot<uint8_t> &slot = *claimed;
+    const auto preprocess_start = std::chrono::steady_clock::now();
+    prepare_input(slot);
+    const auto launch_time = std::chrono::steady_clock::now();
+
+    std::vector<MemoryView> outputs(slot.outputs.size());
+    for (size_t j = 0; j < slot.outputs.size(); j++)
+        outputs[m_backend_index[j]] = MemoryView(slot.outputs[j].data(), slot.outputs[j].size());
+
+    const uint32_t job = static_cast<uint32_t>(slot.seq % m_gather->slots());
+    auto status = m_backend->run_async(job, slot.input.data, outputs,
+        [this, &slot, outputs, launch_time](hailo_status job_status) {
+            if (m_metrics)
+                m_metrics->record(Stage::DEVICE, launch_time, std::chrono::steady_clock::now());
+            if (HAILO_SUCCESS == job_status)
+                record(outputs);
+            m_gather->complete_frame(slot, job_status);
+        });
+    if (m_metrics) {
+        m_metrics->record(Stage::PREPROCESS, preprocess_start, launch_time);
+        m_metrics->record(Stage::WRITE, launch_time, std::chrono::steady_clock::now());
+    }
+    if (HAILO_SUCCESS != status) {
+        // Postprocess still gets the slot, and stops on its status
+        m_gather->complete_frame(slot, status);
+    }
+    return status;
+}
+
+void AsyncInferenceEngine::record(const std::vector<MemoryView> &outputs)
+{
+    std::lock_guard<std::mutex> lock(m_record_mutex);
+    if (nullptr == m_record_file)
+        return;
+    for (const auto &output : outputs)
+        std::fwrite(output.data(), 1, output.size(), m_record_file);
+}
@@ -0,0 +1,184 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file async_engine.hpp
+ * @brief Asynchronous inference engine over a pluggable backend (device or file replay)
+ **/
+
+#ifndef _HAILO_ASYNC_ENGINE_HPP_
+#define _HAILO_ASYNC_ENGINE_HPP_
+
+#include "hailo/hailort.hpp"
+#include "frame_gather.hpp"
+#include "stage_metrics.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Where inference runs. Outputs are described, bound and written in output_infos() order.
+ */
+class InferenceBackend {
+public:
+    using Completion = std::function<void(hailo_status)>;
+
+    virtual ~InferenceBackend() = default;
+
+    virtual const hailo_vstream_info_t &input_info() const = 0;
+    virtual size_t input_frame_size() const = 0;
+    virtual const std::vector<hailo_vstream_info_t> &output_infos() const = 0;
+    virtual const std::vector<size_t> &output_frame_sizes() const = 0;
+
+    // Prepares `jobs` independent job contexts; run_async is called with job indices below it
+    virtual hailo_status configure(uint32_t jobs) = 0;
+
+    // Starts one inference on `input`. Outputs are written to `outputs` and `done` is called exactly
+    // once, possibly from another thread. A job index is not reused before its completion.
+    virtual hailo_status run_async(uint32_t job, const uint8_t *input, const std::vector<hailort::MemoryView> &outputs,
+                                   Completion done) = 0;
+};
+
+/**
+ * Runs the HEF on the device through the InferModel async API, one set of bindings per job.
+ * Input and outputs are uint8 (quantized). Destruction waits for the jobs still in flight, whose
+ * completions write into buffers the caller owns.
+ */
+class HailoBackend : public InferenceBackend {
+public:
+    explicit HailoBackend(const std::string &hef_path);
+    ~HailoBackend() override;
+
+    const hailo_vstream_info_t &input_info() const override { return m_input_info; }
+    size_t input_frame_size() const override { return m_input_frame_size; }
+    const std::vector<hailo_vstream_info_t> &output_infos() const override { return m_output_infos; }
+    const std::vector<size_t> &output_frame_sizes() const override { return m_output_frame_sizes; }
+
+    hailo_status configure(uint32_t jobs) override;
+    hailo_status run_async(uint32_t job, const uint8_t *input, const std::vector<hailort::MemoryView> &outputs,
+                           Completion done) override;
+
+private:
+    std::unique_ptr<hailort::VDevice> m_vdevice;
+    std::shared_ptr<hailort::InferModel> m_infer_model;
+    hailort::ConfiguredInferModel m_configured_infer_model;
+    std::vector<hailort::ConfiguredInferModel::Bindings> m_bindings;
+    std::vector<std::optional<hailort::AsyncInferJob>> m_jobs;  // Last job started on each bindings
+
+    hailo_vstream_info_t m_input_info;
+    size_t m_input_frame_size = 0;
+    std::vector<hailo_vstream_info_t> m_output_infos;
+    std::vector<size_t> m_output_frame_sizes;
+};
+
+/**
+ * Stands in for the device in CI and benchmarks: stream metadata comes from the HEF and the outputs
+ * are replayed from a file written by AsyncInferenceEngine::record_outputs, looping at its end.
+ * Jobs complete in submission order on a worker thread, each `latency` after it was submitted.
+ */
+class FileReplayBackend : public InferenceBackend {
+public:
+    FileReplayBackend(const std::string &hef_path, const std::string &replay_path,
+                      std::chrono::microseconds latency = std::chrono::microseconds(0));
+    ~FileReplayBackend() override;
+
+    const hailo_vstream_info_t &input_info() const override { return m_input_info; }
+    size_t input_frame_size() const override { return m_input_frame_size; }
+    const std::vector<hailo_vstream_info_t> &output_infos() const override { return m_output_infos; }
+    const std::vector<size_t> &output_frame_sizes() const override { return m_output_frame_sizes; }
+
+    hailo_status configure(uint32_t jobs) override;
+    hailo_status run_async(uint32_t job, const uint8_t *input, const std::vector<hailort::MemoryView> &outputs,
+                           Completion done) override;
+
+private:
+    struct Job {
+        std::chrono::steady_clock::time_point due;
+        std::vector<hailort::MemoryView> outputs;
+        Completion done;
+    };
+
+    void worker_loop();
+    hailo_status read_outputs(const std::vector<hailort::MemoryView> &outputs);
+
+    std::FILE *m_file = nullptr;
+    std::chrono::microseconds m_latency;
+
+    hailo_vstream_info_t m_input_info;
+    size_t m_input_frame_size = 0;
+    std::vector<hailo_vstream_info_t> m_output_infos;
+    std::vector<size_t> m_output_frame_sizes;
+
+    std::deque<Job> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopped = false;
+    std::thread m_worker;
+};
+
+/**
+ * @brief Keeps several inference jobs in flight. Every submitted frame claims a FrameGather slot,
+ *        the backend writes the outputs straight into the slot's page-aligned buffers and the
+ *        completion callback marks the slot complete for postprocess. Nothing is copied and no
+ *        thread blocks on a per-output read.
+ */
+class AsyncInferenceEngine {
+public:
+    AsyncInferenceEngine(std::unique_ptr<InferenceBackend> backend, uint32_t slots);
+    ~AsyncInferenceEngine();
+
+    const hailo_vstream_info_t &input_info() const { return m_backend->input_info(); }
+    size_t input_frame_size() const { return m_backend->input_frame_size(); }
+
+    // Output infos in postprocess order: ascending width, backend order among equal widths
+    const std::vector<hailo_vstream_info_t> &output_infos() const { return m_output_infos; }
+
+    FrameGather<uint8_t> &gather() { return *m_gather; }
+
+    // Appends the outputs of every completed frame, in backend order, to a file FileReplayBackend can play
+    bool record_outputs(const std::string &path);
+
+    // Records PREPROCESS and WRITE on the submitting thread and DEVICE on the completions. Set
+    // before the first submit; `metrics` must outlive the engine.
+    void set_metrics(StageMetrics *metrics) { m_metrics = metrics; }
+
+    // Claims the next frame slot (blocking while all are in flight) and starts inference on the
+    // `roi` region of `image` (normalized), resized to the network input. HAILO_STREAM_ABORT once
+    // postprocess closed the gather.
+    hailo_status submit(const cv::Mat &image, std::chrono::steady_clock::time_point capture_time,
+                        FrameHandle &&frame = FrameHandle(), const cv::Rect2f &roi = cv::Rect2f(0.0f, 0.0f, 1.0f, 1.0f));
+
+private:
+    void prepare_input(FrameSlot<uint8_t> &slot);
+    void record(const std::vector<hailort::MemoryView> &outputs);
+
+    std::vector<size_t> m_backend_index;    // Backend output index of each postprocess output
+    std::vector<hailo_vstream_info_t> m_output_infos;
+    std::unique_ptr<FrameGather<uint8_t>> m_gather;
+    // Declared after the gather so in-flight completions stop before the slots go away
+    std::unique_ptr<InferenceBackend> m_backend;
+
+    std::FILE *m_record_file = nullptr;
+    std::mutex m_record_mutex;
+    StageMetrics *m_metrics = nullptr;
+};
+
+#endif /* _HAILO_ASYNC_ENGINE_HPP_ */
@@ -0,0 +1,263 @@
+/**
+ * Pose decode time and equivalence: the previous decode against the current postprocess.
+ *
+ * The previous decode is a scalar transcription of the original xtensor path: every score is
+ * dequantized and compared in float, and every anchor above the threshold dequantizes its 64 box
+ * bins, runs softmax + expectation per side, and decodes its 17 keypoints with exp-based sigmoids.
+ * The survivors go through the original greedy NMS, in score order like NmsEngine.
+ * The current path is filter() on the same outputs, with the candidate and detection caps off.
+ *
+ * With -replay=FILE the outputs are real captures, recorded by the example with -record=FILE (the
+ * raw uint8 output buffers of every frame, in HEF order). -hef=FILE gives their shapes and
+ * quantization and the model geometry, -config=FILE overrides it like in the example. Every
+ * recorded frame is checked and the timing cycles through them. Without -replay, one synthetic
+ * frame with -persons planted persons is used instead.
+ *
+ * Both must return the same persons for every frame (count, scores, boxes and keypoints within
+ * 1e-4 of the normalized frame); the run fails (exit code 1) otherwise.
+ *
+ * Usage: decode_bench [-frames=N] [-persons=N] [-replay=FILE -hef=FILE [-config=FILE]]
+ **/
+#include "yolov8pose_postprocess.hpp"
+#include "bench/synthetic_outputs.hpp"
+#include "hailo/hailort.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+static float iou(const PersonKeypoints &a, const PersonKeypoints &b)
+{
+    const float overlap_w = std::max(std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin), 0.0f);
+    const float overlap_h = std::max(std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin), 0.0f);
+    const float overlap = overlap_w * overlap_h;
+    const float area_a = (a.ymax - a.ymin) * (a.xmax - a.xmin);
+    const float area_b = (b.ymax - b.ymin) * (b.xmax - b.xmin);
+    return overlap / (area_a + area_b - overlap);
+}
+
+// One frame of outputs in postprocess order: by name, the order of the ROI's tensor map
+using FrameOutputs = std::vector<SyntheticPoseOutputs::Output>;
+
+// A full-frame ROI over the outputs, like the example builds
+static HailoROIPtr make_roi(FrameOutputs &outputs)
+{
+    HailoROIPtr roi = std::make_shared<HailoROI>(HailoBBox(0.0f, 0.0f, 1.0f, 1.0f));
+    for (auto &out : outputs)
+        roi->add_tensor(std::make_shared<HailoTensor>(out.data.data(), out.info));
+    return roi;
+}
+
+// Up to max_frames complete frames of a -record file; the geometry comes from the HEF and `config_path`
+static std::vector<FrameOutputs> load_recording(const std::string &hef_path, const std::string &replay_path,
+                                                const std::string &config_path, size_t max_frames, common::ModelDescriptor &model)
+{
+    auto hef = hailort::Hef::create(hef_path);
+    if (!hef)
+        throw std::runtime_error("Failed to parse HEF " + hef_path);
+    auto input_infos = hef->get_input_vstream_infos();
+    auto output_infos = hef->get_output_vstream_infos();
+    if (!input_infos || !output_infos || input_infos->empty())
+        throw std::runtime_error("Failed to get vstream infos from " + hef_path);
+    const auto ordered = common::postprocess_order(output_infos.value());
+    common::describe_model(input_infos->at(0), ordered, model);
+    if (!config_path.empty())
+        common::load_model_config(config_path, model);
+    common::validate_model(model, ordered);
+
+    std::FILE *file = std::fopen(replay_path.c_str(), "rb");
+    if (nullptr == file)
+        throw std::runtime_error("Failed to open replay file " + replay_path);
+    std::vector<FrameOutputs> frames;
+    while (frames.size() < max_frames) {
+        // Recorded in HEF order, reordered by name as the ROI will
+        std::map<std::string, SyntheticPoseOutputs::Output> by_name;
+        bool complete = true;
+        for (const auto &info : output_infos.value()) {
+            SyntheticPoseOutputs::Output out{std::vector<uint8_t>(size_t(info.shape.height) * info.shape.width * info.shape.features), info};
+            if (std::fread(out.data.data(), 1, out.data.size(), file) != out.data.size()) {
+                complete = false;
+                break;
+            }
+            by_name.emplace(info.name, std::move(out));
+        }
+        if (!complete)
+            break;
+        FrameOutputs frame;
+        for (auto &entry : by_name)
+            frame.push_back(std::move(entry.second));
+        frames.push_back(std::move(frame));
+    }
+    std::fclose(file);
+    if (frames.empty())
+        throw std::runtime_error("Replay file " + replay_path + " holds no complete frame");
+    return frames;
+}
+
+// The original decode, one anchor at a time over the whole grid
+static std::vector<PersonKeypoints> previous_decode(const FrameOutputs &outputs, const common::ModelDescriptor &model,
+                                                    float keypoint_scale)
+{
+    const int bins = model.regression_length + 1;
+    std::vector<PersonKeypoints> decodings;
+    std::vector<float> box(size_t(4 * bins));
+    for (size_t level = 0; level < model.strides.size(); level++) {
+        const auto &boxes = outputs[level * 3];
+        const auto &scores = outputs[level * 3 + 1];
+        const auto &keypoints = outputs[level * 3 + 2];
+        const float stride = float(model.strides[level]);
+        const size_t width = boxes.info.shape.width;
+        for (size_t j = 0; j < size_t(boxes.info.shape.height) * width; j++) {
+            const float confidence = (float(scores.data[j]) - scores.info.quant_info.qp_zp) * scores.info.quant_info.qp_scale;
+            if (confidence < model.score_threshold)
+                continue;
+
+            const float center_x = (float(j % width) + 0.5f) * stride;
+            const float center_y = (float(j / width) + 0.5f) * stride;
+            for (size_t b = 0; b < box.size(); b++)
+                box[b] = (float(boxes.data[j * box.size() + b]) - boxes.info.quant_info.qp_zp) * boxes.info.quant_info.qp_scale;
+            float distances[4];
+            for (int side = 0; side < 4; side++) {
+                float *logits = &box[size_t(side * bins)];
+                float sum = 0.0f;
+                for (int b = 0; b < bins; b++)
+                    sum += std::exp(logits[b]);
+                float expectation = 0.0f;
+                for (int b = 0; b < bins; b++)
+                    expectation += std::exp(logits[b]) / sum * float(b);
+                distances[side] = expectation * stride;
+            }
+
+            PersonKeypoints person;
+            person.xmin = (center_x - distances[0]) / float(model.network_width);
+            person.ymin = (center_y - distances[1]) / float(model.network_height);
+            person.xmax = (center_x + distances[2]) / float(model.network_width);
+            person.ymax = (center_y + distances[3]) / float(model.network_height);
+            person.score = confidence;
+            person.class_id = 0;
+            for (size_t k = 0; k < person.keypoints.size(); k++) {
+                const uint8_t *kpt = &keypoints.data[j * 51 + k * 3];
+                const float x = stride * (float(kpt[0]) / 255.0f * keypoint_scale - 0.5f) + center_x;
+                const float y = stride * (float(kpt[1]) / 255.0f * keypoint_scale - 0.5f) + center_y;
+                const float score = 1.0f / (1.0f + std::exp(-(float(kpt[2]) / 255.0f)));
+                person.keypoints[k] = KeyPt({x / float(model.network_width), y / float(model.network_height), score});
+            }
+            decodings.push_back(person);
+        }
+    }
+
+    // Greedy NMS across classes
+    std::stable_sort(decodings.begin(), decodings.end(), [](const PersonKeypoints &a, const PersonKeypoints &b) { return a.score > b.score; });
+    std::vector<bool> suppressed(decodings.size(), false);
+    std::vector<PersonKeypoints> kept;
+    for (size_t i = 0; i < decodings.size(); i++) {
+        if (suppressed[i])
+            continue;
+        kept.push_back(decodings[i]);
+        for (size_t k = i + 1; k < decodings.size(); k++) {
+            if (!suppressed[k] && iou(decodings[i], decodings[k]) >= model.iou_threshold)
+                suppressed[k] = true;
+        }
+    }
+    return kept;
+}
+
+static bool same_persons(const std::vector<PersonKeypoints> &expected, const std::vector<PersonKeypoints> &actual, float tolerance)
+{
+    if (expected.size() != actual.size()) {
+        std::printf("FAILED: %zu persons, expected %zu\n", actual.size(), expected.size());
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        const PersonKeypoints &e = expected[i];
+        const PersonKeypoints &a = actual[i];
+        float error = std::max({std::abs(e.score - a.score), std::abs(e.xmin - a.xmin), std::abs(e.ymin - a.ymin),
+                                std::abs(e.xmax - a.xmax), std::abs(e.ymax - a.ymax)});
+        for (size_t k = 0; k < e.keypoints.size(); k++) {
+            error = std::max({error, std::abs(e.keypoints[k].xs - a.keypoints[k].xs), std::abs(e.keypoints[k].ys - a.keypoints[k].ys),
+                              std::abs(e.keypoints[k].joints_scores - a.keypoints[k].joints_scores)});
+        }
+        if (error > tolerance) {
+            std::printf("FAILED: person %zu differs by %g\n", i, double(error));
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t frames = std::max<size_t>(1, std::stoul(get_option(argc, argv, "-frames=", "2000")));
+    const size_t persons = std::stoul(get_option(argc, argv, "-persons=", "12"));
+    const std::string replay_path = get_option(argc, argv, "-replay=", "");
+
+    PosePostprocessConfig config;
+    config.max_candidates = 0;
+    config.max_detections = 0;
+
+    std::vector<FrameOutputs> inputs;
+    if (replay_path.empty()) {
+        inputs.push_back(SyntheticPoseOutputs(persons, 1234).outputs());
+    }
+    else {
+        try {
+            inputs = load_recording(get_option(argc, argv, "-hef=", ""), replay_path, get_option(argc, argv, "-config=", ""),
+                                    frames, config.model);
+        }
+        catch (const std::exception &e) {
+            std::printf("FAILED: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    // Equivalence on every distinct frame
+    std::vector<PersonKeypoints> expected;
+    std::vector<PersonKeypoints> actual;
+    PoseFrameStats stats;
+    size_t candidates = 0, found = 0;
+    bool passed = true;
+    for (size_t f = 0; f < inputs.size(); f++) {
+        expected = previous_decode(inputs[f], config.model, config.keypoint_scale);
+        filter(make_roi(inputs[f]), config, stats, actual);
+        candidates += stats.candidates;
+        found += actual.size();
+        if (!same_persons(expected, actual, 1e-4f)) {
+            std::printf("(frame %zu)\n", f);
+            passed = false;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < frames; f++)
+        expected = previous_decode(inputs[f % inputs.size()], config.model, config.keypoint_scale);
+    const double previous_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(frames);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < frames; f++)
+        filter(make_roi(inputs[f % inputs.size()]), config, stats, actual);
+    const double current_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(frames);
+
+    std::printf("%s: %zu distinct frames, %.1f candidates and %.1f persons per frame\n",
+                replay_path.empty() ? "synthetic" : replay_path.c_str(), inputs.size(),
+                double(candidates) / double(inputs.size()), double(found) / double(inputs.size()));
+    std::printf("%zu frames timed\n", frames);
+    std::printf("%-10s %12s\n", "decode", "us/frame");
+    std::printf("%-10s %12.2f\n", "previous", previous_us);
+    std::printf("%-10s %12.2f\n", "current", current_us);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/**
+ * Per-frame allocation cost of the pose postprocess: filter() with every temporary on the heap
+ * against filter() on a FrameArena, over the same synthetic outputs.
+ *
+ * Each frame builds the ROI and its tensors from `memory` like the example does and runs the real
+ * decode, NMS and keypoint path (bench/synthetic_outputs.hpp, 0 to 20 planted persons). Global
+ * operator new is counted, and the heap allocations left per frame are split three ways:
+ * - roi: the ROI and tensor objects come from `memory`, but HailoROI keeps its mutex, tensor map
+ *   and names on the heap whatever the allocator;
+ * - detections: the HailoDetection objects attached to the ROI stay on the heap by design, they
+ *   may be rendered after the frame. Measured by attaching as many to a throwaway ROI;
+ * - filter: everything else filter() allocates, which must be nothing on the arena.
+ * Both rows run interleaved over several passes and the best pass is reported, so cache and
+ * frequency effects hit both the same.
+ *
+ * The first frame is the largest and warms the arena up; the run fails (exit code 1) if the two
+ * rows return different results or if filter() touches the heap on the arena after that frame.
+ *
+ * Usage: frame_arena_bench [-frames=N] [-passes=N]
+ **/
+#include "yolov8pose_postprocess.hpp"
+#include "bench/synthetic_outputs.hpp"
+#include "common/frame_arena.hpp"
+#include "common/hailo_common.hpp"
+#include "common/labels/coco_eighty.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Every heap allocation of the process goes through here
+static std::atomic<size_t> heap_allocations{0};
+
+void *operator new(size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+    if (void *pointer = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+// Heap allocations of attaching `count` detections to a ROI, the way the postprocess does
+static size_t attach_allocations(size_t count)
+{
+    HailoROIPtr roi = std::make_shared<HailoROI>(HailoBBox(0.0f, 0.0f, 1.0f, 1.0f));
+    const size_t before = heap_allocations.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+        hailo_common::add_object(roi, std::make_shared<HailoDetection>(HailoBBox(0.1f, 0.1f, 0.5f, 0.5f), 0, common::coco_eighty[1], 0.9f));
+    return heap_allocations.load(std::memory_order_relaxed) - before;
+}
+
+struct Result {
+    double us_per_frame = 0.0;
+    // Heap allocations per frame after the warm-up frame, and the worst frame of filter()
+    double roi_per_frame = 0.0;
+    double detections_per_frame = 0.0;
+    double filter_per_frame = 0.0;
+    size_t worst_filter_frame = 0;
+    size_t detections = 0;
+    float checksum = 0.0f;
+};
+
+// One pass over every frame; the ROI, the temporaries and the results all come from `memory`
+static Result run(std::vector<SyntheticPoseOutputs> &frames, const std::vector<size_t> &attach_cost,
+                  std::pmr::memory_resource *memory, common::FrameArena *arena)
+{
+    PosePostprocessConfig config;
+    PoseFrameStats stats;
+    std::vector<PersonKeypoints> persons;
+    Result result;
+    size_t roi_total = 0, detections_total = 0, filter_total = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < frames.size(); f++) {
+        const size_t before = heap_allocations.load(std::memory_order_relaxed);
+        size_t after_roi = 0;
+        {
+            HailoROIPtr roi = frames[f].roi(memory);
+            after_roi = heap_allocations.load(std::memory_order_relaxed);
+            KeypointsAndPairs keypoints_and_pairs = filter(roi, config, stats, persons, memory);
+            for (const auto &point : keypoints_and_pairs.first)
+                result.checksum += point.xs + point.ys + point.joints_scores;
+            result.checksum += float(keypoints_and_pairs.second.size());
+        }
+        if (arena)
+            arena->reset();
+        const size_t attached = attach_cost[stats.detections];
+        const size_t in_filter = heap_allocations.load(std::memory_order_relaxed) - after_roi;
+        result.detections += stats.detections;
+        if (f > 0) {
+            roi_total += after_roi - before;
+            detections_total += attached;
+            filter_total += in_filter - std::min(in_filter, attached);
+            result.worst_filter_frame = std::max(result.worst_filter_frame, in_filter - std::min(in_filter, attached));
+        }
+    }
+    const double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    const double counted = double(frames.size() - 1);
+    result.us_per_frame = elapsed / double(frames.size());
+    result.roi_per_frame = double(roi_total) / counted;
+    result.detections_per_frame = double(detections_total) / counted;
+    result.filter_per_frame = double(filter_total) / counted;
+    return result;
+}
+
+static void print(const char *name, const Result &result)
+{
+    std::printf("%-8s %10.2f %10.1f %12.1f %10.1f %14zu\n", name, result.us_per_frame, result.roi_per_frame,
+                result.detections_per_frame, result.filter_per_frame, result.worst_filter_frame);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t frame_count = std::max<size_t>(2, std::stoul(get_option(argc, argv, "-frames=", "200")));
+    const size_t passes = std::max<size_t>(1, std::stoul(get_option(argc, argv, "-passes=", "5")));
+
+    // Most persons first, then random counts up to it
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<size_t> persons(0, SyntheticPoseOutputs::MAX_PERSONS);
+    std::vector<SyntheticPoseOutputs> frames;
+    frames.reserve(frame_count);
+    frames.emplace_back(SyntheticPoseOutputs::MAX_PERSONS, 0);
+    for (size_t f = 1; f < frame_count; f++)
+        frames.emplace_back(persons(rng), uint32_t(f));
+
+    PosePostprocessConfig config;
+    std::vector<size_t> attach_cost(config.max_detections + 1);
+    for (size_t count = 0; count < attach_cost.size(); count++)
+        attach_cost[count] = attach_allocations(count);
+
+    common::FrameArena arena;
+    Result heap, frame_arena;
+    for (size_t pass = 0; pass < passes; pass++) {
+        const Result heap_pass = run(frames, attach_cost, std::pmr::new_delete_resource(), nullptr);
+        const Result arena_pass = run(frames, attach_cost, &arena, &arena);
+        if (0 == pass || heap_pass.us_per_frame < heap.us_per_frame)
+            heap = heap_pass;
+        if (0 == pass || arena_pass.us_per_frame < frame_arena.us_per_frame)
+            frame_arena = arena_pass;
+    }
+
+    std::printf("%zu frames x %zu passes, up to %zu persons, %zu detections per pass\n", frame_count, passes,
+                SyntheticPoseOutputs::MAX_PERSONS, heap.detections);
+    std::printf("%-8s %10s %10s %12s %10s %14s\n", "memory", "us/frame", "roi", "detections", "filter", "worst filter");
+    print("heap", heap);
+    print("arena", frame_arena);
+    std::printf("(heap allocations per frame after the first)\n");
+    std::printf("Arena: %zu KiB, peak frame %zu KiB, %zu allocations served, %zu from the heap\n", arena.capacity() / 1024,
+                arena.high_water() / 1024, arena.total().allocations, arena.total().upstream_allocations);
+
+    if (heap.checksum != frame_arena.checksum || heap.detections != frame_arena.detections) {
+        std::printf("FAILED: results differ\n");
+        return 1;
+    }
+    if (0 != frame_arena.worst_filter_frame) {
+        std::printf("FAILED: filter() touched the heap on the arena after the warm-up frame\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * Publish-to-read latency of the pose channels.
+ *
+ * A writer thread publishes PoseMessages at a fixed interval, stamping each with the steady clock
+ * just before publish(); a reader thread (spinning on the seqlock, or polling the socket) stamps
+ * it again once read. Both clocks are CLOCK_MONOTONIC, so the numbers hold for a reader in another
+ * process as well: the path is the same shared cache lines or the same kernel socket.
+ * The shm reader spins, so run on a host with a core to spare; sharing one core with the writer
+ * it misses messages and its latency becomes the scheduler's.
+ *
+ * Usage: pose_channel_bench [-transport=shm|socket|both] [-messages=N] [-interval_us=US]
+ **/
+#include "pose_channel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+static void report(const std::string &title, std::vector<int64_t> &samples, size_t published)
+{
+    if (samples.empty()) {
+        std::cout << title << ": no message read" << std::endl;
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double percent) {
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(percent / 100.0 * double(samples.size())));
+        return double(samples[index]) / 1000.0;
+    };
+    std::printf("%-16s %6zu/%zu  p50 %8.2f us  p99 %8.2f us  p99.9 %8.2f us  max %8.2f us\n",
+                title.c_str(), samples.size(), published, at(50), at(99), at(99.9), double(samples.back()) / 1000.0);
+}
+
+static PoseMessage make_message()
+{
+    PoseMessage message;
+    std::memset(&message, 0, sizeof(message));
+    message.magic = POSE_MESSAGE_MAGIC;
+    message.version = POSE_MESSAGE_VERSION;
+    message.person_count = 1;
+    return message;
+}
+
+// The writer, shared by both transports. Returns the duration of every publish() call.
+template <typename Publish>
+static std::vector<int64_t> run_writer(size_t messages, std::chrono::microseconds interval, Publish publish)
+{
+    std::vector<int64_t> publish_cost;
+    publish_cost.reserve(messages);
+    PoseMessage message = make_message();
+    auto next = std::chrono::steady_clock::now();
+    for (size_t i = 1; i <= messages; i++) {
+        next += interval;
+        std::this_thread::sleep_until(next);
+        message.frame_id = i;
+        message.publish_time_ns = now_ns();
+        message.capture_time_ns = message.publish_time_ns;
+        publish(message);
+        publish_cost.push_back(now_ns() - message.publish_time_ns);
+    }
+    return publish_cost;
+}
+
+static void bench_shm(size_t messages, std::chrono::microseconds interval)
+{
+    const std::string name = "/pose_channel_bench_" + std::to_string(getpid());
+    PoseShmWriter writer(name);
+    PoseShmReader reader(name);
+
+    std::atomic<bool> done{false};
+    std::vector<int64_t> latency;
+    latency.reserve(messages);
+    std::thread reader_thread([&] {
+        PoseMessage message;
+        while (!done.load(std::memory_order_relaxed)) {
+            if (reader.read_latest(message))
+                latency.push_back(now_ns() - message.publish_time_ns);
+        }
+    });
+
+    auto publish_cost = run_writer(messages, interval, [&writer](const PoseMessage &m) { writer.publish(m); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    done = true;
+    reader_thread.join();
+    shm_unlink(name.c_str());
+
+    report("shm publish", publish_cost, messages);
+    report("shm read", latency, messages);
+}
+
+static void bench_socket(size_t messages, std::chrono::microseconds interval)
+{
+    const std::string path = "/tmp/pose_channel_bench_" + std::to_string(getpid()) + ".sock";
+    PoseSocketReader reader(path);
+    PoseSocketWriter writer(path);
+
+    std::atomic<bool> done{false};
+    std::vector<int64_t> latency;
+    latency.reserve(messages);
+    std::thread reader_thread([&] {
+        PoseMessage message;
+        while (!done.load(std::memory_order_relaxed)) {
+            if (reader.read_next(message, 10))
+                latency.push_back(now_ns() - message.publish_time_ns);
+        }
+    });
+
+    auto publish_cost = run_writer(messages, interval, [&writer](const PoseMessage &m) { writer.publish(m); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    done = true;
+    reader_thread.join();
+
+    report("socket publish", publish_cost, messages);
+    report("socket read", latency, messages);
+    if (writer.dropped() > 0)
+        std::cout << "socket dropped " << writer.dropped() << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    const std::string transport = get_option(argc, argv, "-transport=", "both");
+    const size_t messages = std::stoul(get_option(argc, argv, "-messages=", "100000"));
+    const auto interval = std::chrono::microseconds(std::stol(get_option(argc, argv, "-interval_us=", "100")));
+
+    std::cout << "PoseMessage " << sizeof(PoseMessage) << " bytes, " << messages << " messages every "
+              << interval.count() << " us" << std::endl;
+    try {
+        if (transport == "shm" || transport == "both")
+            bench_shm(messages, interval);
+        if (transport == "socket" || transport == "both")
+            bench_socket(messages, interval);
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
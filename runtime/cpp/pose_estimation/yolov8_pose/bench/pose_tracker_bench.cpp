@@ -0,0 +1,144 @@
+/**
+ * PoseTracker update time and identity stability on synthetic tracks.
+ *
+ * Every synthetic person walks at a constant velocity with a fixed skeleton, measured with
+ * Gaussian jitter on every keypoint. Each frame, a few detections are dropped and the detection
+ * order is shuffled. The benchmark reports the update() time per frame and the id switches: frames
+ * where a person's confirmed track id differs from the one it had before.
+ *
+ * Usage: pose_tracker_bench [-frames=N] [-fps=FPS] [-jitter=PIXELS] [-miss=PROBABILITY]
+ **/
+#include "pose_tracker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+struct SyntheticPerson {
+    float cx, cy, vx, vy;       // Box center and velocity per second, normalized
+    float w, h;
+    std::array<std::pair<float, float>, 17> skeleton;   // Keypoint offsets from the center, in box units
+};
+
+// Rough standing pose in box units, COCO keypoint order
+static const std::array<std::pair<float, float>, 17> STANDING = {{
+    {0.0f, -0.42f}, {-0.04f, -0.45f}, {0.04f, -0.45f}, {-0.08f, -0.43f}, {0.08f, -0.43f},
+    {-0.18f, -0.28f}, {0.18f, -0.28f}, {-0.24f, -0.08f}, {0.24f, -0.08f}, {-0.26f, 0.08f}, {0.26f, 0.08f},
+    {-0.12f, 0.05f}, {0.12f, 0.05f}, {-0.12f, 0.25f}, {0.12f, 0.25f}, {-0.12f, 0.45f}, {0.12f, 0.45f}
+}};
+
+static void run(size_t people, TrackAssignment assignment, size_t frames, float fps, float jitter, float miss)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, jitter);
+
+    std::vector<SyntheticPerson> world(people);
+    for (auto &person : world) {
+        person.w = 0.06f + 0.08f * uniform(rng);
+        person.h = 2.5f * person.w;
+        person.cx = 0.1f + 0.8f * uniform(rng);
+        person.cy = 0.2f + 0.6f * uniform(rng);
+        person.vx = 0.2f * (uniform(rng) - 0.5f);
+        person.vy = 0.1f * (uniform(rng) - 0.5f);
+        for (size_t k = 0; k < 17; k++)
+            person.skeleton[k] = {STANDING[k].first + 0.02f * (uniform(rng) - 0.5f), STANDING[k].second};
+    }
+
+    PoseTrackerConfig config;
+    config.assignment = assignment;
+    PoseTracker tracker(config);
+
+    std::vector<PersonKeypoints> persons;
+    std::vector<size_t> truth;              // Synthetic person behind each detection
+    std::vector<uint32_t> last_id(people, 0);
+    std::vector<double> update_us;
+    size_t id_switches = 0;
+    const auto dt = std::chrono::duration<float>(1.0f / fps);
+    auto time = std::chrono::steady_clock::time_point();
+
+    for (size_t f = 0; f < frames; f++) {
+        time += std::chrono::duration_cast<std::chrono::steady_clock::duration>(dt);
+        persons.clear();
+        truth.clear();
+        for (size_t p = 0; p < people; p++) {
+            SyntheticPerson &person = world[p];
+            person.cx += person.vx * dt.count();
+            person.cy += person.vy * dt.count();
+            // Bounce off the image edges
+            if (person.cx < 0.05f || person.cx > 0.95f) person.vx = -person.vx;
+            if (person.cy < 0.15f || person.cy > 0.85f) person.vy = -person.vy;
+            if (uniform(rng) < miss)
+                continue;
+            PersonKeypoints measured;
+            measured.xmin = person.cx - person.w / 2 + noise(rng);
+            measured.ymin = person.cy - person.h / 2 + noise(rng);
+            measured.xmax = person.cx + person.w / 2 + noise(rng);
+            measured.ymax = person.cy + person.h / 2 + noise(rng);
+            measured.score = 0.6f + 0.4f * uniform(rng);
+            measured.class_id = 0;
+            for (size_t k = 0; k < 17; k++) {
+                measured.keypoints[k] = KeyPt{person.cx + person.skeleton[k].first * person.w + noise(rng),
+                                              person.cy + person.skeleton[k].second * person.h + noise(rng),
+                                              0.2f + 0.8f * uniform(rng)};
+            }
+            persons.push_back(measured);
+            truth.push_back(p);
+        }
+        // Detection order carries no identity
+        for (size_t i = persons.size(); i > 1; i--) {
+            size_t j = rng() % i;
+            std::swap(persons[i - 1], persons[j]);
+            std::swap(truth[i - 1], truth[j]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        tracker.update(persons, time);
+        update_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+        for (size_t d = 0; d < persons.size(); d++) {
+            const uint32_t id = tracker.track_id(d);
+            if (0 == id)
+                continue;
+            if (0 != last_id[truth[d]] && id != last_id[truth[d]])
+                id_switches++;
+            last_id[truth[d]] = id;
+        }
+    }
+
+    std::sort(update_us.begin(), update_us.end());
+    auto at = [&update_us](double percent) {
+        return update_us[std::min(update_us.size() - 1, static_cast<size_t>(percent / 100.0 * double(update_us.size())))];
+    };
+    std::printf("%2zu people  %-9s  p50 %7.2f us  p99 %7.2f us  max %7.2f us  id switches %zu\n", people,
+                TrackAssignment::HUNGARIAN == assignment ? "hungarian" : "greedy",
+                at(50), at(99), update_us.back(), id_switches);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t frames = std::stoul(get_option(argc, argv, "-frames=", "3000"));
+    const float fps = std::stof(get_option(argc, argv, "-fps=", "30"));
+    const float jitter = std::stof(get_option(argc, argv, "-jitter=", "2")) / 640.0f;
+    const float miss = std::stof(get_option(argc, argv, "-miss=", "0.05"));
+
+    std::printf("%zu frames at %.0f fps, %.4f keypoint jitter, %.2f miss probability\n", frames, fps, jitter, miss);
+    for (size_t people : {1, 5, 10, 20}) {
+        run(people, TrackAssignment::GREEDY, frames, fps, jitter, miss);
+        run(people, TrackAssignment::HUNGARIAN, frames, fps, jitter, miss);
+    }
+    return 0;
+}
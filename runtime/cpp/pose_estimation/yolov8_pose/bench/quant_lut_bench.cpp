@@ -0,0 +1,238 @@
+/**
+ * Accuracy and time of the quantized kernels against scalar float references.
+ *
+ * - QuantLut: every entry of the dequantize, exp, exp_delta and sigmoid tables of a few
+ *   quantizations, against the same math in double (relative error).
+ * - dfl_expectation, runtime and 16-bin: random box distributions against dequantize, std::exp
+ *   softmax and expectation in float (error in bins).
+ * - simd::softmax: random rows of several lengths against a double softmax (absolute error).
+ * - Box decoding of a 640x640 grid through Dfl16Geometry (bins fixed at compile time) and
+ *   DynamicGeometry (everything at run time), which must agree.
+ *
+ * Every error must stay within its tolerance; the run fails (exit code 1) otherwise.
+ *
+ * Usage: quant_lut_bench [-rows=N]
+ **/
+#include "common/model_descriptor.hpp"
+#include "common/quant_lut.hpp"
+#include "common/simd_kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string get_option(int argc, char **argv, const std::string &option, const std::string &fallback)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return fallback;
+}
+
+static double relative_error(double actual, double expected)
+{
+    return std::abs(actual - expected) / std::max(std::abs(expected), 1e-30);
+}
+
+static bool check(const char *name, double error, double tolerance)
+{
+    std::printf("%-28s %12.3g %12.3g %s\n", name, error, tolerance, error <= tolerance ? "ok" : "FAILED");
+    return error <= tolerance;
+}
+
+template <typename Function>
+static double ns_per_call(size_t calls, Function &&function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / double(calls);
+}
+
+// Softmax with max subtraction and expectation over dequantized bins, all in float
+static float reference_dfl(const uint8_t *bins, int bins_count, float qp_scale, float qp_zp)
+{
+    std::vector<float> logits(static_cast<size_t>(bins_count));
+    for (int i = 0; i < bins_count; i++)
+        logits[size_t(i)] = (float(bins[i]) - qp_zp) * qp_scale;
+    const float max = *std::max_element(logits.begin(), logits.end());
+    float sum = 0.0f;
+    for (float &logit : logits) {
+        logit = std::exp(logit - max);
+        sum += logit;
+    }
+    float expectation = 0.0f;
+    for (int i = 0; i < bins_count; i++)
+        expectation += logits[size_t(i)] / sum * float(i);
+    return expectation;
+}
+
+// Boxes of every anchor of one level, normalized like the postprocess does
+template <typename Geometry>
+static void decode_boxes(const Geometry &geometry, const std::vector<uint8_t> &bins, const std::vector<float> &centers,
+                         float stride, const common::QuantLut &lut, std::vector<float> &boxes)
+{
+    const size_t anchors = centers.size() / 2;
+    for (size_t j = 0; j < anchors; j++) {
+        const uint8_t *box_data = &bins[j * 4 * size_t(geometry.bins())];
+        float distances[4];
+        for (int side = 0; side < 4; side++)
+            distances[side] = geometry.dfl(box_data + side * geometry.bins(), lut) * stride;
+        boxes[4 * j] = (centers[2 * j] - distances[0]) * geometry.inv_width();
+        boxes[4 * j + 1] = (centers[2 * j + 1] - distances[1]) * geometry.inv_height();
+        boxes[4 * j + 2] = (centers[2 * j] + distances[2]) * geometry.inv_width();
+        boxes[4 * j + 3] = (centers[2 * j + 1] + distances[3]) * geometry.inv_height();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t rows = std::max<size_t>(1, std::stoul(get_option(argc, argv, "-rows=", "100000")));
+    std::mt19937 rng(1234);
+    bool passed = true;
+
+    std::printf("%-28s %12s %12s\n", "check", "max error", "tolerance");
+
+    // Tables: the box and keypoint quantizations of the synthetic outputs, and a wide one
+    const float quantizations[][2] = {{0.08f, 128.0f}, {1.0f / 255.0f, 0.0f}, {0.2f, 100.0f}};
+    double table_error = 0.0;
+    for (const auto &quantization : quantizations) {
+        const common::QuantLut lut(quantization[0], quantization[1]);
+        for (int q = 0; q < 256; q++) {
+            const double value = (double(q) - quantization[1]) * quantization[0];
+            table_error = std::max({table_error,
+                                    relative_error(lut.dequantized[q], value),
+                                    relative_error(lut.exp[q], std::exp(value)),
+                                    relative_error(lut.exp_delta[q], std::exp(-double(q) * quantization[0])),
+                                    relative_error(lut.sigmoid[q], 1.0 / (1.0 + std::exp(-value)))});
+        }
+    }
+    passed &= check("QuantLut tables (relative)", table_error, 1e-6);
+
+    // DFL: one peak per distribution, a few bins wide, over uniform noise
+    constexpr int BINS = 16;
+    const float qp_scale = 0.08f;
+    const float qp_zp = 128.0f;
+    const common::QuantLut lut(qp_scale, qp_zp);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> peak(0, BINS - 1);
+    std::vector<uint8_t> distributions(rows * BINS);
+    for (size_t row = 0; row < rows; row++) {
+        const int center = peak(rng);
+        for (int bin = 0; bin < BINS; bin++)
+            distributions[row * BINS + size_t(bin)] = uint8_t(std::max(0, 230 - 40 * std::abs(bin - center)) + byte(rng) % 24);
+    }
+    std::vector<float> expected(rows), runtime(rows), fixed(rows);
+    const double reference_ns = ns_per_call(rows, [&]() {
+        for (size_t row = 0; row < rows; row++)
+            expected[row] = reference_dfl(&distributions[row * BINS], BINS, qp_scale, qp_zp);
+    });
+    const double runtime_ns = ns_per_call(rows, [&]() {
+        for (size_t row = 0; row < rows; row++)
+            runtime[row] = common::dfl_expectation(&distributions[row * BINS], BINS, lut);
+    });
+    const double fixed_ns = ns_per_call(rows, [&]() {
+        for (size_t row = 0; row < rows; row++)
+            fixed[row] = common::dfl_expectation<BINS>(&distributions[row * BINS], lut);
+    });
+    double runtime_error = 0.0, fixed_error = 0.0;
+    for (size_t row = 0; row < rows; row++) {
+        runtime_error = std::max(runtime_error, double(std::abs(runtime[row] - expected[row])));
+        fixed_error = std::max(fixed_error, double(std::abs(fixed[row] - expected[row])));
+    }
+    passed &= check("dfl_expectation (bins)", runtime_error, 1e-4);
+    passed &= check("dfl_expectation<16> (bins)", fixed_error, 1e-4);
+
+    // Softmax: lengths around the vector widths and the class counts
+    const size_t lengths[] = {1, 7, 16, 17, 64, 80, 1000};
+    std::uniform_real_distribution<float> logit(-20.0f, 20.0f);
+    double softmax_error = 0.0;
+    for (size_t length : lengths) {
+        std::vector<float> data(length);
+        for (size_t repeat = 0; repeat < 100; repeat++) {
+            for (float &value : data)
+                value = logit(rng);
+            std::vector<double> reference(data.begin(), data.end());
+            const double max = *std::max_element(reference.begin(), reference.end());
+            double sum = 0.0;
+            for (double &value : reference) {
+                value = std::exp(value - max);
+                sum += value;
+            }
+            common::simd::softmax(data.data(), data.size());
+            for (size_t i = 0; i < length; i++)
+                softmax_error = std::max(softmax_error, std::abs(double(data[i]) - reference[i] / sum));
+        }
+    }
+    passed &= check("simd::softmax (absolute)", softmax_error, 1e-6);
+
+    std::vector<float> row(80);
+    for (float &value : row)
+        value = logit(rng);
+    std::vector<float> work(row.size());
+    const double softmax_ns = ns_per_call(rows, [&]() {
+        for (size_t i = 0; i < rows; i++) {
+            std::copy(row.begin(), row.end(), work.begin());
+            common::simd::softmax(work.data(), work.size());
+        }
+    });
+    const double scalar_softmax_ns = ns_per_call(rows, [&]() {
+        for (size_t i = 0; i < rows; i++) {
+            const float max = *std::max_element(row.begin(), row.end());
+            float sum = 0.0f;
+            for (size_t k = 0; k < row.size(); k++) {
+                work[k] = std::exp(row[k] - max);
+                sum += work[k];
+            }
+            for (float &value : work)
+                value /= sum;
+        }
+    });
+
+    // Geometry: the stride 8 level of the default 640x640 model
+    const common::ModelDescriptor model;
+    const size_t grid = size_t(model.network_width / model.strides[0]);
+    std::vector<uint8_t> level_bins(grid * grid * 4 * BINS);
+    for (auto &value : level_bins)
+        value = uint8_t(byte(rng));
+    std::vector<float> centers(grid * grid * 2);
+    for (size_t j = 0; j < grid * grid; j++) {
+        centers[2 * j] = (float(j % grid) + 0.5f) * float(model.strides[0]);
+        centers[2 * j + 1] = (float(j / grid) + 0.5f) * float(model.strides[0]);
+    }
+    std::vector<float> fixed_boxes(grid * grid * 4), dynamic_boxes(grid * grid * 4);
+    const size_t repeats = std::max<size_t>(1, rows / (grid * grid));
+    const double fixed_box_ns = ns_per_call(repeats * grid * grid, [&]() {
+        for (size_t i = 0; i < repeats; i++)
+            decode_boxes(common::Dfl16Geometry(model), level_bins, centers, float(model.strides[0]), lut, fixed_boxes);
+    });
+    const double dynamic_box_ns = ns_per_call(repeats * grid * grid, [&]() {
+        for (size_t i = 0; i < repeats; i++)
+            decode_boxes(common::DynamicGeometry(model), level_bins, centers, float(model.strides[0]), lut, dynamic_boxes);
+    });
+    double geometry_error = 0.0;
+    for (size_t i = 0; i < fixed_boxes.size(); i++)
+        geometry_error = std::max(geometry_error, double(std::abs(fixed_boxes[i] - dynamic_boxes[i])));
+    passed &= check("Dfl16Geometry (normalized)", geometry_error, 1e-6);
+
+    std::printf("\n%-28s %12s\n", "kernel", "ns/call");
+    std::printf("%-28s %12.2f\n", "reference DFL (float)", reference_ns);
+    std::printf("%-28s %12.2f\n", "dfl_expectation", runtime_ns);
+    std::printf("%-28s %12.2f\n", "dfl_expectation<16>", fixed_ns);
+    std::printf("%-28s %12.2f\n", "scalar softmax (80)", scalar_softmax_ns);
+    std::printf("%-28s %12.2f\n", "simd::softmax (80)", softmax_ns);
+    std::printf("%-28s %12.2f\n", "box, Dfl16Geometry", fixed_box_ns);
+    std::printf("%-28s %12.2f\n", "box, DynamicGeometry", dynamic_box_ns);
+    // Keeps the timed loops from being optimized away
+    float checksum = work[0];
+    for (size_t i = 0; i < rows; i++)
+        checksum += runtime[i] + fixed[i];
+    checksum += fixed_boxes[0] + dynamic_boxes[0];
+    std::printf("checksum %g\n", double(checksum));
+    return passed ? 0 : 1;
+}
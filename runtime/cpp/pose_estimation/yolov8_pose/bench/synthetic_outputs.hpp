@@ -0,0 +1,109 @@
+/**
+ * Synthetic yolov8 pose outputs for the benches, laid out like the HEF's: three levels (strides 8,
+ * 16 and 32 at 640x640) of boxes (64 DFL logits), scores (1 class) and keypoints (17 x, y, score).
+ *
+ * The background scores stay below the default 0.6 threshold. Every planted person lights up its
+ * anchor and the 4 neighbours, like a real head does: peaked box distributions that all describe
+ * the same box, and random keypoints. Above the threshold every anchor gets its own raw score, so the score order is the
+ * same for any decoder and the results can be compared one to one.
+ **/
+#pragma once
+
+#include "common/hailo_objects.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+class SyntheticPoseOutputs
+{
+public:
+    static constexpr int NETWORK_SIZE = 640;
+    static constexpr int BINS = 16;
+    // Raw scores 154..255 dequantize (1/255) above 0.6; one each for 5 anchors per person
+    static constexpr size_t MAX_PERSONS = (255 - 154 + 1) / 5;
+
+    SyntheticPoseOutputs(size_t persons, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::uniform_int_distribution<int> background(0, 120);
+        const int strides[3] = {8, 16, 32};
+        for (size_t level = 0; level < 3; level++) {
+            const uint32_t size = uint32_t(NETWORK_SIZE / strides[level]);
+            const uint32_t features[3] = {4 * BINS, 1, 51};
+            for (size_t output = 0; output < 3; output++) {
+                Output out{};
+                // Named so the ROI's name order is the postprocess order
+                std::snprintf(out.info.name, sizeof(out.info.name), "synthetic/level%zu_output%zu", level, output);
+                out.info.shape.height = size;
+                out.info.shape.width = size;
+                out.info.shape.features = features[output];
+                out.info.format.type = HAILO_FORMAT_TYPE_UINT8;
+                out.info.quant_info.qp_scale = 1 == output ? 1.0f / 255.0f : 0.08f;
+                out.info.quant_info.qp_zp = 1 == output ? 0.0f : 128.0f;
+                out.data.resize(size_t(size) * size * features[output]);
+                for (auto &value : out.data)
+                    value = uint8_t(1 == output ? background(rng) : byte(rng));
+                m_outputs.push_back(std::move(out));
+            }
+        }
+
+        std::vector<uint8_t> scores;
+        for (int raw = 154; raw <= 255; raw++)
+            scores.push_back(uint8_t(raw));
+        std::shuffle(scores.begin(), scores.end(), rng);
+        std::uniform_int_distribution<size_t> level_of(0, 2);
+        for (size_t person = 0; person < std::min(persons, MAX_PERSONS); person++) {
+            const size_t level = level_of(rng);
+            const int size = NETWORK_SIZE / strides[level];
+            std::uniform_int_distribution<int> cell(1, size - 2);
+            const int row = cell(rng);
+            const int col = cell(rng);
+            // The same box seen from every anchor: a neighbour's distances shift by one stride
+            std::uniform_int_distribution<int> peak(2, BINS - 4);
+            const int peaks[4] = {peak(rng), peak(rng), peak(rng), peak(rng)};
+            const int neighbours[5][2] = {{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+            for (size_t n = 0; n < 5; n++) {
+                const int d_row = neighbours[n][0];
+                const int d_col = neighbours[n][1];
+                const size_t anchor = size_t(row + d_row) * size_t(size) + size_t(col + d_col);
+                m_outputs[level * 3 + 1].data[anchor] = scores[person * 5 + n];
+                // Left, top, right, bottom; one dominant bin per side, a few bins wide
+                const int shifted[4] = {peaks[0] + d_col, peaks[1] + d_row, peaks[2] - d_col, peaks[3] - d_row};
+                uint8_t *bins = &m_outputs[level * 3].data[anchor * 4 * BINS];
+                for (int side = 0; side < 4; side++) {
+                    for (int bin = 0; bin < BINS; bin++)
+                        bins[side * BINS + bin] = uint8_t(std::max(0, 230 - 40 * std::abs(bin - shifted[side])) + byte(rng) % 8);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief A full-frame ROI holding the outputs, allocated from `memory` like the example does.
+     */
+    HailoROIPtr roi(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
+    {
+        std::pmr::polymorphic_allocator<HailoROI> allocator(memory);
+        HailoROIPtr roi = std::allocate_shared<HailoROI>(allocator, HailoBBox(0.0f, 0.0f, 1.0f, 1.0f));
+        for (auto &out : m_outputs)
+            roi->add_tensor(std::allocate_shared<HailoTensor>(allocator, out.data.data(), out.info));
+        return roi;
+    }
+
+    struct Output {
+        std::vector<uint8_t> data;
+        hailo_vstream_info_t info;
+    };
+
+    // Postprocess order: level by level, boxes, scores, keypoints
+    const std::vector<Output> &outputs() const { return m_outputs; }
+
+private:
+    std::vector<Output> m_outputs;
+};
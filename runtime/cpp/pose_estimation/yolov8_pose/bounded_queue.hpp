@@ -0,0 +1,132 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file bounded_queue.hpp
+ * @brief Bounded multi-producer/multi-consumer queue of move-only items with a backpressure policy
+ **/
+
+#ifndef _HAILO_BOUNDED_QUEUE_HPP_
+#define _HAILO_BOUNDED_QUEUE_HPP_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/**
+ * What the producer does when the queue is full.
+ */
+enum class BackpressureMode {
+    BLOCK,          // Wait until the consumer takes an item (lossless)
+    DROP_OLDEST,    // Evict the oldest queued item, the consumer always sees the freshest data
+    DROP_NEWEST,    // Discard the item being pushed, queued items are kept
+};
+
+/**
+ * @brief Fixed-capacity ring of items between pipeline stages. When full, push either waits (BLOCK),
+ *        replaces the oldest queued item (DROP_OLDEST) or discards the new one (DROP_NEWEST).
+ *        Dropped items are destroyed immediately and counted.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(uint32_t capacity, BackpressureMode mode) :
+        m_ring(capacity > 0 ? capacity : 1), m_mode(mode)
+    {}
+
+    // Returns false once the queue is closed
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_size == m_ring.size() && !m_closed) {
+            if (BackpressureMode::DROP_NEWEST == m_mode) {
+                m_dropped++;
+                return true;    // item is destroyed when it goes out of scope
+            }
+            if (BackpressureMode::DROP_OLDEST == m_mode) {
+                m_ring[m_head] = T();
+                m_head = (m_head + 1) % m_ring.size();
+                m_size--;
+                m_dropped++;
+            }
+            m_not_full.wait(lock, [this]{ return m_size < m_ring.size() || m_closed; });
+        }
+        if (m_closed)
+            return false;
+        m_ring[(m_head + m_size) % m_ring.size()] = std::move(item);
+        m_size++;
+        lock.unlock();
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available; returns false once the queue is closed and drained
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this]{ return m_size > 0 || m_closed; });
+        if (0 == m_size)
+            return false;
+        item = std::move(m_ring[m_head]);
+        m_ring[m_head] = T();
+        m_head = (m_head + 1) % m_ring.size();
+        m_size--;
+        lock.unlock();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available; returns an empty item once the queue is closed and drained
+    T pop()
+    {
+        T item;
+        pop(item);
+        return item;
+    }
+
+    // Queued items can still be popped after close, new pushes are refused
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+    }
+
+    bool closed()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+
+    uint64_t dropped()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+private:
+    std::vector<T> m_ring;
+    const BackpressureMode m_mode;
+    size_t m_head = 0;
+    size_t m_size = 0;
+    bool m_closed = false;
+    uint64_t m_dropped = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+};
+
+#endif /* _HAILO_BOUNDED_QUEUE_HPP_ */
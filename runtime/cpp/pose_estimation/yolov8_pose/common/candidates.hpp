@@ -0,0 +1,120 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace common
+{
+    /**
+     * @brief A proposal whose best class score passed the threshold.
+     *        Only these get dequantized and decoded further.
+     */
+    struct Candidate
+    {
+        uint32_t stride_index; // Index of the output level (stride) the anchor belongs to.
+        uint32_t index;        // Anchor index inside that level (row * width + col).
+        int class_id;
+        float score;           // Dequantized score of class_id.
+    };
+
+    /**
+     * @brief Translates a float threshold into the quantized domain of a tensor.
+     *
+     * @return int The smallest raw value q for which (q - qp_zp) * qp_scale >= threshold,
+     *         or 256 if no uint8 value can pass.
+     */
+    inline int quantize_threshold(float threshold, float qp_scale, float qp_zp)
+    {
+        for (int q = 0; q < 256; q++)
+        {
+            if ((float(q) - qp_zp) * qp_scale >= threshold)
+                return q;
+        }
+        return 256;
+    }
+
+    /**
+     * @brief Scans a raw uint8 score tensor laid out as [num_anchors x num_classes] and appends
+     *        one Candidate per anchor whose best class passes the quantized threshold.
+     *        Raw bytes are compared directly, so nothing is dequantized for rejected anchors.
+     *
+     * @param scores              Raw score tensor data.
+     * @param quantized_threshold Result of quantize_threshold() for this tensor.
+     * @param stride_index        Output level recorded in the emitted candidates.
+     * @param candidates          Output list, appended to in anchor order.
+     */
+    inline void gather_candidates(const uint8_t *scores, size_t num_anchors, size_t num_classes,
+                                  int quantized_threshold, float qp_scale, float qp_zp,
+                                  uint32_t stride_index, std::pmr::vector<Candidate> &candidates)
+    {
+        if (quantized_threshold > 255)
+            return;
+        const uint8_t threshold = static_cast<uint8_t>(quantized_threshold);
+        const size_t total = num_anchors * num_classes;
+        size_t last_anchor = SIZE_MAX;
+
+        auto visit = [&](size_t position)
+        {
+            size_t anchor = position / num_classes;
+            if (anchor == last_anchor)
+                return;
+            last_anchor = anchor;
+            const uint8_t *row = scores + anchor * num_classes;
+            size_t best = 0;
+            for (size_t c = 1; c < num_classes; c++)
+            {
+                if (row[c] > row[best])
+                    best = c;
+            }
+            candidates.push_back(Candidate{stride_index, static_cast<uint32_t>(anchor), static_cast<int>(best),
+                                           (float(row[best]) - qp_zp) * qp_scale});
+        };
+
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i threshold_vec = _mm256_set1_epi8(static_cast<char>(threshold));
+        for (; i + 32 <= total; i += 32)
+        {
+            __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(scores + i));
+            // values >= threshold  <=>  max(values, threshold) == values (unsigned)
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(values, threshold_vec), values)));
+            while (mask)
+            {
+                visit(i + static_cast<size_t>(__builtin_ctz(mask)));
+                mask &= mask - 1;
+            }
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        const uint8x16_t threshold_vec = vdupq_n_u8(threshold);
+        for (; i + 16 <= total; i += 16)
+        {
+            uint8x16_t passed = vcgeq_u8(vld1q_u8(scores + i), threshold_vec);
+            if (vmaxvq_u8(passed) == 0)
+                continue;
+            for (size_t k = 0; k < 16; k++)
+            {
+                if (scores[i + k] >= threshold)
+                    visit(i + k);
+            }
+        }
+#endif
+        for (; i < total; i++)
+        {
+            if (scores[i] >= threshold)
+                visit(i);
+        }
+    }
+
+}
@@ -0,0 +1,177 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace common
+{
+    /**
+     * @brief Allocation counters of a FrameArena. `upstream_*` are the blocks taken from the heap,
+     *        everything else was served from memory the arena already held.
+     */
+    struct ArenaCounters
+    {
+        size_t allocations = 0;
+        size_t bytes = 0;
+        size_t upstream_allocations = 0;
+        size_t upstream_bytes = 0;
+    };
+
+    /**
+     * @brief Monotonic memory resource for everything a postprocess creates for one frame. Allocation
+     *        bumps a pointer, deallocation does nothing, and reset() at the end of the frame rewinds
+     *        the pointer. A frame that does not fit spills into extra blocks; the next reset() frees
+     *        them and grows the main block to cover that frame, so once the biggest frame has been
+     *        seen every allocation is served from the main block and reset() is O(1).
+     *
+     *        Not thread safe: one arena per postprocess thread. Whatever is allocated from it must
+     *        be destroyed before reset(), see FrameScope.
+     */
+    class FrameArena : public std::pmr::memory_resource
+    {
+    public:
+        explicit FrameArena(size_t capacity = 64 * 1024, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : m_upstream(upstream)
+        {
+            grow(capacity);
+        }
+
+        ~FrameArena() override
+        {
+            release_spills();
+            m_upstream->deallocate(m_block, m_capacity, alignof(std::max_align_t));
+        }
+
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        void reset()
+        {
+            m_high_water = std::max(m_high_water, m_frame_used);
+            if (nullptr != m_spills)
+            {
+                const size_t needed = m_frame_used;
+                release_spills();
+                m_upstream->deallocate(m_block, m_capacity, alignof(std::max_align_t));
+                grow(std::max(m_capacity * 2, needed + needed / 4));
+            }
+            m_used = 0;
+            m_frame_used = 0;
+            m_frame = ArenaCounters();
+        }
+
+        // Since the last reset()
+        const ArenaCounters &frame() const { return m_frame; }
+        // Since construction, including the current frame
+        const ArenaCounters &total() const { return m_total; }
+        size_t capacity() const { return m_capacity; }
+        // Most bytes (with alignment padding) one frame has used
+        size_t high_water() const { return std::max(m_high_water, m_frame_used); }
+
+    private:
+        // Header at the start of every spill block
+        struct Spill
+        {
+            Spill *next;
+            size_t size;
+            size_t alignment;
+        };
+
+        void *do_allocate(size_t bytes, size_t alignment) override
+        {
+            m_frame.allocations++;
+            m_frame.bytes += bytes;
+            m_total.allocations++;
+            m_total.bytes += bytes;
+
+            // Bumps the main block, or the newest spill once the main block is full
+            unsigned char *base = nullptr == m_spills ? m_block : reinterpret_cast<unsigned char *>(m_spills);
+            const size_t size = nullptr == m_spills ? m_capacity : m_spills->size;
+            const uintptr_t address = reinterpret_cast<uintptr_t>(base) + m_used;
+            const size_t padding = (alignment - address % alignment) % alignment;
+            if (m_used + padding + bytes <= size)
+            {
+                void *pointer = base + m_used + padding;
+                m_used += padding + bytes;
+                m_frame_used += padding + bytes;
+                return pointer;
+            }
+
+            const size_t header = (sizeof(Spill) + alignment - 1) / alignment * alignment;
+            const size_t spill_size = std::max(header + bytes, m_capacity);
+            const size_t spill_alignment = std::max(alignment, alignof(Spill));
+            Spill *spill = static_cast<Spill *>(upstream_allocate(spill_size, spill_alignment));
+            spill->next = m_spills;
+            spill->size = spill_size;
+            spill->alignment = spill_alignment;
+            m_spills = spill;
+            m_used = header + bytes;
+            m_frame_used += header + bytes;
+            return reinterpret_cast<unsigned char *>(spill) + header;
+        }
+
+        void do_deallocate(void *, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+        void *upstream_allocate(size_t bytes, size_t alignment)
+        {
+            m_frame.upstream_allocations++;
+            m_frame.upstream_bytes += bytes;
+            m_total.upstream_allocations++;
+            m_total.upstream_bytes += bytes;
+            return m_upstream->allocate(bytes, alignment);
+        }
+
+        void grow(size_t capacity)
+        {
+            m_block = static_cast<unsigned char *>(upstream_allocate(capacity, alignof(std::max_align_t)));
+            m_capacity = capacity;
+        }
+
+        void release_spills()
+        {
+            while (nullptr != m_spills)
+            {
+                Spill *next = m_spills->next;
+                m_upstream->deallocate(m_spills, m_spills->size, m_spills->alignment);
+                m_spills = next;
+            }
+        }
+
+        std::pmr::memory_resource *m_upstream;
+        unsigned char *m_block = nullptr;
+        size_t m_capacity = 0;
+        size_t m_used = 0;          // In the main block, or in the newest spill
+        size_t m_frame_used = 0;    // Everything since the last reset()
+        size_t m_high_water = 0;
+        Spill *m_spills = nullptr;
+        ArenaCounters m_frame;
+        ArenaCounters m_total;
+    };
+
+    /**
+     * @brief Resets the arena when it goes out of scope. Declare it before anything that allocates
+     *        from the arena, so those are destroyed first.
+     */
+    class FrameScope
+    {
+    public:
+        explicit FrameScope(FrameArena &arena) : m_arena(arena) {}
+        ~FrameScope() { m_arena.reset(); }
+
+        FrameScope(const FrameScope &) = delete;
+        FrameScope &operator=(const FrameScope &) = delete;
+
+        FrameArena &arena() { return m_arena; }
+
+    private:
+        FrameArena &m_arena;
+    };
+}
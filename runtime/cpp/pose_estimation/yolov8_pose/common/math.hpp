@@ -4,6 +4,8 @@
 **/
 #pragma once
 
+#include "simd_kernels.hpp"
+
 #include "xtensor/containers/xarray.hpp"
 #include "xtensor/core/xeval.hpp"
 #include "xtensor/misc/xsort.hpp"
@@ -50,11 +52,8 @@ namespace common
 
     void softmax_1D(float *data, const int size)
     {
-        float sum = 0;
-        for (int i = 0; i < size; i++)
-            sum += std::exp(data[i]);
-        for (int i = 0; i < size; i++)
-            data[i] = std::exp(data[i]) / sum;
+        // Max-subtracted, exp evaluated once per element
+        simd::softmax(data, static_cast<size_t>(size));
     }
 
     void softmax_2D(float *data, const int num_rows, const int num_cols)
@@ -0,0 +1,290 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hailo/hailort.h"
+#include "quant_lut.hpp"
+
+namespace common
+{
+    /**
+     * @brief Geometry and thresholds of a yolov8 head. Defaults are the 640x640 COCO detector; the
+     *        real values come from the HEF (describe_model) and an optional config file (load_model_config).
+     *
+     *        Every output level is three tensors of the same grid, in this order: boxes
+     *        (4 * (regression_length + 1) features), scores (num_classes) and the task head
+     *        (head_features: 51 keypoint values for pose, 32 mask coefficients for seg).
+     *        strides[i] is the stride of level i in postprocess order (postprocess_order()).
+     */
+    struct ModelDescriptor
+    {
+        int network_width = 640;
+        int network_height = 640;
+        std::vector<int> strides = {8, 16, 32};
+        int regression_length = 15;
+        int num_classes = 80;
+        int head_features = 0;              // 0 leaves it unchecked
+        int proto_width = 0;                // Seg prototype masks; 0 when the model has none
+        int proto_height = 0;
+        int proto_features = 0;
+        float score_threshold = 0.6f;
+        float iou_threshold = 0.7f;
+        float mask_threshold = 0.7f;        // Seg mask probability a pixel must exceed to belong to the instance
+
+        std::array<int, 2> network_dims() const { return {network_width, network_height}; }
+        bool has_proto() const { return proto_features > 0; }
+        bool is_proto(const hailo_vstream_info_t &info) const
+        {
+            return has_proto() && int(info.shape.width) == proto_width && int(info.shape.height) == proto_height &&
+                   int(info.shape.features) == proto_features;
+        }
+    };
+
+    /**
+     * @brief The order the postprocess reads the outputs in: HailoROI keeps its tensors by name, so
+     *        describe_model and validate_model must see them sorted by name too.
+     */
+    inline std::vector<hailo_vstream_info_t> postprocess_order(std::vector<hailo_vstream_info_t> outputs)
+    {
+        std::stable_sort(outputs.begin(), outputs.end(),
+                         [](const hailo_vstream_info_t &a, const hailo_vstream_info_t &b) { return std::strcmp(a.name, b.name) < 0; });
+        return outputs;
+    }
+
+    /**
+     * @brief Reads the geometry from the HEF stream infos, overwriting the geometry fields of `model`
+     *        (thresholds are left alone).
+     *
+     * @param input   The network input.
+     * @param outputs Outputs in postprocess order (postprocess_order()).
+     *                An output whose grid no other output shares is the prototype tensor.
+     */
+    inline void describe_model(const hailo_vstream_info_t &input, const std::vector<hailo_vstream_info_t> &outputs,
+                               ModelDescriptor &model)
+    {
+        model.network_width = int(input.shape.width);
+        model.network_height = int(input.shape.height);
+        model.strides.clear();
+        model.proto_width = model.proto_height = model.proto_features = 0;
+
+        size_t i = 0;
+        while (i < outputs.size())
+        {
+            const auto &shape = outputs[i].shape;
+            size_t end = i;
+            while (end < outputs.size() && outputs[end].shape.width == shape.width && outputs[end].shape.height == shape.height)
+                end++;
+
+            if (end - i == 1)
+            {
+                if (model.has_proto())
+                    throw std::runtime_error("More than one unpaired output in the HEF, expected at most a prototype tensor");
+                model.proto_width = int(shape.width);
+                model.proto_height = int(shape.height);
+                model.proto_features = int(shape.features);
+            }
+            else if (end - i == 3)
+            {
+                if (0 == shape.width || model.network_width % int(shape.width) != 0 ||
+                    model.network_width / int(shape.width) != model.network_height / int(std::max<uint32_t>(shape.height, 1)))
+                    throw std::runtime_error("Output " + std::string(outputs[i].name) + " is not a whole stride of the input");
+                model.strides.push_back(model.network_width / int(shape.width));
+
+                const int box_features = int(outputs[i].shape.features);
+                if (box_features % 4 != 0)
+                    throw std::runtime_error("Output " + std::string(outputs[i].name) + " is not a box distribution");
+                const int regression_length = box_features / 4 - 1;
+                const int num_classes = int(outputs[i + 1].shape.features);
+                const int head_features = int(outputs[i + 2].shape.features);
+                if (model.strides.size() > 1 &&
+                    (regression_length != model.regression_length || num_classes != model.num_classes || head_features != model.head_features))
+                    throw std::runtime_error("Output levels of the HEF disagree on the head layout");
+                model.regression_length = regression_length;
+                model.num_classes = num_classes;
+                model.head_features = head_features;
+            }
+            else
+            {
+                throw std::runtime_error("Unexpected output group of " + std::to_string(end - i) + " tensors at " + outputs[i].name);
+            }
+            i = end;
+        }
+        if (model.strides.empty())
+            throw std::runtime_error("No yolov8 output levels in the HEF");
+    }
+
+    /**
+     * @brief Applies a `key = value` config file on top of `model`. Lines starting with '#' are comments.
+     *        Keys are the ModelDescriptor field names; strides is a comma separated list.
+     *        Geometry read from the HEF should only be overridden for models it cannot describe.
+     */
+    inline void load_model_config(const std::string &path, ModelDescriptor &model)
+    {
+        std::ifstream file(path);
+        if (!file)
+            throw std::runtime_error("Failed to open model config " + path);
+
+        auto trim = [](std::string s) {
+            auto space = [](unsigned char c) { return std::isspace(c) != 0; };
+            s.erase(s.begin(), std::find_if_not(s.begin(), s.end(), space));
+            s.erase(std::find_if_not(s.rbegin(), s.rend(), space).base(), s.end());
+            return s;
+        };
+
+        std::string line;
+        for (int number = 1; std::getline(file, line); number++)
+        {
+            line = trim(line);
+            if (line.empty() || '#' == line[0])
+                continue;
+            const size_t equals = line.find('=');
+            if (std::string::npos == equals)
+                throw std::runtime_error(path + ":" + std::to_string(number) + ": expected key = value");
+            const std::string key = trim(line.substr(0, equals));
+            const std::string value = trim(line.substr(equals + 1));
+
+            try
+            {
+                if ("network_width" == key)
+                    model.network_width = std::stoi(value);
+                else if ("network_height" == key)
+                    model.network_height = std::stoi(value);
+                else if ("regression_length" == key)
+                    model.regression_length = std::stoi(value);
+                else if ("num_classes" == key)
+                    model.num_classes = std::stoi(value);
+                else if ("head_features" == key)
+                    model.head_features = std::stoi(value);
+                else if ("proto_width" == key)
+                    model.proto_width = std::stoi(value);
+                else if ("proto_height" == key)
+                    model.proto_height = std::stoi(value);
+                else if ("proto_features" == key)
+                    model.proto_features = std::stoi(value);
+                else if ("score_threshold" == key)
+                    model.score_threshold = std::stof(value);
+                else if ("iou_threshold" == key)
+                    model.iou_threshold = std::stof(value);
+                else if ("mask_threshold" == key)
+                    model.mask_threshold = std::stof(value);
+                else if ("strides" == key)
+                {
+                    model.strides.clear();
+                    std::stringstream list(value);
+                    std::string stride;
+                    while (std::getline(list, stride, ','))
+                        model.strides.push_back(std::stoi(trim(stride)));
+                }
+                else
+                    throw std::runtime_error(path + ":" + std::to_string(number) + ": unknown key " + key);
+            }
+            catch (const std::logic_error &)
+            {
+                throw std::runtime_error(path + ":" + std::to_string(number) + ": bad value for " + key);
+            }
+        }
+    }
+
+    /**
+     * @brief Checks that the outputs (postprocess order) match what `model` expects, so a config file
+     *        that contradicts the HEF fails at startup instead of decoding garbage.
+     */
+    inline void validate_model(const ModelDescriptor &model, const std::vector<hailo_vstream_info_t> &outputs)
+    {
+        const size_t expected = model.strides.size() * 3 + (model.has_proto() ? 1 : 0);
+        if (outputs.size() != expected)
+            throw std::runtime_error("Model expects " + std::to_string(expected) + " outputs, the HEF has " + std::to_string(outputs.size()));
+
+        size_t head = 0;    // Index among the non-prototype outputs
+        for (size_t i = 0; i < outputs.size(); i++)
+        {
+            if (model.is_proto(outputs[i]))
+                continue;
+            const size_t position = head % 3;
+            const int stride = model.strides[head / 3];
+            const auto &shape = outputs[i].shape;
+            const std::string name = outputs[i].name;
+            if (stride <= 0 || int(shape.width) != model.network_width / stride || int(shape.height) != model.network_height / stride)
+                throw std::runtime_error("Output " + name + " does not match stride " + std::to_string(stride));
+            if (0 == position && int(shape.features) != 4 * (model.regression_length + 1))
+                throw std::runtime_error("Output " + name + " does not match regression_length " + std::to_string(model.regression_length));
+            if (1 == position && int(shape.features) != model.num_classes)
+                throw std::runtime_error("Output " + name + " does not match num_classes " + std::to_string(model.num_classes));
+            if (2 == position && 0 != model.head_features && int(shape.features) != model.head_features)
+                throw std::runtime_error("Output " + name + " does not match head_features " + std::to_string(model.head_features));
+            head++;
+        }
+    }
+
+    //-------------------------------
+    // COMPILE-TIME GEOMETRIES
+    //-------------------------------
+    /**
+     * @brief Any input with the default 16-bin DFL. The bin count is known at compile time so the bin
+     *        loops unroll fully; the normalization is read at run time, folding it in as a constant
+     *        per input size measured no faster (quant_lut_bench).
+     */
+    struct Dfl16Geometry
+    {
+        static constexpr int BINS = 16;
+
+        explicit Dfl16Geometry(const ModelDescriptor &model)
+            : m_inv_width(1.0f / float(model.network_width)),
+              m_inv_height(1.0f / float(model.network_height)) {}
+
+        static constexpr int bins() { return BINS; }
+        float inv_width() const { return m_inv_width; }
+        float inv_height() const { return m_inv_height; }
+        static float dfl(const uint8_t *data, const QuantLut &lut) { return dfl_expectation<BINS>(data, lut); }
+
+    private:
+        float m_inv_width;
+        float m_inv_height;
+    };
+
+    /**
+     * @brief Any other geometry, read at run time.
+     */
+    struct DynamicGeometry
+    {
+        explicit DynamicGeometry(const ModelDescriptor &model)
+            : m_bins(model.regression_length + 1),
+              m_inv_width(1.0f / float(model.network_width)),
+              m_inv_height(1.0f / float(model.network_height)) {}
+
+        int bins() const { return m_bins; }
+        float inv_width() const { return m_inv_width; }
+        float inv_height() const { return m_inv_height; }
+        float dfl(const uint8_t *data, const QuantLut &lut) const { return dfl_expectation(data, m_bins, lut); }
+
+    private:
+        int m_bins;
+        float m_inv_width;
+        float m_inv_height;
+    };
+
+    /**
+     * @brief Calls `decode(geometry)` with a Dfl16Geometry for the default regression length, or a
+     *        DynamicGeometry for anything else.
+     */
+    template <typename Decode>
+    decltype(auto) dispatch_geometry(const ModelDescriptor &model, Decode &&decode)
+    {
+        if (Dfl16Geometry::BINS == model.regression_length + 1)
+            return decode(Dfl16Geometry(model));
+        return decode(DynamicGeometry(model));
+    }
+
+}
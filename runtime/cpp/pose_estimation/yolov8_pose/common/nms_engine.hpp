@@ -0,0 +1,202 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace common
+{
+    /**
+     * @brief Non-owning structure-of-arrays view over the boxes to suppress.
+     *        Boxes are corner coordinates (xmin, ymin, xmax, ymax) in any consistent unit.
+     */
+    struct NmsBoxes
+    {
+        const float *xmin;
+        const float *ymin;
+        const float *xmax;
+        const float *ymax;
+        const float *scores;
+        const int *class_ids;
+        size_t count;
+    };
+
+    /**
+     * @brief Greedy IoU NMS over a flat SoA of boxes that returns the indices of the survivors.
+     *
+     *        Candidates are stably sorted by descending score, so the result does not depend on
+     *        the order the anchors were decoded in. Each candidate is only tested against boxes
+     *        that were already kept and share a cell of a uniform grid laid over the boxes' extent,
+     *        which keeps crowded scenes close to O(n log n) instead of O(n^2).
+     *        The result is identical to the classic sorted greedy NMS.
+     *
+     *        Keep one engine per postprocess and reuse it: its scratch buffers only grow.
+     */
+    class NmsEngine
+    {
+    public:
+        /**
+         * @brief Runs NMS.
+         *
+         * @param boxes                    The boxes, scores and class ids.
+         * @param iou_thr                  A box is suppressed when its IoU with a kept box is >= iou_thr.
+         * @param should_nms_cross_classes If true, boxes of different classes suppress each other.
+         * @return const std::vector<uint32_t>& Indices into `boxes` of the survivors, highest score first.
+         *         Valid until the next call.
+         */
+        const std::vector<uint32_t> &run(const NmsBoxes &boxes, float iou_thr, bool should_nms_cross_classes = false)
+        {
+            m_keep.clear();
+            if (boxes.count == 0)
+                return m_keep;
+
+            m_order.resize(boxes.count);
+            std::iota(m_order.begin(), m_order.end(), 0u);
+            // Ties broken on the index: same order as a stable sort, without its temporary heap buffer
+            std::sort(m_order.begin(), m_order.end(),
+                      [&boxes](uint32_t a, uint32_t b)
+                      { return boxes.scores[a] > boxes.scores[b] || (boxes.scores[a] == boxes.scores[b] && a < b); });
+
+            build_grid(boxes);
+            m_stamps.assign(boxes.count, 0);
+            uint32_t stamp = 0;
+
+            for (uint32_t candidate : m_order)
+            {
+                int x0, y0, x1, y1;
+                cell_range(boxes, candidate, x0, y0, x1, y1);
+                stamp++;
+
+                bool suppressed = false;
+                for (int cy = y0; cy <= y1 && !suppressed; cy++)
+                {
+                    for (int cx = x0; cx <= x1 && !suppressed; cx++)
+                    {
+                        for (int32_t entry = m_cell_heads[static_cast<size_t>(cy * m_grid_width + cx)]; entry >= 0;
+                             entry = m_cell_entries[static_cast<size_t>(entry)].next)
+                        {
+                            const uint32_t kept = m_cell_entries[static_cast<size_t>(entry)].box;
+                            // A kept box spanning several cells is only tested once per candidate
+                            if (m_stamps[kept] == stamp)
+                                continue;
+                            m_stamps[kept] = stamp;
+                            if (!should_nms_cross_classes && boxes.class_ids[kept] != boxes.class_ids[candidate])
+                                continue;
+                            if (iou(boxes, kept, candidate) >= iou_thr)
+                            {
+                                suppressed = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+                if (suppressed)
+                    continue;
+
+                m_keep.push_back(candidate);
+                for (int cy = y0; cy <= y1; cy++)
+                {
+                    for (int cx = x0; cx <= x1; cx++)
+                    {
+                        int32_t &head = m_cell_heads[static_cast<size_t>(cy * m_grid_width + cx)];
+                        m_cell_entries.push_back(CellEntry{candidate, head});
+                        head = static_cast<int32_t>(m_cell_entries.size() - 1);
+                    }
+                }
+            }
+            return m_keep;
+        }
+
+    private:
+        static constexpr int MAX_GRID_SIZE = 64;
+
+        static float iou(const NmsBoxes &boxes, uint32_t a, uint32_t b)
+        {
+            const float overlap_width = std::min(boxes.xmax[a], boxes.xmax[b]) - std::max(boxes.xmin[a], boxes.xmin[b]);
+            const float overlap_height = std::min(boxes.ymax[a], boxes.ymax[b]) - std::max(boxes.ymin[a], boxes.ymin[b]);
+            const float area_of_overlap = std::max(overlap_width, 0.0f) * std::max(overlap_height, 0.0f);
+            const float area_a = (boxes.xmax[a] - boxes.xmin[a]) * (boxes.ymax[a] - boxes.ymin[a]);
+            const float area_b = (boxes.xmax[b] - boxes.xmin[b]) * (boxes.ymax[b] - boxes.ymin[b]);
+            return area_of_overlap / (area_a + area_b - area_of_overlap);
+        }
+
+        /**
+         * @brief Sizes the grid so that an average box covers about one cell per axis.
+         *        Overlapping boxes always share at least one cell, so no pair with IoU > 0 is missed.
+         */
+        void build_grid(const NmsBoxes &boxes)
+        {
+            m_origin_x = boxes.xmin[0];
+            m_origin_y = boxes.ymin[0];
+            float end_x = boxes.xmax[0], end_y = boxes.ymax[0];
+            float sum_width = 0.0f, sum_height = 0.0f;
+            for (size_t i = 0; i < boxes.count; i++)
+            {
+                m_origin_x = std::min(m_origin_x, boxes.xmin[i]);
+                m_origin_y = std::min(m_origin_y, boxes.ymin[i]);
+                end_x = std::max(end_x, boxes.xmax[i]);
+                end_y = std::max(end_y, boxes.ymax[i]);
+                sum_width += std::max(boxes.xmax[i] - boxes.xmin[i], 0.0f);
+                sum_height += std::max(boxes.ymax[i] - boxes.ymin[i], 0.0f);
+            }
+            const float count = static_cast<float>(boxes.count);
+            m_grid_width = grid_size(end_x - m_origin_x, sum_width / count);
+            m_grid_height = grid_size(end_y - m_origin_y, sum_height / count);
+            m_inv_cell_width = static_cast<float>(m_grid_width) / std::max(end_x - m_origin_x, 1e-6f);
+            m_inv_cell_height = static_cast<float>(m_grid_height) / std::max(end_y - m_origin_y, 1e-6f);
+
+            m_cell_heads.assign(static_cast<size_t>(m_grid_width * m_grid_height), -1);
+            m_cell_entries.clear();
+        }
+
+        static int grid_size(float extent, float mean_box_size)
+        {
+            if (!(mean_box_size > 0.0f) || !(extent > 0.0f))
+                return 1;
+            return std::clamp(static_cast<int>(extent / mean_box_size), 1, MAX_GRID_SIZE);
+        }
+
+        void cell_range(const NmsBoxes &boxes, uint32_t i, int &x0, int &y0, int &x1, int &y1) const
+        {
+            x0 = cell_index(boxes.xmin[i] - m_origin_x, m_inv_cell_width, m_grid_width);
+            x1 = cell_index(boxes.xmax[i] - m_origin_x, m_inv_cell_width, m_grid_width);
+            y0 = cell_index(boxes.ymin[i] - m_origin_y, m_inv_cell_height, m_grid_height);
+            y1 = cell_index(boxes.ymax[i] - m_origin_y, m_inv_cell_height, m_grid_height);
+            // Degenerate (inverted) boxes still get one cell so they are tested and stored
+            x1 = std::max(x0, x1);
+            y1 = std::max(y0, y1);
+        }
+
+        static int cell_index(float offset, float inv_cell_size, int grid_size)
+        {
+            return std::clamp(static_cast<int>(std::floor(offset * inv_cell_size)), 0, grid_size - 1);
+        }
+
+        std::vector<uint32_t> m_order;
+        std::vector<uint32_t> m_keep;
+        std::vector<uint32_t> m_stamps;
+        // Kept boxes of each cell as linked lists in one buffer: the grid changes shape every call,
+        // per-cell vectors would be freed and reallocated with it
+        struct CellEntry
+        {
+            uint32_t box;
+            int32_t next;
+        };
+        std::vector<int32_t> m_cell_heads;
+        std::vector<CellEntry> m_cell_entries;
+        int m_grid_width = 1;
+        int m_grid_height = 1;
+        float m_origin_x = 0.0f;
+        float m_origin_y = 0.0f;
+        float m_inv_cell_width = 1.0f;
+        float m_inv_cell_height = 1.0f;
+    };
+
+}
@@ -4,6 +4,8 @@
 **/
 #pragma once
 
+#include <cassert>
+
 #include "hailo_objects.hpp"
 #include "xtensor/containers/xadapt.hpp"
 #include "xtensor/containers/xarray.hpp"
@@ -21,14 +23,142 @@ namespace common
         return rescaled_data;
     }
 
-    xt::xarray<uint8_t> get_xtensor(HailoTensorPtr &tensor)
+    //-------------------------------
+    // ZERO-COPY TENSOR VIEW
+    //-------------------------------
+    /**
+     * @brief Non-owning view over an output tensor's HWC buffer, with its shape, element type
+     *        and quantization attached. Reading through a view never allocates or copies;
+     *        it is only valid while the underlying HailoTensor buffer is.
+     *
+     *        Strides are in elements and default to a dense HWC layout; the strided constructor
+     *        describes a padded buffer.
+     */
+    class TensorView
     {
-        // Adapt a HailoTensorPtr to an xarray (quantized)
+    public:
+        TensorView() = default;
+
+        explicit TensorView(const HailoTensorPtr &tensor)
+            : TensorView(tensor->data(), tensor->height(), tensor->width(), tensor->features(),
+                         tensor->vstream_info().format.type,
+                         tensor->vstream_info().quant_info.qp_scale,
+                         tensor->vstream_info().quant_info.qp_zp) {}
+
+        TensorView(const uint8_t *data, size_t height, size_t width, size_t features,
+                   hailo_format_type_t format_type, float qp_scale, float qp_zp)
+            : TensorView(data, height, width, features, width * features, features,
+                         format_type, qp_scale, qp_zp) {}
+
+        /**
+         * @brief View over a padded buffer: row_stride and col_stride are in elements and must be at
+         *        least width * col_stride and features.
+         */
+        TensorView(const uint8_t *data, size_t height, size_t width, size_t features,
+                   size_t row_stride, size_t col_stride,
+                   hailo_format_type_t format_type, float qp_scale, float qp_zp)
+            : m_data(data), m_height(height), m_width(width), m_features(features),
+              m_row_stride(row_stride), m_col_stride(col_stride),
+              m_format_type(HAILO_FORMAT_TYPE_AUTO == format_type ? HAILO_FORMAT_TYPE_UINT8 : format_type),
+              m_qp_scale(qp_scale), m_qp_zp(qp_zp)
+        {
+            assert(col_stride >= features && row_stride >= width * col_stride);
+        }
+
+        size_t height() const { return m_height; }
+        size_t width() const { return m_width; }
+        size_t features() const { return m_features; }
+        size_t anchors() const { return m_height * m_width; }
+        size_t size() const { return m_height * m_width * m_features; }
+        float qp_scale() const { return m_qp_scale; }
+        float qp_zp() const { return m_qp_zp; }
+        hailo_format_type_t format_type() const { return m_format_type; }
+
+        size_t element_size() const
+        {
+            switch (m_format_type)
+            {
+            case HAILO_FORMAT_TYPE_UINT16:
+                return sizeof(uint16_t);
+            case HAILO_FORMAT_TYPE_FLOAT32:
+                return sizeof(float);
+            default:
+                return sizeof(uint8_t);
+            }
+        }
+
+        /**
+         * @brief Typed base pointer. T must match the tensor's format type.
+         *        Only views without padding can be read as one block of size() elements;
+         *        padded ones go through anchor() or at().
+         */
+        template <typename T>
+        const T *data() const
+        {
+            assert(sizeof(T) == element_size());
+            return reinterpret_cast<const T *>(m_data);
+        }
+
+        const uint8_t *data_uint8() const { return data<uint8_t>(); }
+        const uint16_t *data_uint16() const { return data<uint16_t>(); }
+        const float *data_float32() const { return data<float>(); }
+
+        /**
+         * @brief Features of one anchor (row * width + col), the unit every yolov8 head decodes.
+         */
+        template <typename T>
+        const T *anchor(size_t index) const
+        {
+            return data<T>() + (index / m_width) * m_row_stride + (index % m_width) * m_col_stride;
+        }
+
+        template <typename T>
+        T at(size_t row, size_t col, size_t feature) const
+        {
+            return data<T>()[row * m_row_stride + col * m_col_stride + feature];
+        }
+
+        float dequantize(float value) const
+        {
+            return (value - m_qp_zp) * m_qp_scale;
+        }
+
+        /**
+         * @brief Dequantized element, dispatching on the element type. float32 tensors are returned as is.
+         */
+        float get_dequantized(size_t row, size_t col, size_t feature) const
+        {
+            switch (m_format_type)
+            {
+            case HAILO_FORMAT_TYPE_UINT16:
+                return dequantize(float(at<uint16_t>(row, col, feature)));
+            case HAILO_FORMAT_TYPE_FLOAT32:
+                return at<float>(row, col, feature);
+            default:
+                return dequantize(float(at<uint8_t>(row, col, feature)));
+            }
+        }
+
+    private:
+        const uint8_t *m_data = nullptr;
+        size_t m_height = 0;
+        size_t m_width = 0;
+        size_t m_features = 0;
+        size_t m_row_stride = 0;
+        size_t m_col_stride = 0;
+        hailo_format_type_t m_format_type = HAILO_FORMAT_TYPE_UINT8;
+        float m_qp_scale = 1.0f;
+        float m_qp_zp = 0.0f;
+    };
+
+    inline xt::xarray<uint8_t> get_xtensor(HailoTensorPtr &tensor)
+    {
+        // Adapt a HailoTensorPtr to an xarray (quantized). This deep-copies the tensor, hot paths should use TensorView.
         xt::xarray<uint8_t> xtensor = xt::adapt(tensor->data(), tensor->size(), xt::no_ownership(), tensor->shape());
         return xtensor;
     }
 
-    xt::xarray<uint16_t> get_xtensor_uint16(HailoTensorPtr &tensor)
+    inline xt::xarray<uint16_t> get_xtensor_uint16(HailoTensorPtr &tensor)
     {
         // Adapt a HailoTensorPtr to an xarray (quantized)
         uint16_t *data = (uint16_t *)(tensor->data());
@@ -36,7 +166,7 @@ namespace common
         return xtensor;
     }
 
-    xt::xarray<float> get_xtensor_float(HailoTensorPtr &tensor)
+    inline xt::xarray<float> get_xtensor_float(HailoTensorPtr &tensor)
     {
         // Adapt a HailoTensorPtr to an xarray (quantized)
         auto vstream_info = tensor->vstream_info();
@@ -49,7 +179,7 @@ namespace common
      * @param tensors A map between tensors name to the tensor pointer
      * @return std::vector<HailoTensorPtr> A vector of tensor pointer.
      */
-    std::vector<HailoTensorPtr> get_tensor_values(const std::map<std::string, HailoTensorPtr> &tensors)
+    inline std::vector<HailoTensorPtr> get_tensor_values(const std::map<std::string, HailoTensorPtr> &tensors)
     {
         std::vector<HailoTensorPtr> _tensors;
         _tensors.reserve(tensors.size());
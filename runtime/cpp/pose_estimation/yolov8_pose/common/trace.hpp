@@ -0,0 +1,201 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+// Compile-time trace level, set through -DPOSTPROCESS_TRACE_LEVEL=<n> (see CMakeLists.txt).
+// Calls above the level compile to nothing.
+#ifndef POSTPROCESS_TRACE_LEVEL
+#define POSTPROCESS_TRACE_LEVEL 0
+#endif
+
+namespace common
+{
+    enum class TraceLevel : int
+    {
+        OFF = 0,
+        FRAME = 1,    // Once per frame or per output stream
+        PROPOSAL = 2, // Once per decoded proposal
+        KEYPOINT = 3, // Once per keypoint of every decoded proposal
+    };
+
+    constexpr TraceLevel TRACE_LEVEL = static_cast<TraceLevel>(POSTPROCESS_TRACE_LEVEL);
+
+    template <TraceLevel level>
+    constexpr bool trace_enabled()
+    {
+        return level != TraceLevel::OFF && static_cast<int>(level) <= static_cast<int>(TRACE_LEVEL);
+    }
+
+    enum class TraceEvent : uint32_t
+    {
+        STREAM_PROPOSALS = 1, // a: stream index, b: anchors in the stream
+        PROPOSAL = 2,         // a: stream index, b: anchor index, values: xmin, ymin, xmax, ymax
+        KEYPOINT = 3,         // a: anchor index, b: keypoint index, values: x, y, score
+    };
+
+    /**
+     * @brief Fixed-size binary trace record, written to the trace file as is.
+     */
+    struct TraceRecord
+    {
+        uint64_t timestamp_ns; // steady_clock
+        uint32_t event;
+        uint32_t a;
+        uint32_t b;
+        uint32_t reserved;
+        float values[4];
+    };
+    static_assert(sizeof(TraceRecord) == 40, "TraceRecord is part of the trace file format");
+
+    /**
+     * @brief Lock-free bounded multi-producer ring of trace records, drained by a background
+     *        thread into a binary file. Producers never block and never touch the file:
+     *        when the ring is full the record is dropped and counted.
+     *
+     *        File layout: a 16-byte header ("HPTRACE1", record size, reserved) followed by
+     *        TraceRecord entries in producer order.
+     *        The path comes from POSTPROCESS_TRACE_FILE, default "postprocess_trace.bin".
+     */
+    class TraceSink
+    {
+    public:
+        static constexpr size_t CAPACITY = 1 << 14;
+
+        static TraceSink &instance()
+        {
+            static TraceSink sink;
+            return sink;
+        }
+
+        void push(const TraceRecord &record)
+        {
+            size_t position = m_enqueue_position.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Slot &slot = m_slots[position & (CAPACITY - 1)];
+                size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0)
+                {
+                    if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        slot.record = record;
+                        slot.sequence.store(position + 1, std::memory_order_release);
+                        return;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                {
+                    position = m_enqueue_position.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+        ~TraceSink()
+        {
+            m_running.store(false, std::memory_order_release);
+            if (m_writer.joinable())
+                m_writer.join();
+            if (m_file)
+                std::fclose(m_file);
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            TraceRecord record;
+        };
+
+        TraceSink() : m_slots(std::make_unique<Slot[]>(CAPACITY))
+        {
+            for (size_t i = 0; i < CAPACITY; i++)
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+            const char *path = std::getenv("POSTPROCESS_TRACE_FILE");
+            m_file = std::fopen(path ? path : "postprocess_trace.bin", "wb");
+            if (nullptr == m_file)
+                return;
+            const char magic[8] = {'H', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+            const uint32_t header[2] = {static_cast<uint32_t>(sizeof(TraceRecord)), 0};
+            std::fwrite(magic, sizeof(magic), 1, m_file);
+            std::fwrite(header, sizeof(header), 1, m_file);
+            m_writer = std::thread(&TraceSink::drain_loop, this);
+        }
+
+        bool pop(TraceRecord &record)
+        {
+            Slot &slot = m_slots[m_dequeue_position & (CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != m_dequeue_position + 1)
+                return false;
+            record = slot.record;
+            slot.sequence.store(m_dequeue_position + CAPACITY, std::memory_order_release);
+            m_dequeue_position++;
+            return true;
+        }
+
+        void drain_loop()
+        {
+            std::array<TraceRecord, 256> batch;
+            for (;;)
+            {
+                // Read the flag first so the records pushed before shutdown are still drained
+                bool running = m_running.load(std::memory_order_acquire);
+                size_t count = 0;
+                while (count < batch.size() && pop(batch[count]))
+                    count++;
+                if (count > 0)
+                    std::fwrite(batch.data(), sizeof(TraceRecord), count, m_file);
+                else if (!running)
+                    break;
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            std::fflush(m_file);
+        }
+
+        std::unique_ptr<Slot[]> m_slots;
+        alignas(64) std::atomic<size_t> m_enqueue_position{0};
+        alignas(64) size_t m_dequeue_position = 0;
+        std::atomic<uint64_t> m_dropped{0};
+        std::atomic<bool> m_running{true};
+        std::FILE *m_file = nullptr;
+        std::thread m_writer;
+    };
+
+    /**
+     * @brief Records a trace event if `level` is compiled in, otherwise compiles to nothing.
+     */
+    template <TraceLevel level>
+    inline void trace([[maybe_unused]] TraceEvent event, [[maybe_unused]] uint32_t a, [[maybe_unused]] uint32_t b,
+                      [[maybe_unused]] float v0 = 0.0f, [[maybe_unused]] float v1 = 0.0f,
+                      [[maybe_unused]] float v2 = 0.0f, [[maybe_unused]] float v3 = 0.0f)
+    {
+        if constexpr (trace_enabled<level>())
+        {
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            TraceRecord record{static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()),
+                               static_cast<uint32_t>(event), a, b, 0, {v0, v1, v2, v3}};
+            TraceSink::instance().push(record);
+        }
+    }
+
+}
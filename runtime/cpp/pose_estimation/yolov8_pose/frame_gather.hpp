@@ -0,0 +1,191 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file frame_gather.hpp
+ * @brief Frame slots that gather the source image and every output tensor of one inference
+ **/
+
+#ifndef _HAILO_FRAME_GATHER_HPP_
+#define _HAILO_FRAME_GATHER_HPP_
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <span>
+#include <vector>
+
+#if defined(__unix__)
+#include <sys/mman.h>
+#endif
+
+#include <opencv2/core.hpp>
+
+#include "hailo/hailort.h"
+#include "frame_pool.hpp"
+
+// Output buffers are handed to the device for DMA, so they are page aligned
+static inline std::shared_ptr<uint8_t> page_aligned_alloc(size_t size, void* buff = nullptr) {
+    #if defined(__unix__)
+        auto addr = mmap(buff, size, PROT_WRITE | PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (MAP_FAILED == addr) throw std::bad_alloc();
+        return std::shared_ptr<uint8_t>(reinterpret_cast<uint8_t*>(addr), [size](void *addr) { munmap(addr, size); });
+    #else
+    #pragma error("Aligned alloc not supported")
+    #endif
+}
+
+/**
+ * One frame in flight: the source image, the network input cut from it and all N outputs it produced.
+ */
+template <typename T>
+struct FrameSlot {
+    uint64_t seq = 0;
+    std::chrono::steady_clock::time_point capture_time;
+    cv::Mat image;                          // Full source frame
+    FrameHandle frame;                      // Pool buffer behind image, if it came from a FramePool
+    cv::Rect2f roi{0.0f, 0.0f, 1.0f, 1.0f}; // Region of image the network saw, normalized
+    cv::Mat input;                          // Network-sized input sent to the device; slot-owned and
+                                            // reused, unless it is image itself
+    std::vector<std::span<T>> outputs;      // One page-aligned buffer per output, in postprocess order
+    hailo_status status = HAILO_SUCCESS;    // Inference status of this frame
+    std::chrono::steady_clock::time_point complete_time;   // When the last output was written
+
+    std::atomic<uint64_t> completed{0};     // seq + 1 once every output was written
+    std::shared_ptr<uint8_t> storage;
+};
+
+/**
+ * @brief Fixed ring of FrameSlots shared by the submitting thread, the inference completions and
+ *        postprocess.
+ *
+ *        The writer claims slot seq % slots and starts an inference job that writes every output
+ *        straight into that slot. The job's completion marks the slot complete. Postprocess only ever
+ *        sees complete slots, in seq order, so a skewed tensor set is impossible. The writer blocks
+ *        while all slots are in flight, so the slot count is also the number of jobs in flight plus
+ *        the frame in postprocess. Postprocess close()s the gather when it stops early, so a writer
+ *        waiting for a slot that will never be released gives up instead.
+ */
+template <typename T>
+class FrameGather {
+public:
+    FrameGather(const std::vector<size_t> &output_sizes, uint32_t slots = 4) :
+        m_slots(slots > 0 ? slots : 1), m_ring(std::make_unique<FrameSlot<T>[]>(m_slots))
+    {
+        // One mapping per slot, every output starting on its own page
+        const size_t page_size = 4096;
+        std::vector<size_t> offsets;
+        size_t total = 0;
+        for (size_t size : output_sizes) {
+            offsets.push_back(total);
+            total += (size * sizeof(T) + page_size - 1) / page_size * page_size;
+        }
+        for (uint32_t i = 0; i < m_slots; i++) {
+            FrameSlot<T> &slot = m_ring[i];
+            slot.storage = page_aligned_alloc(std::max(total, page_size));
+            for (size_t j = 0; j < output_sizes.size(); j++)
+                slot.outputs.emplace_back(reinterpret_cast<T*>(slot.storage.get() + offsets[j]), output_sizes[j]);
+        }
+    }
+
+    //-------------------------------
+    // WRITER
+    //-------------------------------
+    // Returns nullptr once the gather is closed
+    FrameSlot<T> *push_frame(const cv::Mat &image, std::chrono::steady_clock::time_point capture_time,
+                             FrameHandle &&frame = FrameHandle(), const cv::Rect2f &roi = cv::Rect2f(0.0f, 0.0f, 1.0f, 1.0f))
+    {
+        if (!wait_for_free_slot())
+            return nullptr;
+        const uint64_t seq = m_next_seq++;
+        FrameSlot<T> &slot = m_ring[seq % m_slots];
+        slot.seq = seq;
+        slot.capture_time = capture_time;
+        slot.image = image;
+        slot.frame = std::move(frame);
+        slot.roi = roi;
+        slot.status = HAILO_SUCCESS;
+        return &slot;
+    }
+
+    // Called once per frame when its job finished, from any thread
+    void complete_frame(FrameSlot<T> &slot, hailo_status status)
+    {
+        slot.status = status;
+        slot.complete_time = std::chrono::steady_clock::now();
+        slot.completed.store(slot.seq + 1, std::memory_order_release);
+        slot.completed.notify_all();
+    }
+
+    // Blocks until the next push_frame would not block. Lets the writer pick its frame only once
+    // the pipeline can take it, so the frame is as fresh as possible. False once the gather is closed.
+    bool wait_for_free_slot()
+    {
+        uint64_t released = m_released.load(std::memory_order_acquire);
+        for (;;) {
+            if (CLOSED == released)
+                return false;
+            if (m_next_seq - released < m_slots)
+                return true;
+            m_released.wait(released, std::memory_order_acquire);
+            released = m_released.load(std::memory_order_acquire);
+        }
+    }
+
+    //-------------------------------
+    // POSTPROCESS
+    //-------------------------------
+    FrameSlot<T> &get_complete_frame(uint64_t seq)
+    {
+        FrameSlot<T> &slot = m_ring[seq % m_slots];
+        uint64_t completed = slot.completed.load(std::memory_order_acquire);
+        while (completed != seq + 1) {
+            slot.completed.wait(completed, std::memory_order_acquire);
+            completed = slot.completed.load(std::memory_order_acquire);
+        }
+        return slot;
+    }
+
+    void release_frame(FrameSlot<T> &slot)
+    {
+        if (slot.input.data == slot.image.data)
+            slot.input.release();   // Never resize into a buffer the pool gets back
+        slot.image.release();
+        slot.frame.reset();
+        m_released.store(slot.seq + 1, std::memory_order_release);
+        m_released.notify_one();
+    }
+
+    // Stops the writer: a blocked or later push_frame / wait_for_free_slot fails. Called by
+    // postprocess when it gives up early; no frame may be released afterwards.
+    void close()
+    {
+        m_released.store(CLOSED, std::memory_order_release);
+        m_released.notify_all();
+    }
+
+    uint32_t slots() const { return m_slots; }
+
+private:
+    static constexpr uint64_t CLOSED = UINT64_MAX;
+
+
+    const uint32_t m_slots;
+    std::unique_ptr<FrameSlot<T>[]> m_ring;
+    alignas(64) uint64_t m_next_seq = 0;            // Writer-owned
+    alignas(64) std::atomic<uint64_t> m_released{0};
+};
+
+#endif /* _HAILO_FRAME_GATHER_HPP_ */
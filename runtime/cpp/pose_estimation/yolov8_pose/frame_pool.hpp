@@ -0,0 +1,161 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file frame_pool.hpp
+ * @brief Bounded pool of reusable frame buffers and the queue that carries them from capture to inference
+ **/
+
+#ifndef _HAILO_FRAME_POOL_HPP_
+#define _HAILO_FRAME_POOL_HPP_
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "bounded_queue.hpp"
+
+class FramePool;
+
+/**
+ * Move-only ownership of one pool buffer. The buffer returns to its pool when the handle is
+ * destroyed or reset, so a frame can never be used after it was recycled.
+ */
+class FrameHandle {
+public:
+    FrameHandle() = default;
+    FrameHandle(const FrameHandle &) = delete;
+    FrameHandle &operator=(const FrameHandle &) = delete;
+    FrameHandle(FrameHandle &&other) noexcept { swap(other); }
+    FrameHandle &operator=(FrameHandle &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            swap(other);
+        }
+        return *this;
+    }
+    ~FrameHandle() { reset(); }
+
+    inline void reset();
+
+    explicit operator bool() const { return nullptr != m_pool; }
+    cv::Mat &mat() { return *m_mat; }
+    const cv::Mat &mat() const { return *m_mat; }
+
+    std::chrono::steady_clock::time_point capture_time;
+
+private:
+    friend class FramePool;
+    FrameHandle(FramePool *pool, uint32_t index, cv::Mat *mat) : m_pool(pool), m_index(index), m_mat(mat) {}
+
+    void swap(FrameHandle &other) noexcept
+    {
+        std::swap(m_pool, other.m_pool);
+        std::swap(m_index, other.m_index);
+        std::swap(m_mat, other.m_mat);
+        std::swap(capture_time, other.capture_time);
+    }
+
+    FramePool *m_pool = nullptr;
+    uint32_t m_index = 0;
+    cv::Mat *m_mat = nullptr;
+};
+
+/**
+ * @brief Fixed number of frame buffers allocated once at startup. Capture reads into an acquired
+ *        buffer in place (cv::VideoCapture::read reuses a Mat of matching size and type), so the
+ *        steady state allocates and copies nothing. The pool must outlive every handle.
+ */
+class FramePool {
+public:
+    FramePool(uint32_t capacity, int rows, int cols, int type)
+    {
+        m_frames.reserve(capacity);
+        m_free.reserve(capacity);
+        for (uint32_t i = 0; i < capacity; i++) {
+            m_frames.emplace_back(rows, cols, type);
+            m_free.push_back(i);
+        }
+    }
+
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    // Blocks until a buffer is free
+    FrameHandle acquire()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]{ return !m_free.empty(); });
+        return take();
+    }
+
+    // Returns an empty handle if every buffer is in use
+    FrameHandle try_acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_free.empty() ? FrameHandle() : take();
+    }
+
+    size_t available()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_free.size();
+    }
+
+    size_t capacity() const { return m_frames.size(); }
+
+private:
+    friend class FrameHandle;
+
+    FrameHandle take()
+    {
+        uint32_t index = m_free.back();
+        m_free.pop_back();
+        return FrameHandle(this, index, &m_frames[index]);
+    }
+
+    void release(uint32_t index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(index);
+        }
+        m_cv.notify_one();
+    }
+
+    std::vector<cv::Mat> m_frames;
+    std::vector<uint32_t> m_free;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
+
+inline void FrameHandle::reset()
+{
+    if (nullptr != m_pool)
+        m_pool->release(m_index);
+    m_pool = nullptr;
+    m_mat = nullptr;
+}
+
+/**
+ * Queue of FrameHandles between the capture thread and the inference writer. With DROP_OLDEST and a
+ * capacity of 1 it is a "latest frame" mailbox: the writer always gets the freshest capture and
+ * stale frames go straight back to the pool.
+ */
+using FrameQueue = BoundedQueue<FrameHandle>;
+
+#endif /* _HAILO_FRAME_POOL_HPP_ */
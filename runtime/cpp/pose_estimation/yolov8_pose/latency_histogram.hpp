@@ -0,0 +1,209 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file latency_histogram.hpp
+ * @brief Fixed-memory latency histograms with percentile queries
+ **/
+
+#ifndef _HAILO_LATENCY_HISTOGRAM_HPP_
+#define _HAILO_LATENCY_HISTOGRAM_HPP_
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Latencies in 0.1 ms buckets up to one second, larger values land in the last bucket.
+ *        Memory does not grow with the run length, so it can stay on for a live camera.
+ *        Not thread safe: record from one thread.
+ */
+class LatencyHistogram {
+public:
+    static constexpr double BUCKET_MS = 0.1;
+    static constexpr size_t BUCKETS = 10000;
+
+    LatencyHistogram() : m_buckets(BUCKETS, 0) {}
+
+    void record(std::chrono::duration<double, std::milli> latency)
+    {
+        const double ms = std::max(latency.count(), 0.0);
+        const size_t bucket = std::min(static_cast<size_t>(ms / BUCKET_MS), BUCKETS - 1);
+        m_buckets[bucket]++;
+        m_count++;
+        m_sum_ms += ms;
+        m_max_ms = std::max(m_max_ms, ms);
+    }
+
+    // Upper edge of the bucket holding the given percentile (0-100), in milliseconds
+    double percentile(double percent) const
+    {
+        if (0 == m_count)
+            return 0.0;
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percent / 100.0 * double(m_count) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += m_buckets[i];
+            if (seen >= rank)
+                return std::min(double(i + 1) * BUCKET_MS, m_max_ms);
+        }
+        return m_max_ms;
+    }
+
+    uint64_t count() const { return m_count; }
+    double mean() const { return m_count > 0 ? m_sum_ms / double(m_count) : 0.0; }
+    double max() const { return m_max_ms; }
+
+    void reset()
+    {
+        std::fill(m_buckets.begin(), m_buckets.end(), 0);
+        m_count = 0;
+        m_sum_ms = 0.0;
+        m_max_ms = 0.0;
+    }
+
+private:
+    std::vector<uint32_t> m_buckets;
+    uint64_t m_count = 0;
+    double m_sum_ms = 0.0;
+    double m_max_ms = 0.0;
+};
+
+/**
+ * @brief HDR-style log-linear histogram of nanosecond durations, from 1 ns to about 68 s with at
+ *        most 1/32 (3.1%) relative error. Each power of two is split into 32 equal buckets, so
+ *        memory is fixed (1024 counters) whatever the range or run length.
+ *
+ *        Single writer: only the thread that owns the histogram records, with relaxed loads and
+ *        stores (no locked read-modify-write), while any thread takes snapshots. StageMetrics
+ *        keeps one per stage and recording thread.
+ */
+class HdrHistogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+    static constexpr uint32_t MAX_VALUE_BITS = 36;
+    static constexpr size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // Bucket of a value; values past the range land in the last bucket
+    static size_t bucket_of(uint64_t ns)
+    {
+        if (ns < SUB_BUCKETS)
+            return static_cast<size_t>(ns);
+        const uint32_t shift = static_cast<uint32_t>(std::bit_width(ns)) - 1 - SUB_BUCKET_BITS;
+        const size_t bucket = (shift + 1) * SUB_BUCKETS + static_cast<size_t>((ns >> shift) - SUB_BUCKETS);
+        return std::min(bucket, BUCKETS - 1);
+    }
+
+    // Exclusive upper edge of a bucket, in nanoseconds
+    static uint64_t bucket_upper(size_t bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket + 1;
+        const uint32_t shift = static_cast<uint32_t>(bucket / SUB_BUCKETS) - 1;
+        return (SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift;
+    }
+
+    /**
+     * Consistent-enough copy of the counters for reporting. Concurrent records may land in
+     * the buckets and not yet in the count, percentiles use the bucket total.
+     */
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+        uint64_t max_ns = 0;
+
+        // Upper edge of the bucket holding the given percentile (0-100), in milliseconds
+        double percentile(double percent) const
+        {
+            if (0 == count)
+                return 0.0;
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percent / 100.0 * double(count) + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); i++) {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return double(std::min(bucket_upper(i), max_ns)) * 1e-6;
+            }
+            return max();
+        }
+
+        double mean() const { return count > 0 ? double(sum_ns) / double(count) * 1e-6 : 0.0; }
+        double max() const { return double(max_ns) * 1e-6; }
+
+        // Adds the counts of another histogram (another thread's shard of the same stage)
+        void merge(const Snapshot &other)
+        {
+            buckets.resize(std::max(buckets.size(), other.buckets.size()));
+            for (size_t i = 0; i < other.buckets.size(); i++)
+                buckets[i] += other.buckets[i];
+            count += other.count;
+            sum_ns += other.sum_ns;
+            max_ns = std::max(max_ns, other.max_ns);
+        }
+
+        // What was recorded after `earlier` was taken; the maximum is bounded by the newest bucket
+        Snapshot since(const Snapshot &earlier) const
+        {
+            Snapshot delta;
+            delta.buckets.resize(buckets.size());
+            size_t last = 0;
+            for (size_t i = 0; i < buckets.size(); i++) {
+                delta.buckets[i] = buckets[i] - (i < earlier.buckets.size() ? earlier.buckets[i] : 0);
+                delta.count += delta.buckets[i];
+                if (delta.buckets[i] > 0)
+                    last = i;
+            }
+            delta.sum_ns = sum_ns - earlier.sum_ns;
+            delta.max_ns = delta.count > 0 ? std::min(bucket_upper(last), max_ns) : 0;
+            return delta;
+        }
+    };
+
+    HdrHistogram() : m_buckets(std::make_unique<std::atomic<uint64_t>[]>(BUCKETS)) {}
+
+    void record(std::chrono::nanoseconds duration)
+    {
+        const uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+        // Only this thread writes, so a load and a store cannot lose an update
+        std::atomic<uint64_t> &bucket = m_buckets[bucket_of(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_sum_ns.store(m_sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > m_max_ns.load(std::memory_order_relaxed))
+            m_max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot;
+        snapshot.buckets.resize(BUCKETS);
+        for (size_t i = 0; i < BUCKETS; i++) {
+            snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+            snapshot.count += snapshot.buckets[i];
+        }
+        snapshot.sum_ns = m_sum_ns.load(std::memory_order_relaxed);
+        snapshot.max_ns = m_max_ns.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+    alignas(64) std::atomic<uint64_t> m_sum_ns{0};
+    std::atomic<uint64_t> m_max_ns{0};
+};
+
+#endif /* _HAILO_LATENCY_HISTOGRAM_HPP_ */
@@ -0,0 +1,235 @@
+#include "pose_channel.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static std::string errno_string(const std::string &what)
+{
+    return what + ": " + std::strerror(errno);
+}
+
+static sockaddr_un socket_address(const std::string &path)
+{
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+//-------------------------------
+// SHARED MEMORY
+//-------------------------------
+
+PoseShmWriter::PoseShmWriter(const std::string &name) :
+    m_name(name)
+{
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(errno_string("Failed to open shared memory " + name));
+    }
+    if (ftruncate(fd, sizeof(PoseChannelBlock)) != 0) {
+        close(fd);
+        throw std::runtime_error(errno_string("Failed to size shared memory " + name));
+    }
+    void *addr = mmap(nullptr, sizeof(PoseChannelBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == addr) {
+        throw std::runtime_error(errno_string("Failed to map shared memory " + name));
+    }
+    m_block = static_cast<PoseChannelBlock*>(addr);
+
+    // A previous run may have died mid-publish; resume from the next even sequence
+    uint64_t seq = m_block->seq.load(std::memory_order_relaxed);
+    if (seq & 1)
+        m_block->seq.store(seq + 1, std::memory_order_release);
+    m_block->message_size = sizeof(PoseMessage);
+    m_block->magic.store(POSE_MESSAGE_MAGIC, std::memory_order_release);
+}
+
+PoseShmWriter::~PoseShmWriter()
+{
+    // The object is left in place so readers keep the last pose and can outlive the writer
+    if (m_block)
+        munmap(m_block, sizeof(PoseChannelBlock));
+}
+
+void PoseShmWriter::publish(const PoseMessage &message)
+{
+    const uint64_t seq = m_block->seq.load(std::memory_order_relaxed);
+    m_block->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint8_t *src = reinterpret_cast<const uint8_t*>(&message);
+    for (size_t i = 0; i < PoseChannelBlock::WORDS; i++) {
+        uint64_t word;
+        std::memcpy(&word, src + i * 8, 8);
+        m_block->words[i].store(word, std::memory_order_relaxed);
+    }
+
+    m_block->seq.store(seq + 2, std::memory_order_release);
+}
+
+PoseShmReader::PoseShmReader(const std::string &name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::runtime_error(errno_string("Failed to open shared memory " + name));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(PoseChannelBlock)) {
+        close(fd);
+        throw std::runtime_error("Shared memory " + name + " is not a pose channel");
+    }
+    void *addr = mmap(nullptr, sizeof(PoseChannelBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == addr) {
+        throw std::runtime_error(errno_string("Failed to map shared memory " + name));
+    }
+    m_block = static_cast<const PoseChannelBlock*>(addr);
+}
+
+PoseShmReader::~PoseShmReader()
+{
+    if (m_block)
+        munmap(const_cast<PoseChannelBlock*>(m_block), sizeof(PoseChannelBlock));
+}
+
+bool PoseShmReader::read_latest(PoseMessage &message)
+{
+    if (m_block->magic.load(std::memory_order_acquire) != POSE_MESSAGE_MAGIC ||
+        m_block->message_size != sizeof(PoseMessage)) {
+        return false;
+    }
+
+    uint8_t *dst = reinterpret_cast<uint8_t*>(&message);
+    for (;;) {
+        const uint64_t begin = m_block->seq.load(std::memory_order_acquire);
+        if (begin == m_last_seq)
+            return false;
+        if (begin & 1)
+            continue;   // Writer is mid-publish, a copy takes well under a microsecond
+
+        for (size_t i = 0; i < PoseChannelBlock::WORDS; i++) {
+            uint64_t word = m_block->words[i].load(std::memory_order_relaxed);
+            std::memcpy(dst + i * 8, &word, 8);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_block->seq.load(std::memory_order_relaxed) == begin) {
+            m_last_seq = begin;
+            return true;
+        }
+    }
+}
+
+//-------------------------------
+// UNIX DOMAIN SOCKET
+//-------------------------------
+
+PoseSocketWriter::PoseSocketWriter(const std::string &path) :
+    m_path(path)
+{
+    socket_address(path);
+    m_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        throw std::runtime_error(errno_string("Failed to create pose socket"));
+    }
+}
+
+PoseSocketWriter::~PoseSocketWriter()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+bool PoseSocketWriter::publish(const PoseMessage &message)
+{
+    // Not connected: the controller may start, stop and restart independently of the writer
+    const sockaddr_un address = socket_address(m_path);
+    ssize_t sent = sendto(m_fd, &message, sizeof(message), MSG_NOSIGNAL,
+                          reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    if (sent != static_cast<ssize_t>(sizeof(message))) {
+        m_dropped++;
+        return false;
+    }
+    return true;
+}
+
+PoseSocketReader::PoseSocketReader(const std::string &path) :
+    m_path(path)
+{
+    const sockaddr_un address = socket_address(path);
+    m_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        throw std::runtime_error(errno_string("Failed to create pose socket"));
+    }
+    unlink(path.c_str());
+    if (bind(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(m_fd);
+        throw std::runtime_error(errno_string("Failed to bind pose socket " + path));
+    }
+}
+
+PoseSocketReader::~PoseSocketReader()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+        unlink(m_path.c_str());
+    }
+}
+
+bool PoseSocketReader::read_latest(PoseMessage &message)
+{
+    bool received = false;
+    PoseMessage next;
+    while (recv(m_fd, &next, sizeof(next), MSG_DONTWAIT) == static_cast<ssize_t>(sizeof(next))) {
+        message = next;
+        received = true;
+    }
+    return received;
+}
+
+bool PoseSocketReader::read_next(PoseMessage &message, int timeout_ms)
+{
+    pollfd pfd{m_fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return false;
+    return recv(m_fd, &message, sizeof(message), MSG_DONTWAIT) == static_cast<ssize_t>(sizeof(message));
+}
+
+//-------------------------------
+// PUBLISHER
+//-------------------------------
+
+PosePublisher::PosePublisher(const std::string &shm_name, const std::string &socket_path)
+{
+    if (!shm_name.empty())
+        m_shm = std::make_unique<PoseShmWriter>(shm_name);
+    if (!socket_path.empty())
+        m_socket = std::make_unique<PoseSocketWriter>(socket_path);
+}
+
+void PosePublisher::publish(const PoseMessage &message)
+{
+    if (m_shm)
+        m_shm->publish(message);
+    if (m_socket)
+        m_socket->publish(message);
+}
+
+uint64_t PosePublisher::socket_dropped() const
+{
+    return m_socket ? m_socket->dropped() : 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file pose_channel.hpp
+ * @brief Latest-value pose channels: shared-memory seqlock and Unix-domain datagram socket
+ **/
+
+#ifndef _HAILO_POSE_CHANNEL_HPP_
+#define _HAILO_POSE_CHANNEL_HPP_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "pose_message.hpp"
+
+/**
+ * Layout of the shared-memory object. A zero-filled object (fresh from ftruncate) reads as "no
+ * message yet". The payload is stored as relaxed 64-bit atomics so a torn read is well defined and
+ * simply retried.
+ */
+struct PoseChannelBlock {
+    static constexpr size_t WORDS = sizeof(PoseMessage) / 8;
+
+    std::atomic<uint32_t> magic;
+    uint32_t message_size;
+    alignas(64) std::atomic<uint64_t> seq;      // Odd while a write is in progress, 2 * messages published otherwise
+    alignas(64) std::atomic<uint64_t> words[WORDS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Seqlock words must be lock free to live in shared memory");
+
+/**
+ * @brief Single writer of a shared-memory seqlock (POSIX shm_open, name like "/drone_pose").
+ *        publish() is two atomic stores around a copy of the message: no lock, no syscall, and a
+ *        slow reader can never delay the writer. Readers only ever see the newest message.
+ */
+class PoseShmWriter {
+public:
+    // Creates (or reuses) the shared-memory object; throws std::runtime_error on failure
+    explicit PoseShmWriter(const std::string &name);
+    ~PoseShmWriter();
+
+    PoseShmWriter(const PoseShmWriter &) = delete;
+    PoseShmWriter &operator=(const PoseShmWriter &) = delete;
+
+    void publish(const PoseMessage &message);
+
+private:
+    std::string m_name;
+    PoseChannelBlock *m_block = nullptr;
+};
+
+/**
+ * @brief Reader side of PoseShmWriter, for any number of processes. read_latest() copies the
+ *        newest message into the caller's buffer with plain loads; it retries only if the writer
+ *        was mid-publish.
+ */
+class PoseShmReader {
+public:
+    // Maps an existing shared-memory object read-only; throws std::runtime_error on failure
+    explicit PoseShmReader(const std::string &name);
+    ~PoseShmReader();
+
+    PoseShmReader(const PoseShmReader &) = delete;
+    PoseShmReader &operator=(const PoseShmReader &) = delete;
+
+    // True if a message newer than the last one returned was copied into `message`
+    bool read_latest(PoseMessage &message);
+
+    // Sequence number of the newest published message (0 before the first one), without copying it
+    uint64_t latest_seq() const { return m_block->seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    const PoseChannelBlock *m_block = nullptr;
+    uint64_t m_last_seq = 0;
+};
+
+/**
+ * @brief Fallback transport for controllers that cannot map the writer's shared memory (another
+ *        container, another user). Each message is one non-blocking datagram to a socket the
+ *        controller bound; messages are dropped, and counted, while nobody is listening or the
+ *        socket buffer is full.
+ */
+class PoseSocketWriter {
+public:
+    // Throws std::runtime_error on failure
+    explicit PoseSocketWriter(const std::string &path);
+    ~PoseSocketWriter();
+
+    PoseSocketWriter(const PoseSocketWriter &) = delete;
+    PoseSocketWriter &operator=(const PoseSocketWriter &) = delete;
+
+    bool publish(const PoseMessage &message);
+    uint64_t dropped() const { return m_dropped; }
+
+private:
+    std::string m_path;
+    int m_fd = -1;
+    uint64_t m_dropped = 0;
+};
+
+/**
+ * @brief Binds the socket PoseSocketWriter sends to (replacing a stale one).
+ */
+class PoseSocketReader {
+public:
+    // Throws std::runtime_error on failure
+    explicit PoseSocketReader(const std::string &path);
+    ~PoseSocketReader();
+
+    PoseSocketReader(const PoseSocketReader &) = delete;
+    PoseSocketReader &operator=(const PoseSocketReader &) = delete;
+
+    // Drains the socket without blocking and keeps the newest message. True if one was received.
+    bool read_latest(PoseMessage &message);
+
+    // Blocks up to timeout_ms for the next message
+    bool read_next(PoseMessage &message, int timeout_ms);
+
+private:
+    std::string m_path;
+    int m_fd = -1;
+};
+
+/**
+ * @brief What the example publishes to; each transport is optional and both may be used at once.
+ */
+class PosePublisher {
+public:
+    // Empty name or path leaves that transport off; throws std::runtime_error if one fails to open
+    PosePublisher(const std::string &shm_name, const std::string &socket_path);
+
+    bool enabled() const { return nullptr != m_shm || nullptr != m_socket; }
+    void publish(const PoseMessage &message);
+    uint64_t socket_dropped() const;
+
+private:
+    std::unique_ptr<PoseShmWriter> m_shm;
+    std::unique_ptr<PoseSocketWriter> m_socket;
+};
+
+#endif /* _HAILO_POSE_CHANNEL_HPP_ */
@@ -0,0 +1,31 @@
+/**
+* Copyright (c) 2021-2022 Hailo Technologies Ltd. All rights reserved.
+* Distributed under the LGPL license (https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt)
+**/
+#pragma once
+#include <array>
+#include <utility>
+
+struct KeyPt {
+    float xs;
+    float ys;
+    float joints_scores;
+};
+
+struct PairPairs {
+    std::pair<float, float> pt1;
+    std::pair<float, float> pt2;
+    float s1;
+    float s2;
+};
+
+/**
+ * @brief One detected person with all of its keypoints, whatever their score.
+ *        Box and keypoints are normalized to the network input, [0, 1].
+ */
+struct PersonKeypoints {
+    float xmin, ymin, xmax, ymax;
+    float score;
+    int class_id;
+    std::array<KeyPt, 17> keypoints;
+};
@@ -0,0 +1,68 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file pose_message.hpp
+ * @brief Fixed-size binary pose message shared with the flight controller
+ **/
+
+#ifndef _HAILO_POSE_MESSAGE_HPP_
+#define _HAILO_POSE_MESSAGE_HPP_
+
+#include <stdint.h>
+#include <type_traits>
+
+constexpr uint32_t POSE_MESSAGE_MAGIC = 0x45534f50;     // "POSE"
+constexpr uint16_t POSE_MESSAGE_VERSION = 3;
+constexpr uint32_t POSE_MAX_PERSONS = 8;
+constexpr uint32_t POSE_NUM_KEYPOINTS = 17;             // COCO order: nose, eyes, ears, shoulders, elbows, wrists, hips, knees, ankles
+
+struct PoseKeypoint {
+    float x;        // Normalized to the image, [0, 1]
+    float y;
+    float score;
+};
+
+struct PosePerson {
+    float xmin;     // Normalized to the image, [0, 1]
+    float ymin;
+    float xmax;
+    float ymax;
+    float score;
+    uint32_t class_id;
+    uint32_t track_id;      // Stable across frames once the track is confirmed, 0 before that
+    PoseKeypoint keypoints[POSE_NUM_KEYPOINTS];     // All 17, low scores included
+};
+
+/**
+ * One frame of results. Plain data with a fixed layout, so it is written and read as raw bytes.
+ * Timestamps are CLOCK_MONOTONIC (std::chrono::steady_clock) nanoseconds, comparable across
+ * processes on the same host.
+ */
+struct PoseMessage {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t person_count;          // Valid entries in persons, highest score first
+    uint32_t primary_track_id;      // Track the controller should follow, 0 if none
+    uint32_t reserved;
+    uint64_t frame_id;
+    int64_t capture_time_ns;
+    int64_t publish_time_ns;
+    int64_t keypoint_time_ns;       // Time the keypoints of tracked persons are smoothed or predicted to;
+                                    // untracked persons (track_id 0) are raw, at capture_time_ns
+    PosePerson persons[POSE_MAX_PERSONS];
+};
+
+static_assert(std::is_trivially_copyable_v<PoseMessage>, "PoseMessage is copied as raw bytes");
+static_assert(sizeof(PoseMessage) % 8 == 0, "PoseMessage is copied in 64-bit words");
+
+#endif /* _HAILO_POSE_MESSAGE_HPP_ */
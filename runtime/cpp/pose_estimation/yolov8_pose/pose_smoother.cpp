@@ -0,0 +1,256 @@
+#include "pose_smoother.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+//-------------------------------
+// LANES
+//-------------------------------
+// Just enough of a vector type to write the filters once for AVX2, NEON and scalar builds.
+namespace
+{
+#if defined(__AVX2__)
+    using vf = __m256;
+    using vmask = __m256;
+    constexpr size_t WIDTH = 8;
+    inline vf load(const float *p) { return _mm256_load_ps(p); }
+    inline void store(float *p, vf v) { _mm256_store_ps(p, v); }
+    inline vf set1(float x) { return _mm256_set1_ps(x); }
+    inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+    inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+    inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+    inline vf div(vf a, vf b) { return _mm256_div_ps(a, b); }
+    inline vf abs(vf a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    inline vf max(vf a, vf b) { return _mm256_max_ps(a, b); }
+    inline vmask greater_equal(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline vf select(vmask m, vf a, vf b) { return _mm256_blendv_ps(b, a, m); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    using vf = float32x4_t;
+    using vmask = uint32x4_t;
+    constexpr size_t WIDTH = 4;
+    inline vf load(const float *p) { return vld1q_f32(p); }
+    inline void store(float *p, vf v) { vst1q_f32(p, v); }
+    inline vf set1(float x) { return vdupq_n_f32(x); }
+    inline vf add(vf a, vf b) { return vaddq_f32(a, b); }
+    inline vf sub(vf a, vf b) { return vsubq_f32(a, b); }
+    inline vf mul(vf a, vf b) { return vmulq_f32(a, b); }
+    inline vf div(vf a, vf b) { return vdivq_f32(a, b); }
+    inline vf abs(vf a) { return vabsq_f32(a); }
+    inline vf max(vf a, vf b) { return vmaxq_f32(a, b); }
+    inline vmask greater_equal(vf a, vf b) { return vcgeq_f32(a, b); }
+    inline vf select(vmask m, vf a, vf b) { return vbslq_f32(m, a, b); }
+#else
+    using vf = float;
+    using vmask = bool;
+    constexpr size_t WIDTH = 1;
+    inline vf load(const float *p) { return *p; }
+    inline void store(float *p, vf v) { *p = v; }
+    inline vf set1(float x) { return x; }
+    inline vf add(vf a, vf b) { return a + b; }
+    inline vf sub(vf a, vf b) { return a - b; }
+    inline vf mul(vf a, vf b) { return a * b; }
+    inline vf div(vf a, vf b) { return a / b; }
+    inline vf abs(vf a) { return std::fabs(a); }
+    inline vf max(vf a, vf b) { return std::max(a, b); }
+    inline vmask greater_equal(vf a, vf b) { return a >= b; }
+    inline vf select(vmask m, vf a, vf b) { return m ? a : b; }
+#endif
+    static_assert(PoseSmoother::LANES % WIDTH == 0, "Joint rows are padded to the vector width");
+
+    constexpr float TWO_PI = 6.28318530717958647f;
+}
+
+PoseSmoother::PoseSmoother(const PoseSmootherConfig &config) :
+    m_config(config)
+{
+    reset();
+}
+
+void PoseSmoother::reset()
+{
+    for (auto &state : m_states)
+        state.used = false;
+}
+
+PoseSmoother::TrackState &PoseSmoother::find_or_open(uint32_t id, bool &opened)
+{
+    TrackState *oldest = &m_states[0];
+    for (auto &state : m_states) {
+        if (state.used && state.id == id) {
+            opened = false;
+            return state;
+        }
+        if (!state.used || (oldest->used && state.time < oldest->time))
+            oldest = &state;
+    }
+    opened = true;
+    oldest->used = true;
+    oldest->id = id;
+    return *oldest;
+}
+
+const PoseSmoother::TrackState *PoseSmoother::find(uint32_t id) const
+{
+    for (const auto &state : m_states) {
+        if (state.used && state.id == id)
+            return &state;
+    }
+    return nullptr;
+}
+
+void PoseSmoother::init(TrackState &state, const float measured[2][LANES])
+{
+    const float r = m_config.measurement_noise;
+    for (size_t row = 0; row < 2; row++) {
+        for (size_t j = 0; j < LANES; j++) {
+            state.value[row][j] = measured[row][j];
+            state.speed[row][j] = 0.0f;
+            state.p00[row][j] = r;
+            state.p01[row][j] = 0.0f;
+            state.p11[row][j] = m_config.initial_velocity_var;
+        }
+    }
+}
+
+void PoseSmoother::smooth(uint32_t id, std::chrono::steady_clock::time_point time, std::array<KeyPt, JOINTS> &keypoints)
+{
+    if (SmoothingFilter::NONE == m_config.filter)
+        return;
+
+    alignas(32) float measured[2][LANES] = {};
+    alignas(32) float scores[LANES] = {};      // Padding lanes score 0 and never update
+    for (size_t j = 0; j < JOINTS; j++) {
+        measured[0][j] = keypoints[j].xs;
+        measured[1][j] = keypoints[j].ys;
+        scores[j] = keypoints[j].joints_scores;
+    }
+
+    bool opened = false;
+    TrackState &state = find_or_open(id, opened);
+    if (opened) {
+        init(state, measured);
+    }
+    else {
+        const float dt = std::chrono::duration<float>(time - state.time).count();
+        if (dt <= 0.0f)
+            return;     // Same frame twice: keep the estimate
+        if (SmoothingFilter::ONE_EURO == m_config.filter)
+            update_one_euro(state, measured, scores, dt);
+        else
+            update_kalman(state, measured, scores, dt);
+    }
+    state.time = time;
+
+    for (size_t j = 0; j < JOINTS; j++) {
+        keypoints[j].xs = state.value[0][j];
+        keypoints[j].ys = state.value[1][j];
+    }
+}
+
+void PoseSmoother::update_one_euro(TrackState &state, const float measured[2][LANES], const float *scores, float dt)
+{
+    // alpha = r / (r + 1), r = 2 pi fc dt
+    const float rd = TWO_PI * m_config.derivative_cutoff * dt;
+    const vf alpha_d = set1(rd / (rd + 1.0f));
+    const vf inv_dt = set1(1.0f / dt);
+    const vf min_cutoff = set1(m_config.min_cutoff);
+    const vf beta = set1(m_config.beta);
+    const vf two_pi_dt = set1(TWO_PI * dt);
+    const vf one = set1(1.0f);
+    const vf min_score = set1(m_config.min_keypoint_score);
+
+    for (size_t j = 0; j < LANES; j += WIDTH) {
+        const vmask valid = greater_equal(load(scores + j), min_score);
+        for (size_t row = 0; row < 2; row++) {
+            const vf x = load(measured[row] + j);
+            const vf value = load(state.value[row] + j);
+            const vf speed = load(state.speed[row] + j);
+
+            const vf raw_speed = mul(sub(x, value), inv_dt);
+            const vf new_speed = add(speed, mul(alpha_d, sub(raw_speed, speed)));
+            const vf r = mul(two_pi_dt, add(min_cutoff, mul(beta, abs(new_speed))));
+            const vf alpha = div(r, add(r, one));
+            const vf new_value = add(value, mul(alpha, sub(x, value)));
+
+            store(state.value[row] + j, select(valid, new_value, value));
+            store(state.speed[row] + j, select(valid, new_speed, speed));
+        }
+    }
+}
+
+void PoseSmoother::update_kalman(TrackState &state, const float measured[2][LANES], const float *scores, float dt)
+{
+    const float q = m_config.acceleration_noise;
+    const vf vdt = set1(dt);
+    const vf q00 = set1(q * dt * dt * dt / 3.0f);
+    const vf q01 = set1(q * dt * dt / 2.0f);
+    const vf q11 = set1(q * dt);
+    const vf two = set1(2.0f);
+    const vf one = set1(1.0f);
+    const vf r0 = set1(m_config.measurement_noise);
+    const vf min_score = set1(m_config.min_keypoint_score);
+
+    for (size_t j = 0; j < LANES; j += WIDTH) {
+        const vf score = load(scores + j);
+        const vmask valid = greater_equal(score, min_score);
+        // Invalid lanes divide by 1 and are discarded by the select
+        const vf r = div(r0, select(valid, score, one));
+        for (size_t row = 0; row < 2; row++) {
+            // Predict
+            vf pos = load(state.value[row] + j);
+            vf vel = load(state.speed[row] + j);
+            vf p00 = load(state.p00[row] + j);
+            vf p01 = load(state.p01[row] + j);
+            vf p11 = load(state.p11[row] + j);
+            pos = add(pos, mul(vel, vdt));
+            p00 = add(add(p00, mul(vdt, add(mul(two, p01), mul(vdt, p11)))), q00);
+            p01 = add(add(p01, mul(vdt, p11)), q01);
+            p11 = add(p11, q11);
+
+            // Correct
+            const vf s = add(p00, r);
+            const vf k0 = div(p00, s);
+            const vf k1 = div(p01, s);
+            const vf y = sub(load(measured[row] + j), pos);
+            const vf c_pos = add(pos, mul(k0, y));
+            const vf c_vel = add(vel, mul(k1, y));
+            const vf c_p00 = mul(sub(one, k0), p00);
+            const vf c_p01 = mul(sub(one, k0), p01);
+            const vf c_p11 = sub(p11, mul(k1, p01));
+
+            store(state.value[row] + j, select(valid, c_pos, pos));
+            store(state.speed[row] + j, select(valid, c_vel, vel));
+            store(state.p00[row] + j, select(valid, c_p00, p00));
+            store(state.p01[row] + j, select(valid, c_p01, p01));
+            store(state.p11[row] + j, select(valid, c_p11, p11));
+        }
+    }
+}
+
+bool PoseSmoother::predict(uint32_t id, std::chrono::steady_clock::time_point target, std::array<KeyPt, JOINTS> &keypoints) const
+{
+    const TrackState *state = find(id);
+    if (nullptr == state)
+        return false;
+
+    // Both filters keep the speed in units per second
+    const float max_lead = std::chrono::duration<float>(m_config.max_prediction).count();
+    const float lead = std::clamp(std::chrono::duration<float>(target - state->time).count(), 0.0f, max_lead);
+    alignas(32) float predicted[2][LANES];
+    const vf vlead = set1(lead);
+    for (size_t row = 0; row < 2; row++) {
+        for (size_t j = 0; j < LANES; j += WIDTH)
+            store(predicted[row] + j, add(load(state->value[row] + j), mul(load(state->speed[row] + j), vlead)));
+    }
+    for (size_t j = 0; j < JOINTS; j++) {
+        keypoints[j].xs = predicted[0][j];
+        keypoints[j].ys = predicted[1][j];
+    }
+    return true;
+}
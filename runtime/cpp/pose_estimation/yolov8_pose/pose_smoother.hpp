@@ -0,0 +1,103 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file pose_smoother.hpp
+ * @brief Per-track temporal keypoint smoothing (One-Euro or constant-velocity Kalman) with forward prediction
+ **/
+
+#ifndef _HAILO_POSE_SMOOTHER_HPP_
+#define _HAILO_POSE_SMOOTHER_HPP_
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+
+#include "pose_keypoints.hpp"
+
+enum class SmoothingFilter {
+    NONE,
+    ONE_EURO,       // Adaptive low-pass: smooth when still, little lag when moving
+    KALMAN,         // Constant velocity, measurement noise scaled by the keypoint score
+};
+
+/**
+ * @brief Smoothing parameters. Positions are normalized to the network input, times are seconds.
+ */
+struct PoseSmootherConfig {
+    SmoothingFilter filter = SmoothingFilter::ONE_EURO;
+    float min_keypoint_score = 0.3f;    // Keypoints below it do not update the filter and keep their estimate
+
+    // One-Euro
+    float min_cutoff = 1.0f;            // Hz, cutoff at rest
+    float beta = 50.0f;                 // Cutoff increase per unit/s of speed; a walking person moves ~0.1/s
+    float derivative_cutoff = 1.0f;     // Hz, low-pass on the speed estimate
+
+    // Kalman
+    float acceleration_noise = 1.0f;
+    float measurement_noise = 1e-5f;    // Position variance of a keypoint with score 1
+    float initial_velocity_var = 1.0f;
+
+    // Predictions further ahead are clamped
+    std::chrono::milliseconds max_prediction{200};
+};
+
+/**
+ * @brief Filter bank with one state per track and per joint. Each track's state is
+ *        structure-of-arrays (x and y rows of every quantity, padded to the SIMD width), so all 17
+ *        joints update together with AVX2, NEON or a scalar fallback. Tracks are keyed by tracker
+ *        id; when the bank is full the least recently updated track is replaced. No allocation.
+ */
+class PoseSmoother {
+public:
+    static constexpr size_t MAX_TRACKS = 32;
+    static constexpr size_t JOINTS = 17;
+    static constexpr size_t LANES = 24;     // JOINTS padded to a multiple of 8
+
+    explicit PoseSmoother(const PoseSmootherConfig &config = PoseSmootherConfig());
+
+    const PoseSmootherConfig &config() const { return m_config; }
+
+    // Filters the keypoints of track `id` measured at `time`, in place. Scores are left as measured.
+    void smooth(uint32_t id, std::chrono::steady_clock::time_point time, std::array<KeyPt, JOINTS> &keypoints);
+
+    // Extrapolates the filtered keypoints of track `id` to `target` (e.g. the actuation time).
+    // False, and keypoints untouched, if the track is unknown.
+    bool predict(uint32_t id, std::chrono::steady_clock::time_point target, std::array<KeyPt, JOINTS> &keypoints) const;
+
+    void reset();
+
+private:
+    struct alignas(32) TrackState {
+        // Row 0 is x, row 1 is y. One-Euro keeps the estimate and its filtered speed in
+        // value/speed; Kalman keeps position/velocity there plus the covariance.
+        alignas(32) float value[2][LANES];
+        alignas(32) float speed[2][LANES];
+        alignas(32) float p00[2][LANES];
+        alignas(32) float p01[2][LANES];
+        alignas(32) float p11[2][LANES];
+        std::chrono::steady_clock::time_point time;
+        uint32_t id = 0;
+        bool used = false;
+    };
+
+    TrackState &find_or_open(uint32_t id, bool &opened);
+    const TrackState *find(uint32_t id) const;
+    void init(TrackState &state, const float measured[2][LANES]);
+    void update_one_euro(TrackState &state, const float measured[2][LANES], const float *scores, float dt);
+    void update_kalman(TrackState &state, const float measured[2][LANES], const float *scores, float dt);
+
+    PoseSmootherConfig m_config;
+    std::array<TrackState, MAX_TRACKS> m_states;
+};
+
+#endif /* _HAILO_POSE_SMOOTHER_HPP_ */
@@ -0,0 +1,353 @@
+#include "pose_tracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// COCO keypoint sigmas; OKS uses kappa = 2 * sigma
+static constexpr std::array<float, PoseTrack::KEYPOINTS> COCO_SIGMAS = {
+    0.026f, 0.025f, 0.025f, 0.035f, 0.035f, 0.079f, 0.079f, 0.072f, 0.072f,
+    0.062f, 0.062f, 0.107f, 0.107f, 0.087f, 0.087f, 0.089f, 0.089f
+};
+
+static float box_iou(float axmin, float aymin, float axmax, float aymax,
+                     float bxmin, float bymin, float bxmax, float bymax)
+{
+    const float iw = std::min(axmax, bxmax) - std::max(axmin, bxmin);
+    const float ih = std::min(aymax, bymax) - std::max(aymin, bymin);
+    if (iw <= 0.0f || ih <= 0.0f)
+        return 0.0f;
+    const float intersection = iw * ih;
+    const float area_a = (axmax - axmin) * (aymax - aymin);
+    const float area_b = (bxmax - bxmin) * (bymax - bymin);
+    return intersection / (area_a + area_b - intersection);
+}
+
+PoseTracker::PoseTracker(const PoseTrackerConfig &config) :
+    m_config(config)
+{}
+
+void PoseTracker::reset()
+{
+    m_track_count = 0;
+    m_primary_id = 0;
+    m_has_time = false;
+    m_detection_count = 0;
+}
+
+const PoseTrack *PoseTracker::primary() const
+{
+    for (size_t t = 0; t < m_track_count; t++) {
+        if (m_tracks[t].id == m_primary_id)
+            return &m_tracks[t];
+    }
+    return nullptr;
+}
+
+bool PoseTracker::set_primary(uint32_t id)
+{
+    for (size_t t = 0; t < m_track_count; t++) {
+        if (m_tracks[t].id == id && TrackState::CONFIRMED == m_tracks[t].state) {
+            m_primary_id = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+//-------------------------------
+// KALMAN FILTER
+//-------------------------------
+
+void PoseTracker::predict(PoseTrack &track, float dt) const
+{
+    // Constant velocity with white-noise acceleration, one independent filter per coordinate
+    const float q = m_config.acceleration_noise;
+    const float q00 = q * dt * dt * dt / 3.0f;
+    const float q01 = q * dt * dt / 2.0f;
+    const float q11 = q * dt;
+    for (size_t c = 0; c < PoseTrack::COORDS; c++) {
+        track.pos[c] += track.vel[c] * dt;
+        track.p00[c] += dt * (2.0f * track.p01[c] + dt * track.p11[c]) + q00;
+        track.p01[c] += dt * track.p11[c] + q01;
+        track.p11[c] += q11;
+    }
+}
+
+void PoseTracker::correct(PoseTrack &track, const PersonKeypoints &person) const
+{
+    // Box edges are measured with the person's score, keypoints with their own. Low-score
+    // keypoints are skipped (R infinite) and keep coasting.
+    std::array<float, PoseTrack::COORDS> z;
+    std::array<float, PoseTrack::COORDS> r;
+    const float box_r = m_config.measurement_noise / std::max(person.score, 0.05f);
+    z[0] = person.xmin; z[1] = person.ymin; z[2] = person.xmax; z[3] = person.ymax;
+    r[0] = r[1] = r[2] = r[3] = box_r;
+    for (size_t k = 0; k < PoseTrack::KEYPOINTS; k++) {
+        const float score = person.keypoints[k].joints_scores;
+        const float kr = (score >= m_config.min_keypoint_score) ? m_config.measurement_noise / score
+                                                                 : std::numeric_limits<float>::infinity();
+        z[4 + 2 * k] = person.keypoints[k].xs;
+        z[5 + 2 * k] = person.keypoints[k].ys;
+        r[4 + 2 * k] = r[5 + 2 * k] = kr;
+        track.keypoint_score[k] = score;
+    }
+
+    for (size_t c = 0; c < PoseTrack::COORDS; c++) {
+        const float s = track.p00[c] + r[c];
+        const float k0 = track.p00[c] / s;      // 0 when r is infinite
+        const float k1 = track.p01[c] / s;
+        const float y = z[c] - track.pos[c];
+        track.pos[c] += k0 * y;
+        track.vel[c] += k1 * y;
+        const float p00 = track.p00[c];
+        const float p01 = track.p01[c];
+        track.p00[c] = (1.0f - k0) * p00;
+        track.p01[c] = (1.0f - k0) * p01;
+        track.p11[c] -= k1 * p01;
+    }
+}
+
+void PoseTracker::open_track(const PersonKeypoints &person, int index)
+{
+    if (m_track_count == MAX_TRACKS)
+        return;
+    PoseTrack &track = m_tracks[m_track_count++];
+    track.id = m_next_id++;
+    track.state = (m_config.min_hits <= 1) ? TrackState::CONFIRMED : TrackState::TENTATIVE;
+    track.hits = 1;
+    track.missed = 0;
+    track.age = 1;
+    track.detection = index;
+    track.score = person.score;
+
+    track.pos[0] = person.xmin; track.pos[1] = person.ymin; track.pos[2] = person.xmax; track.pos[3] = person.ymax;
+    for (size_t k = 0; k < PoseTrack::KEYPOINTS; k++) {
+        track.pos[4 + 2 * k] = person.keypoints[k].xs;
+        track.pos[5 + 2 * k] = person.keypoints[k].ys;
+        track.keypoint_score[k] = person.keypoints[k].joints_scores;
+    }
+    const float r = m_config.measurement_noise / std::max(person.score, 0.05f);
+    track.vel.fill(0.0f);
+    track.p00.fill(r);
+    track.p01.fill(0.0f);
+    track.p11.fill(m_config.initial_velocity_var);
+}
+
+//-------------------------------
+// ASSOCIATION
+//-------------------------------
+
+float PoseTracker::similarity(const PoseTrack &track, const PersonKeypoints &person) const
+{
+    const float iou = box_iou(track.xmin(), track.ymin(), track.xmax(), track.ymax(),
+                              person.xmin, person.ymin, person.xmax, person.ymax);
+
+    // OKS over the keypoints visible in both, scaled by the person's box area
+    const float area = std::max((person.xmax - person.xmin) * (person.ymax - person.ymin), 1e-6f);
+    float oks = 0.0f;
+    int visible = 0;
+    for (size_t k = 0; k < PoseTrack::KEYPOINTS; k++) {
+        if (person.keypoints[k].joints_scores < m_config.min_keypoint_score ||
+            track.keypoint_score[k] < m_config.min_keypoint_score)
+            continue;
+        const float dx = person.keypoints[k].xs - track.keypoint_x(k);
+        const float dy = person.keypoints[k].ys - track.keypoint_y(k);
+        const float kappa = 2.0f * COCO_SIGMAS[k];
+        oks += std::exp(-(dx * dx + dy * dy) / (2.0f * area * kappa * kappa));
+        visible++;
+    }
+    if (0 == visible)
+        return iou;
+    oks /= float(visible);
+    return m_config.oks_weight * oks + (1.0f - m_config.oks_weight) * iou;
+}
+
+void PoseTracker::assign_greedy(size_t tracks, size_t detections)
+{
+    struct Pair {
+        float similarity;
+        uint8_t track;
+        uint8_t detection;
+    };
+    std::array<Pair, MAX_TRACKS * MAX_DETECTIONS> pairs;
+    size_t count = 0;
+    for (size_t t = 0; t < tracks; t++) {
+        for (size_t d = 0; d < detections; d++) {
+            if (m_similarity[t][d] >= m_config.min_similarity)
+                pairs[count++] = Pair{m_similarity[t][d], uint8_t(t), uint8_t(d)};
+        }
+    }
+    std::sort(pairs.begin(), pairs.begin() + count,
+              [](const Pair &a, const Pair &b) { return a.similarity > b.similarity; });
+    for (size_t i = 0; i < count; i++) {
+        const Pair &pair = pairs[i];
+        if (m_track_match[pair.track] < 0 && m_detection_match[pair.detection] < 0) {
+            m_track_match[pair.track] = pair.detection;
+            m_detection_match[pair.detection] = pair.track;
+        }
+    }
+}
+
+void PoseTracker::assign_hungarian(size_t tracks, size_t detections)
+{
+    // Shortest augmenting path on a square cost matrix padded with dummy rows or columns. Pairs
+    // under the gate cost as much as a dummy, so they are only picked where nothing better exists
+    // and are dropped below.
+    constexpr size_t N_MAX = std::max(MAX_TRACKS, MAX_DETECTIONS);
+    const size_t n = std::max(tracks, detections);
+    auto cost = [&](size_t i, size_t j) {       // 1-based
+        if (i > tracks || j > detections)
+            return 1.0f;
+        const float s = m_similarity[i - 1][j - 1];
+        return (s >= m_config.min_similarity) ? 1.0f - s : 1.0f;
+    };
+
+    std::array<float, N_MAX + 1> u{}, v{}, minv;
+    std::array<size_t, N_MAX + 1> p{}, way{};
+    std::array<bool, N_MAX + 1> used;
+    for (size_t i = 1; i <= n; i++) {
+        p[0] = i;
+        size_t j0 = 0;
+        minv.fill(std::numeric_limits<float>::infinity());
+        used.fill(false);
+        do {
+            used[j0] = true;
+            const size_t i0 = p[j0];
+            float delta = std::numeric_limits<float>::infinity();
+            size_t j1 = 0;
+            for (size_t j = 1; j <= n; j++) {
+                if (used[j])
+                    continue;
+                const float cur = cost(i0, j) - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (size_t j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                }
+                else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            const size_t j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (size_t j = 1; j <= detections; j++) {
+        const size_t i = p[j];
+        if (i == 0 || i > tracks || m_similarity[i - 1][j - 1] < m_config.min_similarity)
+            continue;
+        m_track_match[i - 1] = int(j - 1);
+        m_detection_match[j - 1] = int(i - 1);
+    }
+}
+
+//-------------------------------
+// UPDATE
+//-------------------------------
+
+void PoseTracker::update(std::span<const PersonKeypoints> persons, std::chrono::steady_clock::time_point time)
+{
+    float dt = 0.0f;
+    if (m_has_time)
+        dt = std::max(std::chrono::duration<float>(time - m_last_time).count(), 0.0f);
+    m_last_time = time;
+    m_has_time = true;
+
+    const size_t detections = std::min(persons.size(), MAX_DETECTIONS);
+    const size_t tracks = m_track_count;
+    for (size_t t = 0; t < tracks; t++) {
+        predict(m_tracks[t], dt);
+        for (size_t d = 0; d < detections; d++)
+            m_similarity[t][d] = similarity(m_tracks[t], persons[d]);
+    }
+    std::fill(m_track_match.begin(), m_track_match.end(), -1);
+    std::fill(m_detection_match.begin(), m_detection_match.end(), -1);
+    if (tracks > 0 && detections > 0) {
+        if (TrackAssignment::HUNGARIAN == m_config.assignment)
+            assign_hungarian(tracks, detections);
+        else
+            assign_greedy(tracks, detections);
+    }
+
+    for (size_t t = 0; t < tracks; t++) {
+        PoseTrack &track = m_tracks[t];
+        track.age++;
+        if (m_track_match[t] >= 0) {
+            const int d = m_track_match[t];
+            correct(track, persons[d]);
+            track.detection = d;
+            track.score = persons[d].score;
+            track.hits++;
+            track.missed = 0;
+            if (track.hits >= m_config.min_hits)
+                track.state = TrackState::CONFIRMED;
+        }
+        else {
+            track.detection = -1;
+            track.hits = 0;
+            track.missed++;
+        }
+    }
+
+    // Drop tentative tracks on their first miss and confirmed ones after max_missed; order is not kept
+    for (size_t t = 0; t < m_track_count;) {
+        const PoseTrack &track = m_tracks[t];
+        const bool dead = (track.missed > 0 && TrackState::TENTATIVE == track.state) ||
+                          track.missed > m_config.max_missed;
+        if (dead) {
+            if (track.id == m_primary_id)
+                m_primary_id = 0;
+            m_tracks[t] = m_tracks[--m_track_count];
+        }
+        else {
+            t++;
+        }
+    }
+
+    for (size_t d = 0; d < detections; d++) {
+        if (m_detection_match[d] < 0)
+            open_track(persons[d], int(d));
+    }
+
+    m_detection_count = detections;
+    std::fill(m_detection_ids.begin(), m_detection_ids.end(), 0);
+    for (size_t t = 0; t < m_track_count; t++) {
+        const PoseTrack &track = m_tracks[t];
+        if (track.detection >= 0 && TrackState::CONFIRMED == track.state)
+            m_detection_ids[track.detection] = track.id;
+    }
+
+    select_primary();
+}
+
+void PoseTracker::select_primary()
+{
+    if (0 != m_primary_id)
+        return;
+    float best_area = 0.0f;
+    for (size_t t = 0; t < m_track_count; t++) {
+        const PoseTrack &track = m_tracks[t];
+        if (TrackState::CONFIRMED != track.state || track.missed > 0)
+            continue;
+        const float area = (track.xmax() - track.xmin()) * (track.ymax() - track.ymin());
+        if (area > best_area) {
+            best_area = area;
+            m_primary_id = track.id;
+        }
+    }
+}
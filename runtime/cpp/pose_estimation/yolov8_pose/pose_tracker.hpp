@@ -0,0 +1,142 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file pose_tracker.hpp
+ * @brief Multi-person pose tracker with keypoint-aware association and stable track ids
+ **/
+
+#ifndef _HAILO_POSE_TRACKER_HPP_
+#define _HAILO_POSE_TRACKER_HPP_
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+#include <span>
+
+#include "pose_keypoints.hpp"
+
+enum class TrackAssignment {
+    GREEDY,         // Best remaining pair first; cheaper, can be suboptimal in crowds
+    HUNGARIAN,      // Minimum total cost
+};
+
+enum class TrackState {
+    TENTATIVE,      // Not yet matched min_hits frames in a row
+    CONFIRMED,
+};
+
+/**
+ * @brief Tracker parameters. Positions are normalized to the network input, times are seconds.
+ */
+struct PoseTrackerConfig {
+    TrackAssignment assignment = TrackAssignment::HUNGARIAN;
+    float oks_weight = 0.7f;            // Similarity = oks_weight * OKS + (1 - oks_weight) * IoU
+    float min_similarity = 0.2f;        // Pairs below it are never matched
+    float min_keypoint_score = 0.3f;    // Keypoints below it neither count in OKS nor update the filter
+    uint32_t min_hits = 3;              // Matches in a row before a track is confirmed
+    uint32_t max_missed = 10;           // Frames a confirmed track coasts on its prediction before it is dropped
+    float acceleration_noise = 1.0f;    // Constant-velocity process noise, (1/s^2)^2 * s
+    float measurement_noise = 1e-5f;    // Position variance of a keypoint with score 1
+    float initial_velocity_var = 1.0f;  // Velocity variance of a new track, (1/s)^2
+};
+
+/**
+ * One tracked person. Every box edge and keypoint coordinate has its own constant-velocity Kalman
+ * filter (position, velocity and their 2x2 covariance), stored as structure-of-arrays.
+ */
+struct PoseTrack {
+    static constexpr size_t KEYPOINTS = 17;
+    static constexpr size_t COORDS = 4 + 2 * KEYPOINTS;   // xmin, ymin, xmax, ymax, then x, y of each keypoint
+
+    uint32_t id = 0;
+    TrackState state = TrackState::TENTATIVE;
+    uint32_t hits = 0;          // Consecutive matches
+    uint32_t missed = 0;        // Consecutive frames without a match
+    uint32_t age = 0;           // Frames since the track was opened
+    int detection = -1;         // Index of the person matched in the last update, -1 while coasting
+    float score = 0.0f;         // Detection score of the last match
+
+    std::array<float, COORDS> pos;
+    std::array<float, COORDS> vel;
+    std::array<float, COORDS> p00, p01, p11;
+    std::array<float, KEYPOINTS> keypoint_score;    // Last measured score of every keypoint
+
+    float xmin() const { return pos[0]; }
+    float ymin() const { return pos[1]; }
+    float xmax() const { return pos[2]; }
+    float ymax() const { return pos[3]; }
+    float keypoint_x(size_t k) const { return pos[4 + 2 * k]; }
+    float keypoint_y(size_t k) const { return pos[5 + 2 * k]; }
+};
+
+/**
+ * @brief Associates each frame's persons with existing tracks and keeps a primary target.
+ *
+ *        Tracks are predicted to the frame time, scored against every person with OKS (COCO
+ *        keypoint sigmas) blended with box IoU, then assigned greedily or with the Hungarian
+ *        method. Matched tracks are corrected, unmatched persons open tentative tracks, and tracks
+ *        that stop matching coast on their prediction until max_missed. All state lives in fixed
+ *        arrays: update() never allocates.
+ *
+ *        The primary target is sticky: it only changes when its track is dropped (or set_primary
+ *        is called). A new one is the confirmed, currently matched track with the largest box.
+ */
+class PoseTracker {
+public:
+    static constexpr size_t MAX_TRACKS = 32;
+    static constexpr size_t MAX_DETECTIONS = 32;
+
+    explicit PoseTracker(const PoseTrackerConfig &config = PoseTrackerConfig());
+
+    // Persons beyond MAX_DETECTIONS (lowest scores, as the postprocess sorts them) are not tracked
+    void update(std::span<const PersonKeypoints> persons, std::chrono::steady_clock::time_point time);
+
+    std::span<const PoseTrack> tracks() const { return std::span<const PoseTrack>(m_tracks.data(), m_track_count); }
+
+    // Id of the confirmed track person `index` of the last update was matched to, 0 if none
+    uint32_t track_id(size_t index) const { return index < m_detection_count ? m_detection_ids[index] : 0; }
+
+    uint32_t primary_id() const { return m_primary_id; }
+    const PoseTrack *primary() const;
+
+    // Locks the primary target onto a confirmed track; false if there is no such track
+    bool set_primary(uint32_t id);
+
+    void reset();
+
+private:
+    void predict(PoseTrack &track, float dt) const;
+    void correct(PoseTrack &track, const PersonKeypoints &person) const;
+    void open_track(const PersonKeypoints &person, int index);
+    float similarity(const PoseTrack &track, const PersonKeypoints &person) const;
+    void assign_greedy(size_t tracks, size_t detections);
+    void assign_hungarian(size_t tracks, size_t detections);
+    void select_primary();
+
+    PoseTrackerConfig m_config;
+    std::array<PoseTrack, MAX_TRACKS> m_tracks;
+    size_t m_track_count = 0;
+    uint32_t m_next_id = 1;
+    uint32_t m_primary_id = 0;
+    bool m_has_time = false;
+    std::chrono::steady_clock::time_point m_last_time;
+
+    // Per-update scratch
+    std::array<std::array<float, MAX_DETECTIONS>, MAX_TRACKS> m_similarity;
+    std::array<int, MAX_TRACKS> m_track_match;
+    std::array<int, MAX_DETECTIONS> m_detection_match;
+    std::array<uint32_t, MAX_DETECTIONS> m_detection_ids;
+    size_t m_detection_count = 0;
+};
+
+#endif /* _HAILO_POSE_TRACKER_HPP_ */
@@ -0,0 +1,157 @@
+#include "render_sink.hpp"
+
+#include <iostream>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+RenderSink::RenderSink(const RenderConfig &config, cv::Size frame_size, StageMetrics *metrics) :
+    m_config(config), m_frame_size(frame_size), m_metrics(metrics),
+    m_draw_queue(config.draw.queue_size, config.draw.mode),
+    m_display_queue(config.display.queue_size, config.display.mode),
+    m_video_queue(config.video.queue_size, config.video.mode),
+    m_snapshot_queue(config.snapshot.queue_size, config.snapshot.mode)
+{
+    if (!m_config.enabled())
+        return;
+
+    // HighGUI calls all stay on the display thread
+    if (m_config.display.enabled)
+        m_output_threads.emplace_back(&RenderSink::display_loop, this);
+    if (m_config.video.enabled)
+        m_output_threads.emplace_back(&RenderSink::video_loop, this);
+    if (m_config.snapshot.enabled)
+        m_output_threads.emplace_back(&RenderSink::snapshot_loop, this);
+    m_draw_thread = std::thread(&RenderSink::draw_loop, this);
+}
+
+RenderSink::~RenderSink()
+{
+    close();
+}
+
+void RenderSink::submit(RenderFrame &&frame)
+{
+    if (m_config.enabled())
+        m_draw_queue.push(std::move(frame));
+}
+
+void RenderSink::close()
+{
+    if (m_closed)
+        return;
+    m_closed = true;
+
+    // The draw thread closes the output queues once it drained its own
+    m_draw_queue.close();
+    if (m_draw_thread.joinable())
+        m_draw_thread.join();
+    for (auto &thread : m_output_threads)
+        thread.join();
+    m_output_threads.clear();
+}
+
+RenderSink::Stats RenderSink::get_stats()
+{
+    return Stats{m_draw_queue.dropped(), m_display_queue.dropped(), m_video_queue.dropped(),
+                 m_snapshot_queue.dropped()};
+}
+
+void RenderSink::draw_loop()
+{
+    const float width = float(m_frame_size.width);
+    const float height = float(m_frame_size.height);
+
+    RenderFrame frame;
+    while (m_draw_queue.pop(frame)) {
+        const auto draw_start = std::chrono::steady_clock::now();
+        cv::Mat canvas = frame.image;
+        if (canvas.size() != m_frame_size)
+            cv::resize(frame.image, canvas, m_frame_size, 1);
+
+        if (frame.roi != cv::Rect2f(0.0f, 0.0f, 1.0f, 1.0f)) {
+            cv::rectangle(canvas, cv::Point2f(frame.roi.x * width, frame.roi.y * height),
+                          cv::Point2f((frame.roi.x + frame.roi.width) * width, (frame.roi.y + frame.roi.height) * height),
+                          cv::Scalar(0, 255, 255), 1);
+        }
+
+        for (size_t i = 0; i < frame.detections.size(); i++) {
+            auto &detection = frame.detections[i];
+            if (detection->get_confidence() == 0) {
+                continue;
+            }
+            HailoBBox bbox = detection->get_bbox();
+            const uint32_t id = (i < frame.track_ids.size()) ? frame.track_ids[i] : 0;
+            const bool primary = (0 != id && id == frame.primary_id);
+            cv::rectangle(canvas,
+                          cv::Point2f(bbox.xmin() * width, bbox.ymin() * height),
+                          cv::Point2f(bbox.xmax() * width, bbox.ymax() * height),
+                          primary ? cv::Scalar(0, 255, 0) : cv::Scalar(0, 0, 255), primary ? 2 : 1);
+            if (0 != id) {
+                cv::putText(canvas, std::to_string(id), cv::Point2f(bbox.xmin() * width, bbox.ymin() * height - 4),
+                            cv::FONT_HERSHEY_SIMPLEX, 0.5, primary ? cv::Scalar(0, 255, 0) : cv::Scalar(0, 0, 255), 1);
+            }
+        }
+
+        for (auto &keypoint : frame.keypoints) {
+            cv::circle(canvas, cv::Point(keypoint.xs * width, keypoint.ys * height),
+                       3, cv::Scalar(255, 0, 255), -1);
+        }
+
+        for (PairPairs &p : frame.pairs) {
+            auto pt1 = cv::Point(p.pt1.first * width, p.pt1.second * height);
+            auto pt2 = cv::Point(p.pt2.first * width, p.pt2.second * height);
+            cv::line(canvas, pt1, pt2, cv::Scalar(255, 0, 255), 3);
+        }
+
+        if (m_metrics)
+            m_metrics->record(Stage::RENDER, draw_start, std::chrono::steady_clock::now());
+
+        // cv::Mat copies share the pixels; no output writes to them
+        if (m_config.display.enabled)
+            m_display_queue.push(cv::Mat(canvas));
+        if (m_config.video.enabled)
+            m_video_queue.push(cv::Mat(canvas));
+        if (m_config.snapshot.enabled)
+            m_snapshot_queue.push(std::move(canvas));
+        frame = RenderFrame();
+    }
+
+    m_display_queue.close();
+    m_video_queue.close();
+    m_snapshot_queue.close();
+}
+
+void RenderSink::display_loop()
+{
+    cv::Mat frame;
+    while (m_display_queue.pop(frame)) {
+        cv::imshow("Display window", frame);
+        cv::waitKey(1);
+    }
+    cv::destroyAllWindows();
+}
+
+void RenderSink::video_loop()
+{
+    cv::VideoWriter video(m_config.video_path, cv::VideoWriter::fourcc('m','p','4','v'), m_config.video_fps,
+                          m_frame_size);
+    if (!video.isOpened()) {
+        std::cerr << "Failed to open video writer " << m_config.video_path << std::endl;
+    }
+    cv::Mat frame;
+    while (m_video_queue.pop(frame)) {
+        if (video.isOpened())
+            video.write(frame);
+    }
+    video.release();
+}
+
+void RenderSink::snapshot_loop()
+{
+    cv::Mat frame;
+    while (m_snapshot_queue.pop(frame)) {
+        cv::imwrite(m_config.snapshot_path, frame);
+    }
+}
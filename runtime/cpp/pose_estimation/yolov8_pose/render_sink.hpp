@@ -0,0 +1,125 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file render_sink.hpp
+ * @brief Asynchronous drawing, display, video encoding and snapshot writing of pose results
+ **/
+
+#ifndef _HAILO_RENDER_SINK_HPP_
+#define _HAILO_RENDER_SINK_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "common/hailo_objects.hpp"
+#include "yolov8pose_postprocess.hpp"
+#include "bounded_queue.hpp"
+#include "stage_metrics.hpp"
+
+/**
+ * One render output: whether it runs, how many frames may wait for it and what happens when it
+ * falls behind.
+ */
+struct RenderOutput {
+    bool enabled = true;
+    uint32_t queue_size = 1;
+    BackpressureMode mode = BackpressureMode::DROP_OLDEST;
+};
+
+/**
+ * Defaults favour the control loop: the preview and the snapshot only ever show the newest frame,
+ * the video keeps a short backlog and drops new frames once it is full.
+ */
+struct RenderConfig {
+    RenderOutput draw{true, 2, BackpressureMode::DROP_OLDEST};      // Hand-off from postprocess
+    RenderOutput display{true, 1, BackpressureMode::DROP_OLDEST};
+    RenderOutput video{true, 16, BackpressureMode::DROP_NEWEST};
+    RenderOutput snapshot{true, 1, BackpressureMode::DROP_OLDEST};
+    std::string video_path = "./processed_video.mp4";
+    std::string snapshot_path = "output_image.jpg";
+    double video_fps = 30.0;
+
+    // Headless: nothing is drawn and postprocess does not even copy the image
+    bool enabled() const { return display.enabled || video.enabled || snapshot.enabled; }
+};
+
+/**
+ * Pose results of one frame with a private copy of its image, so the frame slot can be recycled
+ * before anything is drawn.
+ */
+struct RenderFrame {
+    cv::Mat image;
+    std::vector<HailoDetectionPtr> detections;
+    std::vector<uint32_t> track_ids;        // Per detection, 0 if not tracked yet
+    uint32_t primary_id = 0;
+    cv::Rect2f roi{0.0f, 0.0f, 1.0f, 1.0f};     // Region the network saw, outlined unless it is the full frame
+    std::vector<KeyPt> keypoints;
+    std::vector<PairPairs> pairs;
+};
+
+/**
+ * @brief Takes rendering off the postprocess thread. A draw thread overlays the results and fans
+ *        the drawn frame out to one thread per enabled output (display, video, snapshot), each
+ *        behind its own bounded queue, so a slow encoder or window never delays the next result.
+ *        The drawn frame is shared read-only between the outputs.
+ */
+class RenderSink {
+public:
+    // Drawing time is recorded as Stage::RENDER in `metrics`, if given; it must outlive the sink
+    RenderSink(const RenderConfig &config, cv::Size frame_size, StageMetrics *metrics = nullptr);
+    ~RenderSink();
+
+    RenderSink(const RenderSink &) = delete;
+    RenderSink &operator=(const RenderSink &) = delete;
+
+    bool enabled() const { return m_config.enabled(); }
+
+    // Blocks only if the draw queue is configured to BLOCK
+    void submit(RenderFrame &&frame);
+
+    // Renders what is still queued, then stops every thread. Called by the destructor.
+    void close();
+
+    struct Stats {
+        uint64_t draw_dropped;
+        uint64_t display_dropped;
+        uint64_t video_dropped;
+        uint64_t snapshot_dropped;
+    };
+    Stats get_stats();
+
+private:
+    void draw_loop();
+    void display_loop();
+    void video_loop();
+    void snapshot_loop();
+
+    const RenderConfig m_config;
+    const cv::Size m_frame_size;
+    StageMetrics *m_metrics;
+
+    BoundedQueue<RenderFrame> m_draw_queue;
+    BoundedQueue<cv::Mat> m_display_queue;
+    BoundedQueue<cv::Mat> m_video_queue;
+    BoundedQueue<cv::Mat> m_snapshot_queue;
+
+    std::thread m_draw_thread;
+    std::vector<std::thread> m_output_threads;
+    bool m_closed = false;
+};
+
+#endif /* _HAILO_RENDER_SINK_HPP_ */
@@ -0,0 +1,129 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file roi_scheduler.hpp
+ * @brief Picks the region of each frame the network sees: a crop around the tracked subject or the full frame
+ **/
+
+#ifndef _HAILO_ROI_SCHEDULER_HPP_
+#define _HAILO_ROI_SCHEDULER_HPP_
+
+#include <stdint.h>
+#include <algorithm>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+
+/**
+ * @brief ROI mode parameters. Sizes are relative to the frame.
+ */
+struct RoiConfig {
+    bool enabled = false;
+    float padding = 1.6f;               // Crop side = padding * the subject's longer box side
+    float min_size = 0.25f;             // Smallest crop height, so a tiny subject is not blown up to noise
+    uint32_t full_scan_interval = 15;   // Every Nth frame scans the full frame to pick up new people
+};
+
+/**
+ * @brief Shared by the writer, which asks for the region of the next frame, and postprocess, which
+ *        reports where the subject was. Regions are normalized to the frame.
+ *
+ *        While a subject is reported, frames are cropped around it with the network's aspect ratio,
+ *        so the subject gets the network's full resolution undistorted. Every full_scan_interval-th
+ *        frame, and every frame after the subject was lost, is a full-frame scan. Results arrive a
+ *        few frames after the region was chosen, which the padding absorbs.
+ */
+class RoiScheduler {
+public:
+    RoiScheduler(const RoiConfig &config, cv::Size frame_size, cv::Size network_size) :
+        m_config(config), m_frame_size(frame_size), m_network_size(network_size)
+    {}
+
+    static cv::Rect2f full_frame() { return cv::Rect2f(0.0f, 0.0f, 1.0f, 1.0f); }
+    static bool is_full_frame(const cv::Rect2f &roi) { return roi == full_frame(); }
+
+    // Writer: region the next submitted frame should show
+    cv::Rect2f next_roi()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint64_t frame = m_frames++;
+        if (!m_config.enabled || !m_has_target ||
+            (m_config.full_scan_interval > 0 && 0 == frame % m_config.full_scan_interval)) {
+            m_full_scans++;
+            return full_frame();
+        }
+        return crop_around(m_target);
+    }
+
+    // Postprocess: the subject's box in the frame (normalized) ...
+    void report_target(const cv::Rect2f &bbox)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_target = bbox;
+        m_has_target = true;
+    }
+
+    // ... or that there is none, so the next frames scan the full frame
+    void report_lost()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_has_target = false;
+    }
+
+    bool enabled() const { return m_config.enabled; }
+
+    uint64_t full_scans()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_full_scans;
+    }
+
+    uint64_t frames()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_frames;
+    }
+
+private:
+    cv::Rect2f crop_around(const cv::Rect2f &bbox) const
+    {
+        // Work in pixels so the crop has the network's aspect ratio
+        const float frame_w = float(m_frame_size.width);
+        const float frame_h = float(m_frame_size.height);
+        const float aspect = float(m_network_size.width) / float(m_network_size.height);
+        const float side = std::max(m_config.padding * std::max(bbox.width * frame_w, bbox.height * frame_h),
+                                    m_config.min_size * frame_h);
+        float h = side;
+        float w = side * aspect;
+        // Shrink, keeping the aspect ratio, to fit the frame
+        const float fit = std::min({1.0f, frame_w / w, frame_h / h});
+        w *= fit;
+        h *= fit;
+        const float cx = (bbox.x + bbox.width / 2.0f) * frame_w;
+        const float cy = (bbox.y + bbox.height / 2.0f) * frame_h;
+        const float x = std::clamp(cx - w / 2.0f, 0.0f, frame_w - w);
+        const float y = std::clamp(cy - h / 2.0f, 0.0f, frame_h - h);
+        return cv::Rect2f(x / frame_w, y / frame_h, w / frame_w, h / frame_h);
+    }
+
+    const RoiConfig m_config;
+    const cv::Size m_frame_size;
+    const cv::Size m_network_size;
+    std::mutex m_mutex;
+    cv::Rect2f m_target;
+    bool m_has_target = false;
+    uint64_t m_frames = 0;
+    uint64_t m_full_scans = 0;
+};
+
+#endif /* _HAILO_ROI_SCHEDULER_HPP_ */
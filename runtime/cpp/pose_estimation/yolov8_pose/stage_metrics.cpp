@@ -0,0 +1,196 @@
+#include "stage_metrics.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+static constexpr double QUANTILES[] = {50.0, 90.0, 99.0, 99.9};
+
+const char *stage_name(Stage stage)
+{
+    switch (stage) {
+    case Stage::CAPTURE:    return "capture";
+    case Stage::PREPROCESS: return "preprocess";
+    case Stage::WRITE:      return "write";
+    case Stage::DEVICE:     return "device";
+    case Stage::READ:       return "read";
+    case Stage::DECODE:     return "decode";
+    case Stage::NMS:        return "nms";
+    case Stage::KEYPOINTS:  return "keypoints";
+    case Stage::RENDER:     return "render";
+    case Stage::END_TO_END: return "end_to_end";
+    default:                return "unknown";
+    }
+}
+
+static uint64_t next_metrics_id()
+{
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+}
+
+StageMetrics::StageMetrics() : m_id(next_metrics_id()) {}
+
+StageMetrics::Shard *StageMetrics::add_shard()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shards.push_back(std::make_unique<Shard>());
+    return m_shards.back().get();
+}
+
+std::array<HdrHistogram::Snapshot, STAGE_COUNT> StageMetrics::snapshot() const
+{
+    std::array<HdrHistogram::Snapshot, STAGE_COUNT> snapshots;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &shard : m_shards) {
+        for (size_t i = 0; i < STAGE_COUNT; i++)
+            snapshots[i].merge(shard->histograms[i].snapshot());
+    }
+    return snapshots;
+}
+
+MetricsConfig MetricsConfig::from_prefix(const std::string &prefix)
+{
+    MetricsConfig config;
+    config.json_path = prefix + ".json";
+    config.csv_path = prefix + ".csv";
+    config.prometheus_path = prefix + ".prom";
+    return config;
+}
+
+// Written aside and renamed over the target, so a reader never sees a partial file
+static void replace_file(const std::string &path, const std::string &contents)
+{
+    const std::string temp_path = path + ".tmp";
+    std::FILE *file = std::fopen(temp_path.c_str(), "w");
+    if (nullptr == file)
+        return;
+    const bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    if (0 == std::fclose(file) && written)
+        std::rename(temp_path.c_str(), path.c_str());
+}
+
+static void append_stats_json(std::string &out, const HdrHistogram::Snapshot &snapshot)
+{
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer), "{\"count\": %llu, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, "
+                  "\"p99_ms\": %.4f, \"p999_ms\": %.4f, \"max_ms\": %.4f}",
+                  static_cast<unsigned long long>(snapshot.count), snapshot.mean(), snapshot.percentile(QUANTILES[0]),
+                  snapshot.percentile(QUANTILES[1]), snapshot.percentile(QUANTILES[2]), snapshot.percentile(QUANTILES[3]),
+                  snapshot.max());
+    out += buffer;
+}
+
+MetricsExporter::MetricsExporter(const MetricsConfig &config, const StageMetrics &metrics) :
+    m_config(config), m_metrics(metrics), m_start(std::chrono::steady_clock::now())
+{
+    if (!m_config.enabled())
+        return;
+
+    if (!m_config.csv_path.empty()) {
+        m_csv = std::fopen(m_config.csv_path.c_str(), "a");
+        if (nullptr == m_csv) {
+            throw std::runtime_error("Failed to open metrics file " + m_config.csv_path + ": " + std::strerror(errno));
+        }
+        if (0 == std::ftell(m_csv))
+            std::fputs("time_s,stage,count,mean_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms\n", m_csv);
+    }
+    m_previous = m_metrics.snapshot();
+    m_thread = std::thread(&MetricsExporter::export_loop, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    close();
+    if (m_csv)
+        std::fclose(m_csv);
+}
+
+void MetricsExporter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopped)
+            return;
+        m_stopped = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void MetricsExporter::export_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        const bool stopped = m_cv.wait_for(lock, m_config.interval, [this] { return m_stopped; });
+        lock.unlock();
+        export_snapshot();
+        lock.lock();
+        if (stopped)
+            return;
+    }
+}
+
+void MetricsExporter::export_snapshot()
+{
+    const auto totals = m_metrics.snapshot();
+    std::array<HdrHistogram::Snapshot, STAGE_COUNT> intervals;
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+        intervals[i] = totals[i].since(m_previous[i]);
+    m_previous = totals;
+    const double time_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+
+    if (!m_config.json_path.empty()) {
+        std::string json = "{\n  \"time_s\": " + std::to_string(time_s) + ",\n  \"stages\": {\n";
+        for (size_t i = 0; i < STAGE_COUNT; i++) {
+            json += std::string("    \"") + stage_name(static_cast<Stage>(i)) + "\": {\"total\": ";
+            append_stats_json(json, totals[i]);
+            json += ", \"interval\": ";
+            append_stats_json(json, intervals[i]);
+            json += (i + 1 < STAGE_COUNT) ? "},\n" : "}\n";
+        }
+        json += "  }\n}\n";
+        replace_file(m_config.json_path, json);
+    }
+
+    if (m_csv) {
+        // Intervals, so a stage that blows the budget for a few seconds stands out in flight logs
+        for (size_t i = 0; i < STAGE_COUNT; i++) {
+            const auto &snapshot = intervals[i];
+            std::fprintf(m_csv, "%.3f,%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", time_s, stage_name(static_cast<Stage>(i)),
+                         static_cast<unsigned long long>(snapshot.count), snapshot.mean(), snapshot.percentile(QUANTILES[0]),
+                         snapshot.percentile(QUANTILES[1]), snapshot.percentile(QUANTILES[2]),
+                         snapshot.percentile(QUANTILES[3]), snapshot.max());
+        }
+        std::fflush(m_csv);
+    }
+
+    if (!m_config.prometheus_path.empty()) {
+        std::string text = "# HELP pose_stage_latency_seconds Pose pipeline stage latency since start.\n"
+                           "# TYPE pose_stage_latency_seconds summary\n";
+        std::string max_text = "# HELP pose_stage_latency_max_seconds Largest pose pipeline stage latency since start.\n"
+                               "# TYPE pose_stage_latency_max_seconds gauge\n";
+        char buffer[160];
+        for (size_t i = 0; i < STAGE_COUNT; i++) {
+            const char *stage = stage_name(static_cast<Stage>(i));
+            const auto &snapshot = totals[i];
+            for (double quantile : QUANTILES) {
+                std::snprintf(buffer, sizeof(buffer), "pose_stage_latency_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n",
+                              stage, quantile / 100.0, snapshot.percentile(quantile) * 1e-3);
+                text += buffer;
+            }
+            std::snprintf(buffer, sizeof(buffer), "pose_stage_latency_seconds_sum{stage=\"%s\"} %.9f\n",
+                          stage, double(snapshot.sum_ns) * 1e-9);
+            text += buffer;
+            std::snprintf(buffer, sizeof(buffer), "pose_stage_latency_seconds_count{stage=\"%s\"} %llu\n",
+                          stage, static_cast<unsigned long long>(snapshot.count));
+            text += buffer;
+            std::snprintf(buffer, sizeof(buffer), "pose_stage_latency_max_seconds{stage=\"%s\"} %.9f\n",
+                          stage, snapshot.max() * 1e-3);
+            max_text += buffer;
+        }
+        replace_file(m_config.prometheus_path, text + max_text);
+    }
+}
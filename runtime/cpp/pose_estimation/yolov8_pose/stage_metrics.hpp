@@ -0,0 +1,153 @@
+/**
+ * Copyright 2020 (C) Hailo Technologies Ltd.
+ * All rights reserved.
+ *
+ * Hailo Technologies Ltd. ("Hailo") disclaims any warranties, including, but not limited to,
+ * the implied warranties of merchantability and fitness for a particular purpose.
+ * This software is provided on an "AS IS" basis, and Hailo has no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ * You may use this software in the development of any project.
+ * You shall not reproduce, modify or distribute this software without prior written permission.
+ **/
+/**
+ * @file stage_metrics.hpp
+ * @brief Per-stage latency histograms of the pose pipeline and their periodic JSON/CSV/Prometheus export
+ **/
+
+#ifndef _HAILO_STAGE_METRICS_HPP_
+#define _HAILO_STAGE_METRICS_HPP_
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+/**
+ * Pipeline stages, each timed on the thread that runs it with the steady (monotonic) clock.
+ */
+enum class Stage : uint32_t {
+    CAPTURE,        // Camera read into a pool buffer (includes waiting for the sensor)
+    PREPROCESS,     // Crop and resize to the network input
+    WRITE,          // Binding the buffers and launching the inference job
+    DEVICE,         // Job launch to its completion
+    READ,           // Completion to postprocess picking the frame up
+    DECODE,         // Score gather, candidate selection and box/keypoint decoding
+    NMS,
+    KEYPOINTS,      // Keypoint and joint filtering of the kept detections
+    RENDER,         // Drawing the overlay
+    END_TO_END,     // Capture to result
+    COUNT
+};
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::COUNT);
+
+const char *stage_name(Stage stage);
+
+/**
+ * @brief One HdrHistogram per stage and recording thread, merged when the metrics are read. A
+ *        thread's first record registers its shard under a lock; after that recording is lock-free
+ *        and allocation-free and threads share no counters, so it can stay on in flight.
+ */
+class StageMetrics {
+public:
+    StageMetrics();
+
+    StageMetrics(const StageMetrics &) = delete;
+    StageMetrics &operator=(const StageMetrics &) = delete;
+
+    void record(Stage stage, std::chrono::nanoseconds duration)
+    {
+        local().histograms[static_cast<size_t>(stage)].record(duration);
+    }
+
+    void record(Stage stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start));
+    }
+
+    // Every stage, summed over the recording threads
+    std::array<HdrHistogram::Snapshot, STAGE_COUNT> snapshot() const;
+
+private:
+    struct Shard {
+        std::array<HdrHistogram, STAGE_COUNT> histograms;
+    };
+
+    Shard &local()
+    {
+        // Ids are never reused, so an entry left by a destroyed StageMetrics never matches
+        thread_local std::vector<std::pair<uint64_t, Shard *>> shards;
+        for (const auto &entry : shards) {
+            if (entry.first == m_id)
+                return *entry.second;
+        }
+        shards.emplace_back(m_id, add_shard());
+        return *shards.back().second;
+    }
+
+    Shard *add_shard();
+
+    const uint64_t m_id;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Shard>> m_shards;   // Kept until the metrics go, threads may have exited
+};
+
+/**
+ * Where and how often the metrics are written. Empty paths are skipped.
+ */
+struct MetricsConfig {
+    std::string json_path;          // Latest snapshot, whole run and last interval
+    std::string csv_path;           // One row per stage and interval, appended
+    std::string prometheus_path;    // Text exposition format, for the node_exporter textfile collector
+    std::chrono::milliseconds interval{1000};
+
+    bool enabled() const { return !json_path.empty() || !csv_path.empty() || !prometheus_path.empty(); }
+
+    // PREFIX.json, PREFIX.csv and PREFIX.prom
+    static MetricsConfig from_prefix(const std::string &prefix);
+};
+
+/**
+ * @brief Snapshots the metrics every interval on its own thread and writes them out, so the pipeline
+ *        threads never touch a file. JSON and Prometheus files are replaced atomically (written
+ *        aside, then renamed) and always hold a complete snapshot.
+ */
+class MetricsExporter {
+public:
+    MetricsExporter(const MetricsConfig &config, const StageMetrics &metrics);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    // Writes a last snapshot and stops the thread. Called by the destructor.
+    void close();
+
+private:
+    void export_loop();
+    void export_snapshot();
+
+    const MetricsConfig m_config;
+    const StageMetrics &m_metrics;
+    const std::chrono::steady_clock::time_point m_start;
+
+    std::array<HdrHistogram::Snapshot, STAGE_COUNT> m_previous;
+    std::FILE *m_csv = nullptr;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopped = false;
+    std::thread m_thread;
+};
+
+#endif /* _HAILO_STAGE_METRICS_HPP_ */
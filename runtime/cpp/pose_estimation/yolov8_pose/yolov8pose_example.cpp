@@ -2,7 +2,17 @@
 #include "common.h"
 
 #include "common/hailo_objects.hpp"
+#include "common/frame_arena.hpp"
 #include "yolov8pose_postprocess.hpp"
+#include "async_engine.hpp"
+#include "frame_pool.hpp"
+#include "latency_histogram.hpp"
+#include "stage_metrics.hpp"
+#include "render_sink.hpp"
+#include "pose_channel.hpp"
+#include "pose_tracker.hpp"
+#include "pose_smoother.hpp"
+#include "roi_scheduler.hpp"
 
 #include <iostream>
 #include <chrono>
@@ -16,10 +26,27 @@
 #include <opencv2/core/matx.hpp>
 #include <opencv2/imgcodecs.hpp>
 
-constexpr bool QUANTIZED = true;
-constexpr hailo_format_type_t FORMAT_TYPE = HAILO_FORMAT_TYPE_AUTO;
+// Camera runs print their latency percentiles every LATENCY_REPORT_FRAMES frames
+constexpr size_t LATENCY_REPORT_FRAMES = 300;
 std::mutex m;
 
+/**
+ * PIPELINED keeps up to 4 frames between the device and postprocess (3 inference jobs in flight) for throughput.
+ * LATEST_ONLY keeps at most one frame per stage (capture, inference, postprocess) and picks the
+ * camera frame only when inference can take it, so results are as fresh as possible (-schedule=latest).
+ */
+enum class Schedule {
+    PIPELINED,
+    LATEST_ONLY,
+};
+
+void print_latency(const std::string &title, const LatencyHistogram &latency) {
+    std::lock_guard<std::mutex> lock(m);
+    std::cout << BOLDGREEN << "-I- " << title << ": p50 " << latency.percentile(50) << " ms, p99 " 
+              << latency.percentile(99) << " ms, average " << latency.mean() << " ms, max " << latency.max() 
+              << " ms (" << latency.count() << " frames)" << std::endl << RESET;
+}
+
 using namespace hailort;
 
 void print_inference_statistics(std::chrono::duration<double> inference_time,
@@ -32,10 +59,26 @@ void print_inference_statistics(std::chrono::duration<double> inference_time,
     std::cout << "-I-----------------------------------------------" << std::endl;
     std::cout << "-I- Average FPS:  " << frame_count / (inference_time.count()) << std::endl;
     std::cout << "-I- Total time:   " << inference_time.count() << " sec" << std::endl;
-    std::cout << "-I- Latency:      " << 1.0 / (frame_count / (inference_time.count()) / 1000) << " ms" << std::endl;
+    // Inverse throughput; the per-stage latencies are printed by print_stage_metrics
+    std::cout << "-I- Frame time:   " << 1.0 / (frame_count / (inference_time.count()) / 1000) << " ms" << std::endl;
     std::cout << "-I-----------------------------------------------" << std::endl;
 }
 
+void print_stage_metrics(const StageMetrics &metrics) {
+    std::lock_guard<std::mutex> lock(m);
+    std::cout << BOLDGREEN << "-I- Stage latency (ms)      p50      p99      max    count" << std::endl;
+    const auto snapshots = metrics.snapshot();
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        const auto &snapshot = snapshots[i];
+        if (0 == snapshot.count)
+            continue;
+        std::cout << "-I-   " << std::left << std::setw(18) << stage_name(static_cast<Stage>(i)) << std::right << std::fixed 
+                  << std::setprecision(2) << std::setw(9) << snapshot.percentile(50) << std::setw(9) << snapshot.percentile(99) 
+                  << std::setw(9) << snapshot.max() << std::setw(9) << snapshot.count << std::endl;
+    }
+    std::cout << RESET;
+}
+
 std::string info_to_str(hailo_vstream_info_t vstream_info) {
     std::string result = vstream_info.name;
     result += " (";
@@ -48,153 +91,259 @@ std::string info_to_str(hailo_vstream_info_t vstream_info) {
     return result;
 }
 
-template <typename T>
-hailo_status post_processing_all(std::vector<std::shared_ptr<FeatureData<T>>> &features, size_t frame_count, 
-                                std::chrono::time_point<std::chrono::system_clock>& postprocess_time, std::vector<cv::Mat>& frames, 
-                                double org_height, double org_width, bool nms_on_hailo, std::string model_type) {
+// Results of a cropped inference are normalized to the crop; this moves them to full-frame coordinates
+void map_roi_to_frame(const cv::Rect2f &roi, HailoROIPtr hailo_roi, std::vector<PersonKeypoints> &persons,
+                      KeypointsAndPairs &keypoints_and_pairs) {
+    auto map_x = [&roi](float x) { return roi.x + x * roi.width; };
+    auto map_y = [&roi](float y) { return roi.y + y * roi.height; };
+    for (auto &detection : hailo_common::get_hailo_detections(hailo_roi)) {
+        HailoBBox bbox = detection->get_bbox();
+        detection->set_bbox(HailoBBox(map_x(bbox.xmin()), map_y(bbox.ymin()), bbox.width() * roi.width, bbox.height() * roi.height));
+    }
+    for (auto &person : persons) {
+        person.xmin = map_x(person.xmin);
+        person.ymin = map_y(person.ymin);
+        person.xmax = map_x(person.xmax);
+        person.ymax = map_y(person.ymax);
+        for (auto &keypoint : person.keypoints) {
+            keypoint.xs = map_x(keypoint.xs);
+            keypoint.ys = map_y(keypoint.ys);
+        }
+    }
+    for (auto &keypoint : keypoints_and_pairs.first) {
+        keypoint.xs = map_x(keypoint.xs);
+        keypoint.ys = map_y(keypoint.ys);
+    }
+    for (auto &pair : keypoints_and_pairs.second) {
+        pair.pt1 = {map_x(pair.pt1.first), map_y(pair.pt1.second)};
+        pair.pt2 = {map_x(pair.pt2.first), map_y(pair.pt2.second)};
+    }
+}
 
-    auto status = HAILO_SUCCESS;
+// Packs the persons of one frame, best first, into the fixed-size message the controller reads
+void fill_pose_message(PoseMessage &message, uint64_t frame_id, std::chrono::steady_clock::time_point capture_time,
+                       std::chrono::steady_clock::time_point keypoint_time,
+                       const std::vector<PersonKeypoints> &persons, const PoseTracker &tracker) {
+    message.magic = POSE_MESSAGE_MAGIC;
+    message.version = POSE_MESSAGE_VERSION;
+    message.frame_id = frame_id;
+    message.primary_track_id = tracker.primary_id();
+    message.capture_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(capture_time.time_since_epoch()).count();
+    message.keypoint_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(keypoint_time.time_since_epoch()).count();
+    message.person_count = static_cast<uint16_t>(std::min<size_t>(persons.size(), POSE_MAX_PERSONS));
+    for (size_t p = 0; p < message.person_count; p++) {
+        const PersonKeypoints &person = persons[p];
+        PosePerson &out = message.persons[p];
+        out.xmin = person.xmin;
+        out.ymin = person.ymin;
+        out.xmax = person.xmax;
+        out.ymax = person.ymax;
+        out.score = person.score;
+        out.class_id = static_cast<uint32_t>(person.class_id);
+        out.track_id = tracker.track_id(p);
+        for (size_t k = 0; k < POSE_NUM_KEYPOINTS; k++) {
+            out.keypoints[k] = PoseKeypoint{person.keypoints[k].xs, person.keypoints[k].ys, person.keypoints[k].joints_scores};
+        }
+    }
+    message.publish_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    std::sort(features.begin(), features.end(), &FeatureData<T>::sort_tensors_by_size);
+template <typename T>
+hailo_status post_processing_all(const std::vector<hailo_vstream_info_t> &output_infos, size_t frame_count, 
+                                std::chrono::time_point<std::chrono::system_clock>& postprocess_time, FrameGather<T>& gather, 
+                                const PosePostprocessConfig& pp_config, StageMetrics& metrics, PosePublisher& publisher, 
+                                const PoseSmootherConfig& smoother_config, int predict_ms,
+                                RoiScheduler& roi_scheduler, RenderSink& render, bool nms_on_hailo, std::string model_type) {
 
-    cv::VideoWriter video("./processed_video.mp4", cv::VideoWriter::fourcc('m','p','4','v'), 30, 
-                          cv::Size((int)org_width, (int)org_height));
+    auto status = HAILO_SUCCESS;
 
     {
        std::lock_guard<std::mutex> lock(m);
        std::cout << YELLOW << "\n-I- Starting postprocessing\n" << std::endl << RESET;
     }
 
+    PoseFrameStats pp_stats;
+    size_t degraded_frames = 0;
+
+    // Capture-to-result latency of every frame
+    LatencyHistogram latency;
+
+    std::vector<PersonKeypoints> persons;
+    PoseTracker tracker;
+    PoseSmoother smoother(smoother_config);
+    PoseMessage pose_message{};
+
+    // Everything the postprocess builds for a frame comes from here and is dropped at once when the frame ends
+    common::FrameArena arena;
+
     for (size_t i = 0; i < frame_count; i++){
-        cv::Mat currentFrame;
-        {
-            std::lock_guard<std::mutex> lock(m);
-            if (frames.empty()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
-            currentFrame = frames.front().clone();
-            frames.erase(frames.begin());
+        common::FrameScope frame_scope(arena);
+        // Blocks until the image and every output of frame i are in the slot
+        FrameSlot<T> &slot = gather.get_complete_frame(i);
+        if (HAILO_SUCCESS != slot.status) {
+            std::cerr << "Inference failed with status = " << slot.status << std::endl;
+            status = slot.status;
+            gather.release_frame(slot);
+            // The writer would otherwise wait forever for the slots of frames nobody reads
+            gather.close();
+            break;
         }
+        metrics.record(Stage::READ, slot.complete_time, std::chrono::steady_clock::now());
 
-        HailoROIPtr roi = std::make_shared<HailoROI>(HailoROI(HailoBBox(0.0f, 0.0f, 1.0f, 1.0f)));
+        // The ROI and its tensors end with the frame; the detections added to it may be rendered later and stay on the heap
+        std::pmr::polymorphic_allocator<HailoROI> frame_allocator(&arena);
+        HailoROIPtr roi = std::allocate_shared<HailoROI>(frame_allocator, HailoBBox(0.0f, 0.0f, 1.0f, 1.0f));
         
-        for (uint j = 0; j < features.size(); j++) {
-            roi->add_tensor(std::make_shared<HailoTensor>(
-                reinterpret_cast<T*>(features[j]->m_buffers.get_read_buffer().data()), 
-                features[j]->m_vstream_info));
+        for (uint j = 0; j < output_infos.size(); j++) {
+            roi->add_tensor(std::allocate_shared<HailoTensor>(frame_allocator,
+                reinterpret_cast<T*>(slot.outputs[j].data()), 
+                output_infos[j]));
         }
 
-        std::pair<std::vector<KeyPt>, std::vector<PairPairs>> keypoints_and_pairs = filter(roi);
-    
-        for (auto &feature : features) {
-            feature->m_buffers.release_read_buffer();
+        KeypointsAndPairs keypoints_and_pairs = filter(roi, pp_config, pp_stats, persons, &arena);
+        if (pp_stats.degraded)
+            degraded_frames++;
+        metrics.record(Stage::DECODE, pp_stats.decode_time);
+        metrics.record(Stage::NMS, pp_stats.nms_time);
+        metrics.record(Stage::KEYPOINTS, pp_stats.keypoint_time);
+        if (!RoiScheduler::is_full_frame(slot.roi))
+            map_roi_to_frame(slot.roi, roi, persons, keypoints_and_pairs);
+        tracker.update(persons, slot.capture_time);
+        if (roi_scheduler.enabled()) {
+            // Crop the next frames around the primary target while it is seen
+            const PoseTrack *target = tracker.primary();
+            if (nullptr != target && 0 == target->missed)
+                roi_scheduler.report_target(cv::Rect2f(target->xmin(), target->ymin(), target->xmax() - target->xmin(),
+                                                       target->ymax() - target->ymin()));
+            else
+                roi_scheduler.report_lost();
+        }
+        // Published first: the controller never waits on the printout or the rendering
+        if (publisher.enabled()) {
+            // Tracked persons are smoothed and, with -predict_ms, extrapolated to the actuation time
+            auto keypoint_time = slot.capture_time;
+            for (size_t p = 0; p < persons.size(); p++) {
+                if (0 != tracker.track_id(p))
+                    smoother.smooth(tracker.track_id(p), slot.capture_time, persons[p].keypoints);
+            }
+            if (predict_ms >= 0 && SmoothingFilter::NONE != smoother.config().filter) {
+                keypoint_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(predict_ms);
+                for (size_t p = 0; p < persons.size(); p++) {
+                    if (0 != tracker.track_id(p))
+                        smoother.predict(tracker.track_id(p), keypoint_time, persons[p].keypoints);
+                }
+            }
+            fill_pose_message(pose_message, slot.seq, slot.capture_time, keypoint_time, persons, tracker);
+            publisher.publish(pose_message);
         }
 
         std::vector<HailoDetectionPtr> detections = hailo_common::get_hailo_detections(roi);
-        cv::resize(currentFrame, currentFrame, cv::Size((int)org_width, (int)org_height), 1);
+        auto capture_time = slot.capture_time;
+        auto frame_roi = slot.roi;
+        // The render copy is the only reason to keep the image past this point; headless skips it
+        RenderFrame render_frame;
+        if (render.enabled())
+            slot.image.copyTo(render_frame.image);
+        gather.release_frame(slot);
 
         for (auto &detection : detections) {
             if (detection->get_confidence() == 0) {
                 continue;
             }
-            HailoBBox bbox = detection->get_bbox();
-            cv::rectangle(currentFrame, 
-                          cv::Point2f(bbox.xmin() * float(org_width), bbox.ymin() * float(org_height)), 
-                          cv::Point2f(bbox.xmax() * float(org_width), bbox.ymax() * float(org_height)), 
-                          cv::Scalar(0, 0, 255), 1);
             std::cout << "Detection: " << detection->get_label() << ", Confidence: " 
                       << std::fixed << std::setprecision(2) << detection->get_confidence() * 100.0 << "%" << std::endl;
         }
 
-        for (auto &keypoint : keypoints_and_pairs.first){
-            cv::circle(currentFrame, 
-                       cv::Point(keypoint.xs * float(org_width), keypoint.ys * float(org_height)), 
-                       3, cv::Scalar(255, 0, 255), -1);
+        const auto result_time = std::chrono::steady_clock::now();
+        latency.record(result_time - capture_time);
+        metrics.record(Stage::END_TO_END, capture_time, result_time);
+        if (frame_count == static_cast<size_t>(-1) && latency.count() == LATENCY_REPORT_FRAMES) {
+            print_latency("Capture-to-result latency", latency);
+            latency.reset();
         }
 
-        for (PairPairs &p : keypoints_and_pairs.second){
-            auto pt1 = cv::Point(p.pt1.first * float(org_width), p.pt1.second * float(org_height));
-            auto pt2 = cv::Point(p.pt2.first * float(org_width), p.pt2.second * float(org_height));
-            cv::line(currentFrame, pt1, pt2, cv::Scalar(255, 0, 255), 3);
+        if (render.enabled()) {
+            render_frame.track_ids.resize(detections.size());
+            for (size_t d = 0; d < detections.size(); d++)
+                render_frame.track_ids[d] = tracker.track_id(d);
+            render_frame.primary_id = tracker.primary_id();
+            render_frame.roi = frame_roi;
+            render_frame.detections = std::move(detections);
+            // Copied out of the arena, the render thread draws them after this frame is reset
+            render_frame.keypoints.assign(keypoints_and_pairs.first.begin(), keypoints_and_pairs.first.end());
+            render_frame.pairs.assign(keypoints_and_pairs.second.begin(), keypoints_and_pairs.second.end());
+            render.submit(std::move(render_frame));
         }
-
-        cv::imshow("Display window", currentFrame);
-        cv::waitKey(30);
-
-        video.write(currentFrame);
-        cv::imwrite("output_image.jpg", currentFrame);
     }
     postprocess_time = std::chrono::high_resolution_clock::now();
-    video.release();
-
-    return status;
-}
-
-template <typename T>
-hailo_status read_all(OutputVStream& output_vstream, std::shared_ptr<FeatureData<T>> feature, size_t frame_count) { 
 
-    {
+    if (degraded_frames > 0) {
         std::lock_guard<std::mutex> lock(m);
-        std::cout << GREEN << "-I- Started read thread: " << info_to_str(output_vstream.get_info()) << std::endl << RESET;
+        std::cout << YELLOW << "-I- Postprocess time budget exceeded on " << degraded_frames << " frames" << std::endl << RESET;
     }
-
-    if (frame_count == static_cast<size_t>(-1)){
-        for (;;) {
-            std::vector<T>& buffer = feature->m_buffers.get_write_buffer();
-            hailo_status status = output_vstream.read(MemoryView(buffer.data(), buffer.size()));
-            feature->m_buffers.release_write_buffer();
-            if (HAILO_SUCCESS != status) {
-                std::cerr << "Failed reading with status = " << status << std::endl;
-                return status;
-            }
-        }
+    if (latency.count() > 0) {
+        print_latency("Capture-to-result latency", latency);
     }
-    else {
-        for (size_t i = 0; i < frame_count; i++) {
-            std::vector<T>& buffer = feature->m_buffers.get_write_buffer();
-            hailo_status status = output_vstream.read(MemoryView(buffer.data(), buffer.size()));
-            feature->m_buffers.release_write_buffer();
-            if (HAILO_SUCCESS != status) {
-                std::cerr << "Failed reading with status = " << status << std::endl;
-                return status;
-            }
-        }
+    {
+        std::lock_guard<std::mutex> lock(m);
+        std::cout << YELLOW << "-I- Postprocess frame arena: " << arena.capacity() / 1024 << " KiB, peak frame "
+                  << arena.high_water() / 1024 << " KiB, " << arena.total().allocations << " allocations served, "
+                  << arena.total().upstream_allocations << " from the heap" << std::endl << RESET;
+    }
+    if (publisher.socket_dropped() > 0) {
+        std::lock_guard<std::mutex> lock(m);
+        std::cout << YELLOW << "-I- Pose messages not delivered to the socket: " << publisher.socket_dropped() << std::endl << RESET;
     }
 
-    return HAILO_SUCCESS;
+    return status;
 }
 
-hailo_status use_single_frame(InputVStream& input_vstream, 
+hailo_status use_single_frame(AsyncInferenceEngine& engine, 
     std::chrono::time_point<std::chrono::system_clock>& write_time_vec,
-    std::vector<cv::Mat>& frames, cv::Mat& image, int frame_count) {
+    cv::Mat& image, int frame_count, RoiScheduler& roi_scheduler) {
 
     hailo_status status = HAILO_SUCCESS;
     write_time_vec = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < frame_count; i++) {
-        {
-            std::lock_guard<std::mutex> lock(m);
-            frames.push_back(image);
-        }
-        status = input_vstream.write(MemoryView(frames.back().data, input_vstream.get_frame_size()));
+        status = engine.submit(image, std::chrono::steady_clock::now(), FrameHandle(), roi_scheduler.next_roi());
         if (HAILO_SUCCESS != status)
             return status;
     }
     return HAILO_SUCCESS;
 }
 
+// Reads the camera into pooled buffers as fast as it delivers. The queue decides what is kept.
+hailo_status capture_all(cv::VideoCapture& capture, FramePool& pool, FrameQueue& queue, StageMetrics& metrics) {
+    while (!queue.closed()) {
+        FrameHandle frame = pool.acquire();
+        const auto read_start = std::chrono::steady_clock::now();
+        if (!capture.read(frame.mat()) || frame.mat().empty()) {
+            break;
+        }
+        frame.capture_time = std::chrono::steady_clock::now();
+        metrics.record(Stage::CAPTURE, read_start, frame.capture_time);
+        if (!queue.push(std::move(frame))) {
+            break;
+        }
+    }
+    queue.close();
+    return HAILO_SUCCESS;
+}
+
 // Modified write_all: now takes frame_count by reference.
-hailo_status write_all(InputVStream& input_vstream, std::string input_path, 
+hailo_status write_all(AsyncInferenceEngine& engine, std::string input_path, 
     std::chrono::time_point<std::chrono::system_clock>& write_time_vec, 
-    std::vector<cv::Mat>& frames, std::string& cmd_num_frames, size_t &frame_count) {
+    FramePool& frame_pool, Schedule schedule, RoiScheduler& roi_scheduler, StageMetrics& metrics, 
+    std::string& cmd_num_frames, size_t &frame_count) {
 
     {
         std::lock_guard<std::mutex> lock(m);
-        std::cout << CYAN << "-I- Started write thread: " << info_to_str(input_vstream.get_info()) << std::endl << RESET;
+        std::cout << CYAN << "-I- Started write thread: " << info_to_str(engine.input_info()) << std::endl << RESET;
     }
 
     hailo_status status = HAILO_SUCCESS;
-    auto input_shape = input_vstream.get_info().shape;
+    auto input_shape = engine.input_info().shape;
     int width = input_shape.width;
     int height = input_shape.height;
 
@@ -228,152 +377,168 @@ hailo_status write_all(InputVStream& input_vstream, std::string input_path,
         width = org_frame.cols;
         height = org_frame.rows;
         cv::resize(org_frame, org_frame, cv::Size(width, height), 1);
-        status = use_single_frame(input_vstream, write_time_vec, frames, org_frame, std::stoi(cmd_num_frames));
+        status = use_single_frame(engine, write_time_vec, org_frame, std::stoi(cmd_num_frames), roi_scheduler);
         if (HAILO_SUCCESS != status)
             return status;
         capture.release();
     }
     else {
+        // Live camera: capture runs on its own thread into pooled buffers (full FOV, not resized to
+        // network dimensions) and only the latest frame waits for the device, so a slow postprocess
+        // drops stale frames instead of queueing them.
+        FrameQueue latest_frame(1, BackpressureMode::DROP_OLDEST);
+        auto capture_thread = std::async(std::launch::async, capture_all, std::ref(capture), 
+                                         std::ref(frame_pool), std::ref(latest_frame), std::ref(metrics));
         write_time_vec = std::chrono::high_resolution_clock::now();
         for (;;) {
-            capture >> org_frame;
-            if (org_frame.empty()) {
-                break;
+            if (Schedule::LATEST_ONLY == schedule) {
+                // Choose the frame only once inference can take it, so it does not age in the writer
+                if (!engine.gather().wait_for_free_slot()) {
+                    status = HAILO_STREAM_ABORT;
+                    break;
+                }
             }
-            // Do not resize to network dimensions; show full FOV.
-            cv::resize(org_frame, org_frame, cv::Size(width, height), 1);
-            {
-                std::lock_guard<std::mutex> lock(m);
-                frames.push_back(org_frame);
+            FrameHandle frame = latest_frame.pop();
+            if (!frame) {
+                break;
             }
-            status = input_vstream.write(MemoryView(frames.back().data, input_vstream.get_frame_size()));
+            cv::Mat image = frame.mat();
+            status = engine.submit(image, frame.capture_time, std::move(frame), roi_scheduler.next_roi());
             if (HAILO_SUCCESS != status)
-                return status;
-            org_frame.release();
+                break;
         }
+        latest_frame.close();
+        capture_thread.wait();
         capture.release();
+        {
+            std::lock_guard<std::mutex> lock(m);
+            std::cout << CYAN << "-I- Camera frames dropped for a newer one: " << latest_frame.dropped() << std::endl << RESET;
+        }
+        if (HAILO_SUCCESS != status)
+            return status;
     }
     return HAILO_SUCCESS;
 }
 
-template <typename T>
-hailo_status create_feature(hailo_vstream_info_t vstream_info, size_t output_frame_size, 
-                              std::shared_ptr<FeatureData<T>> &feature) {
-    feature = std::make_shared<FeatureData<T>>(static_cast<uint32_t>(output_frame_size), 
-                                                vstream_info.quant_info.qp_zp,
-                                                vstream_info.quant_info.qp_scale, 
-                                                vstream_info.shape.width, 
-                                                vstream_info);
-    return HAILO_SUCCESS;
-}
-
-template <typename T>
-hailo_status run_inference(std::vector<InputVStream>& input_vstream, 
-                           std::vector<OutputVStream>& output_vstreams, std::string input_path,
+hailo_status run_inference(std::unique_ptr<InferenceBackend> backend, std::string input_path,
                            std::chrono::time_point<std::chrono::system_clock>& write_time_vec,
                            std::chrono::duration<double>& inference_time, 
                            std::chrono::time_point<std::chrono::system_clock>& postprocess_time, 
                            size_t frame_count, double org_height, double org_width, 
-                           std::string cmd_img_num) {
+                           std::string cmd_img_num, Schedule schedule, std::string record_path, std::string model_config,
+                           PosePublisher &publisher, const PoseSmootherConfig &smoother_config, int predict_ms,
+                           const RoiConfig &roi_config, const RenderConfig &render_config, 
+                           const MetricsConfig &metrics_config, std::chrono::microseconds pp_budget) {
 
-    hailo_status status = HAILO_UNINITIALIZED;
     std::string model_type = "";
-    auto output_vstreams_size = output_vstreams.size();
     bool nms_on_hailo = false;
-    std::string output_name = std::string(output_vstreams[0].get_info().name);
-    if (output_vstreams_size == 1 && (output_name.find("nms") != std::string::npos)) {
+    std::string output_name = std::string(backend->output_infos()[0].name);
+    if (backend->output_infos().size() == 1 && (output_name.find("nms") != std::string::npos)) {
         nms_on_hailo = true;
         model_type = output_name.substr(0, output_name.find('/'));
     }
 
-    std::vector<std::shared_ptr<FeatureData<uint8_t>>> features;
-    features.reserve(output_vstreams_size);
-    for (size_t i = 0; i < output_vstreams_size; i++) {
-        std::shared_ptr<FeatureData<uint8_t>> feature(nullptr);
-        status = create_feature(output_vstreams[i].get_info(), output_vstreams[i].get_frame_size(), feature);
-        if (HAILO_SUCCESS != status) {
-            std::cerr << "Failed creating feature with status = " << status << std::endl;
-            return status;
+    // Camera frames are captured into a fixed pool: one buffer per frame slot, plus the latest-frame
+    // queue, the one being captured and the one being submitted. Declared first so it outlives the slots.
+    // Latest-only keeps two slots: one frame in inference and one in postprocess.
+    const uint32_t frame_slots = (Schedule::LATEST_ONLY == schedule) ? 2 : 4;
+    // Every stage records into it, so it outlives the engine, the render sink and the exporter
+    StageMetrics metrics;
+    FramePool frame_pool(input_path.empty() ? frame_slots + 3 : 0, (int)org_height, (int)org_width, CV_8UC3);
+    AsyncInferenceEngine engine(std::move(backend), frame_slots);
+    if (!record_path.empty() && !engine.record_outputs(record_path)) {
+        std::cerr << "Failed to open record file " << record_path << std::endl;
+        return HAILO_OPEN_FILE_FAILURE;
+    }
+    engine.set_metrics(&metrics);
+    std::unique_ptr<MetricsExporter> exporter;
+    try {
+        exporter = std::make_unique<MetricsExporter>(metrics_config, metrics);
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return HAILO_OPEN_FILE_FAILURE;
+    }
+
+    // Geometry comes from the HEF, -config=FILE sets thresholds (or overrides what the HEF cannot tell)
+    PosePostprocessConfig pp_config;
+    if (!nms_on_hailo) {
+        try {
+            const auto output_infos = common::postprocess_order(engine.output_infos());
+            common::describe_model(engine.input_info(), output_infos, pp_config.model);
+            if (!model_config.empty())
+                common::load_model_config(model_config, pp_config.model);
+            common::validate_model(pp_config.model, output_infos);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Unsupported model: " << e.what() << std::endl;
+            return HAILO_INVALID_HEF;
         }
-        features.emplace_back(feature);
+        std::cout << CYAN << "-I- Model: " << pp_config.model.network_width << "x" << pp_config.model.network_height 
+                  << ", " << pp_config.model.strides.size() << " levels, " << pp_config.model.num_classes << " classes" 
+                  << std::endl << RESET;
     }
+    // Bound the postprocess so a crowded frame cannot stall the control loop
+    pp_config.time_budget = pp_budget;
 
-    std::vector<cv::Mat> frames;
+    RenderSink render(render_config, cv::Size((int)org_width, (int)org_height), &metrics);
+    RoiScheduler roi_scheduler(roi_config, cv::Size((int)org_width, (int)org_height),
+                               cv::Size(engine.input_info().shape.width, engine.input_info().shape.height));
 
     // Pass frame_count by reference to write_all.
-    auto input_thread = std::async(write_all, std::ref(input_vstream[0]), input_path, 
-                                   std::ref(write_time_vec), std::ref(frames), std::ref(cmd_img_num),
+    auto input_thread = std::async(write_all, std::ref(engine), input_path, 
+                                   std::ref(write_time_vec), std::ref(frame_pool), schedule, std::ref(roi_scheduler), std::ref(metrics), std::ref(cmd_img_num),
                                    std::ref(frame_count));
 
-    std::vector<std::future<hailo_status>> output_threads;
-    output_threads.reserve(output_vstreams_size);
-    for (size_t i = 0; i < output_vstreams_size; i++) {
-        output_threads.emplace_back(std::async(read_all<uint8_t>, std::ref(output_vstreams[i]), features[i], frame_count)); 
-    }
-
-    hailo_status pp_status = post_processing_all<uint8_t>(features, frame_count, postprocess_time, frames, 
-                                                          org_height, org_width, nms_on_hailo, model_type);
+    hailo_status pp_status = post_processing_all<uint8_t>(engine.output_infos(), frame_count, postprocess_time, engine.gather(), 
+                                                          pp_config, metrics, publisher, smoother_config, predict_ms, roi_scheduler, render, 
+                                                          nms_on_hailo, model_type);
 
-    for (size_t i = 0; i < output_threads.size(); i++) {
-        status = output_threads[i].get();
-    }
     auto input_status = input_thread.get();
 
-    if (HAILO_SUCCESS != input_status) {
-        std::cerr << "Write thread failed with status " << input_status << std::endl;
-        return input_status; 
+    if (roi_scheduler.enabled()) {
+        std::cout << CYAN << "-I- ROI mode: " << roi_scheduler.frames() - roi_scheduler.full_scans() << " cropped frames, " 
+                  << roi_scheduler.full_scans() << " full-frame scans" << std::endl << RESET;
     }
-    if (HAILO_SUCCESS != status) {
-        std::cerr << "Read failed with status " << status << std::endl;
-        return status;
+
+    // Flushes the video and the last snapshot
+    render.close();
+    exporter->close();
+    print_stage_metrics(metrics);
+    if (render.enabled()) {
+        auto render_stats = render.get_stats();
+        std::cout << CYAN << "-I- Rendered frames dropped: draw " << render_stats.draw_dropped 
+                  << ", display " << render_stats.display_dropped << ", video " << render_stats.video_dropped 
+                  << ", snapshot " << render_stats.snapshot_dropped << std::endl << RESET;
     }
+
+    // A failed postprocess aborts the write thread too, its status is the one to report
     if (HAILO_SUCCESS != pp_status) {
         std::cerr << "Post-processing failed with status " << pp_status << std::endl;
         return pp_status;
     }
+    if (HAILO_SUCCESS != input_status) {
+        std::cerr << "Write thread failed with status " << input_status << std::endl;
+        return input_status; 
+    }
 
     inference_time = postprocess_time - write_time_vec;
     std::cout << BOLDBLUE << "\n-I- Inference finished successfully" << RESET << std::endl;
-    status = HAILO_SUCCESS;
-    return status;
+    return HAILO_SUCCESS;
 }
 
-void print_net_banner(std::pair<std::vector<hailort::InputVStream>, std::vector<hailort::OutputVStream>> &vstreams) {
+void print_net_banner(const InferenceBackend &backend) {
     std::cout << BOLDMAGENTA << "-I-----------------------------------------------" << std::endl << RESET;
     std::cout << BOLDMAGENTA << "-I-  Network  Name                                     " << std::endl << RESET;
     std::cout << BOLDMAGENTA << "-I-----------------------------------------------" << std::endl << RESET;
-    for (auto const& value: vstreams.first) {
-        std::cout << MAGENTA << "-I-  IN:  " << value.name() << std::endl << RESET;
-    }
+    std::cout << MAGENTA << "-I-  IN:  " << backend.input_info().name << std::endl << RESET;
     std::cout << BOLDMAGENTA << "-I-----------------------------------------------" << std::endl << RESET;
-    for (auto const& value: vstreams.second) {
-        std::cout << MAGENTA << "-I-  OUT: " << value.name() << std::endl << RESET;
+    for (auto const& value: backend.output_infos()) {
+        std::cout << MAGENTA << "-I-  OUT: " << value.name << std::endl << RESET;
     }
     std::cout << BOLDMAGENTA << "-I-----------------------------------------------\n" << std::endl << RESET;
 }
 
-Expected<std::shared_ptr<ConfiguredNetworkGroup>> configure_network_group(VDevice &vdevice, std::string yolov_hef)
-{
-    auto hef_exp = Hef::create(yolov_hef);
-    if (!hef_exp) {
-        return make_unexpected(hef_exp.status());
-    }
-    auto hef = hef_exp.release();
-    auto configure_params = hef.create_configure_params(HAILO_STREAM_INTERFACE_PCIE);
-    if (!configure_params) {
-        return make_unexpected(configure_params.status());
-    }
-    auto network_groups = vdevice.configure(hef, configure_params.value());
-    if (!network_groups) {
-        return make_unexpected(network_groups.status());
-    }
-    if (1 != network_groups->size()) {
-        std::cerr << "Invalid amount of network groups" << std::endl;
-        return make_unexpected(HAILO_INTERNAL_FAILURE);
-    }
-    return std::move(network_groups->at(0));
-}
-
 std::string getCmdOption(int argc, char *argv[], const std::string &option)
 {
     std::string cmd;
@@ -390,6 +555,16 @@ std::string getCmdOption(int argc, char *argv[], const std::string &option)
     return cmd;
 }
 
+bool hasCmdFlag(int argc, char *argv[], const std::string &flag)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (flag == argv[i])
+            return true;
+    }
+    return false;
+}
+
 int main(int argc, char** argv) {
 
     hailo_status status = HAILO_UNINITIALIZED;
@@ -399,33 +574,89 @@ int main(int argc, char** argv) {
     std::string yolov_hef = getCmdOption(argc, argv, "-hef=");
     std::string input_path = getCmdOption(argc, argv, "-input=");
     std::string image_num = getCmdOption(argc, argv, "-num=");
+    Schedule schedule = (getCmdOption(argc, argv, "-schedule=") == "latest") ? Schedule::LATEST_ONLY : Schedule::PIPELINED;
+    // -replay=FILE runs without a device on outputs recorded with -record=FILE
+    std::string replay_path = getCmdOption(argc, argv, "-replay=");
+    std::string replay_latency_ms = getCmdOption(argc, argv, "-replay_latency=");
+    std::string record_path = getCmdOption(argc, argv, "-record=");
+    // -config=FILE holds key = value model settings, see common/model_descriptor.hpp
+    std::string model_config = getCmdOption(argc, argv, "-config=");
+    // -metrics=PREFIX writes per-stage latencies to PREFIX.json, PREFIX.csv and PREFIX.prom every
+    // -metrics_interval_ms=N (1000 by default)
+    MetricsConfig metrics_config;
+    std::string metrics_prefix = getCmdOption(argc, argv, "-metrics=");
+    if (!metrics_prefix.empty())
+        metrics_config = MetricsConfig::from_prefix(metrics_prefix);
+    std::string metrics_interval = getCmdOption(argc, argv, "-metrics_interval_ms=");
+    if (!metrics_interval.empty())
+        metrics_config.interval = std::chrono::milliseconds(std::stoi(metrics_interval));
+
+    // -render=display,video,snapshot picks the outputs (all by default), -headless disables rendering
+    RenderConfig render_config;
+    std::string render_outputs = getCmdOption(argc, argv, "-render=");
+    if (!render_outputs.empty()) {
+        render_config.display.enabled = render_outputs.find("display") != std::string::npos;
+        render_config.video.enabled = render_outputs.find("video") != std::string::npos;
+        render_config.snapshot.enabled = render_outputs.find("snapshot") != std::string::npos;
+    }
+    if (hasCmdFlag(argc, argv, "-headless")) {
+        render_config.display.enabled = false;
+        render_config.video.enabled = false;
+        render_config.snapshot.enabled = false;
+    }
+    if (!input_path.empty()) {
+        // Offline runs keep every frame in the video; only the preview drops
+        render_config.draw.mode = BackpressureMode::BLOCK;
+        render_config.video.mode = BackpressureMode::BLOCK;
+    }
 
     std::chrono::time_point<std::chrono::system_clock> write_time_vec;
     std::chrono::time_point<std::chrono::system_clock> postprocess_end_time;
     std::chrono::duration<double> inference_time;
 
-    auto vdevice_exp = VDevice::create();
-    if (!vdevice_exp) {
-        std::cerr << "Failed create vdevice, status = " << vdevice_exp.status() << std::endl;
-        return vdevice_exp.status();
-    }
-    auto vdevice = vdevice_exp.release();
-
-    auto network_group_exp = configure_network_group(*vdevice, yolov_hef);
-    if (!network_group_exp) {
-        std::cerr << "Failed to configure network group " << yolov_hef << std::endl;
-        return network_group_exp.status();
+    // -publish=/SHM_NAME publishes every pose to a shared-memory seqlock, -publish_socket=PATH to a
+    // Unix-domain datagram socket (see pose_channel.hpp)
+    std::string publish_shm = getCmdOption(argc, argv, "-publish=");
+    std::string publish_socket = getCmdOption(argc, argv, "-publish_socket=");
+    // -smooth=one_euro|kalman|none filters published keypoints per track (One-Euro by default),
+    // -predict_ms=N extrapolates them to N ms after publishing to cover the pipeline and actuation delay
+    PoseSmootherConfig smoother_config;
+    std::string smooth = getCmdOption(argc, argv, "-smooth=");
+    if (smooth == "kalman")
+        smoother_config.filter = SmoothingFilter::KALMAN;
+    else if (smooth == "none")
+        smoother_config.filter = SmoothingFilter::NONE;
+    std::string predict = getCmdOption(argc, argv, "-predict_ms=");
+    int predict_ms = predict.empty() ? -1 : std::stoi(predict);
+    // -roi crops each inference around the tracked subject, with a full-frame scan every -roi_full_scan=N frames
+    RoiConfig roi_config;
+    roi_config.enabled = hasCmdFlag(argc, argv, "-roi");
+    std::string roi_full_scan = getCmdOption(argc, argv, "-roi_full_scan=");
+    if (!roi_full_scan.empty())
+        roi_config.full_scan_interval = std::stoi(roi_full_scan);
+
+    // -pp_budget_ms=N stops decoding candidates N ms into a frame's postprocess (15 by default, 0 disables)
+    std::string pp_budget_ms = getCmdOption(argc, argv, "-pp_budget_ms=");
+    auto pp_budget = std::chrono::microseconds(1000 * (pp_budget_ms.empty() ? 15 : std::stoi(pp_budget_ms)));
+
+    std::unique_ptr<InferenceBackend> backend;
+    std::unique_ptr<PosePublisher> publisher;
+    try {
+        publisher = std::make_unique<PosePublisher>(publish_shm, publish_socket);
+        if (replay_path.empty()) {
+            backend = std::make_unique<HailoBackend>(yolov_hef);
+        }
+        else {
+            auto latency = std::chrono::microseconds(replay_latency_ms.empty() ? 0 : 1000 * std::stoi(replay_latency_ms));
+            backend = std::make_unique<FileReplayBackend>(yolov_hef, replay_path, latency);
+        }
     }
-    auto network_group = network_group_exp.release();
-
-    auto vstreams_exp = VStreamsBuilder::create_vstreams(*network_group, QUANTIZED, FORMAT_TYPE);
-    if (!vstreams_exp) {
-        std::cerr << "Failed creating vstreams " << vstreams_exp.status() << std::endl;
-        return vstreams_exp.status();
+    catch (const std::exception &e) {
+        std::cerr << "Failed creating inference backend or pose publisher: " << e.what() << std::endl;
+        return HAILO_INTERNAL_FAILURE;
     }
-    auto vstreams = vstreams_exp.release();
 
-    print_net_banner(vstreams);
+    print_net_banner(*backend);
 
     cv::VideoCapture capture;
     size_t frame_count;
@@ -441,11 +672,11 @@ int main(int argc, char** argv) {
         org_height = capture.get(cv::CAP_PROP_FRAME_HEIGHT);
         frame_count = static_cast<size_t>(-1);
         capture.release();
-        status = run_inference<uint8_t>(std::ref(vstreams.first), 
-                        std::ref(vstreams.second), 
+        status = run_inference(std::move(backend), 
                         input_path, 
                         write_time_vec, inference_time, postprocess_end_time, 
-                        frame_count, org_height, org_width, image_num);      
+                        frame_count, org_height, org_width, image_num, schedule, record_path, model_config, *publisher, smoother_config, predict_ms, 
+                        roi_config, render_config, metrics_config, pp_budget);      
     }
     else {
         capture.open(input_path, cv::CAP_ANY);
@@ -460,11 +691,11 @@ int main(int argc, char** argv) {
             frame_count = std::stoi(image_num);
         }
         capture.release();
-        status = run_inference<uint8_t>(std::ref(vstreams.first), 
-                        std::ref(vstreams.second), 
+        status = run_inference(std::move(backend), 
                         input_path, 
                         write_time_vec, inference_time, postprocess_end_time, 
-                        frame_count, org_height, org_width, image_num);      
+                        frame_count, org_height, org_width, image_num, schedule, record_path, model_config, *publisher, smoother_config, predict_ms, 
+                        roi_config, render_config, metrics_config, pp_budget);      
     }
 
     if (HAILO_SUCCESS != status) {
@@ -4,11 +4,20 @@
 **/
 
 // General includes
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <memory_resource>
+#include <span>
 #include <vector>
 
 // Hailo includes
 #include "common/math.hpp"
+#include "common/quant_lut.hpp"
+#include "common/anchor_grid.hpp"
+#include "common/nms_engine.hpp"
+#include "common/model_descriptor.hpp"
+#include "common/trace.hpp"
 #include "common/hailo_objects.hpp"
 #include "common/tensors.hpp"
 #include "common/labels/coco_eighty.hpp"
@@ -16,13 +25,6 @@
 
 using namespace xt::placeholders;
 
-#define SCORE_THRESHOLD 0.6
-#define IOU_THRESHOLD 0.7
-#define NUM_CLASSES 1
-
-// New scaling factor for keypoints if they appear too clustered
-#define KEYPOINT_SCALE 4.0f
-
 std::vector<std::pair<int, int>> JOINT_PAIRS = {
     {0, 1}, {1, 3}, {0, 2}, {2, 4},
     {5, 6}, {5, 7}, {7, 9}, {6, 8}, {8, 10},
@@ -30,15 +32,18 @@ std::vector<std::pair<int, int>> JOINT_PAIRS = {
     {11, 13}, {12, 14}, {13, 15}, {14, 16}
 };
 
-std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter_keypoints(std::vector<Decodings> filtered_decodings,
-                                                            std::vector<int> network_dims, float joint_threshold=0.1) {
-    std::vector<KeyPt> filtered_keypoints;
-    std::vector<PairPairs> filtered_pairs;
+KeypointsAndPairs filter_keypoints(const std::pmr::vector<Decodings> &filtered_decodings, const std::array<int, 2> &network_dims,
+                                   float joint_threshold, std::pmr::memory_resource *memory) {
+    KeypointsAndPairs keypoints_and_pairs{std::pmr::vector<KeyPt>(memory), std::pmr::vector<PairPairs>(memory)};
+    std::pmr::vector<KeyPt> &filtered_keypoints = keypoints_and_pairs.first;
+    std::pmr::vector<PairPairs> &filtered_pairs = keypoints_and_pairs.second;
+    // Sized for the worst case once: on a frame arena every regrowth would leave the old buffer behind
+    filtered_keypoints.reserve(filtered_decodings.size() * PoseProposals::NUM_KEYPOINTS);
+    filtered_pairs.reserve(filtered_decodings.size() * JOINT_PAIRS.size());
 
     for (auto& dec : filtered_decodings){
-        auto keypoint_coordinates_and_score = dec.keypoints;
-        auto coordinates = keypoint_coordinates_and_score.first;
-        auto score = keypoint_coordinates_and_score.second;
+        const auto &coordinates = dec.keypoints.first;
+        const auto &score = dec.keypoints.second;
         
         // Filter keypoints
         for (int i = 0; i < score.shape(0); i++){
@@ -61,254 +66,313 @@ std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter_keypoints(std::vect
         }
     }
 
-    return std::make_pair(filtered_keypoints, filtered_pairs);
+    return keypoints_and_pairs;
 }
 
-float iou_calc(const HailoBBox &box_1, const HailoBBox &box_2)
+/**
+ * @brief Decodes the box and keypoints of a single anchor straight from the quantized tensors.
+ *        Writes into slot `index` of the preallocated SoA buffers.
+ *        Geometry is a common::Dfl16Geometry or common::DynamicGeometry (see dispatch_geometry).
+ */
+template <typename Geometry>
+void decode_proposal(const Geometry &geometry, const uint8_t *box_data, const uint8_t *keypoints_data,
+                     const common::QuantLut &box_lut, const common::QuantLut &keypoint_lut,
+                     float keypoint_scale, float center_x, float center_y, float stride,
+                     float confidence, PoseProposals &proposals, size_t index)
 {
-    const float width_of_overlap_area = std::min(box_1.xmax(), box_2.xmax()) - std::max(box_1.xmin(), box_2.xmin());
-    const float height_of_overlap_area = std::min(box_1.ymax(), box_2.ymax()) - std::max(box_1.ymin(), box_2.ymin());
-    const float positive_width_of_overlap_area = std::max(width_of_overlap_area, 0.0f);
-    const float positive_height_of_overlap_area = std::max(height_of_overlap_area, 0.0f);
-    const float area_of_overlap = positive_width_of_overlap_area * positive_height_of_overlap_area;
-    const float box_1_area = (box_1.ymax() - box_1.ymin()) * (box_1.xmax() - box_1.xmin());
-    const float box_2_area = (box_2.ymax() - box_2.ymin()) * (box_2.xmax() - box_2.xmin());
-    return area_of_overlap / (box_1_area + box_2_area - area_of_overlap);
-}
-
-std::vector<Decodings> nms(std::vector<Decodings> &decodings, const float iou_thr, bool should_nms_cross_classes = false) {
-    std::vector<Decodings> decodings_after_nms;
-    for (uint index = 0; index < decodings.size(); index++)
-    {
-        if (decodings[index].detection_box.get_confidence() != 0.0f)
-        {
-            for (uint jindex = index + 1; jindex < decodings.size(); jindex++)
-            {
-                if ((should_nms_cross_classes || (decodings[index].detection_box.get_class_id() == decodings[jindex].detection_box.get_class_id())) &&
-                    decodings[jindex].detection_box.get_confidence() != 0.0f)
-                {
-                    float iou = iou_calc(decodings[index].detection_box.get_bbox(), decodings[jindex].detection_box.get_bbox());
-                    if (iou >= iou_thr)
-                    {
-                        decodings[jindex].detection_box.set_confidence(0.0f);
-                    }
-                }
-            }
-        }
+    // --- Decode bounding box ---
+    // Each side is a distribution over regression_length + 1 bins, laid out side after side.
+    float distances[4];
+    for (int side = 0; side < 4; side++)
+        distances[side] = geometry.dfl(box_data + side * geometry.bins(), box_lut) * stride;
+
+    proposals.xmin[index] = (center_x - distances[0]) * geometry.inv_width();
+    proposals.ymin[index] = (center_y - distances[1]) * geometry.inv_height();
+    proposals.xmax[index] = (center_x + distances[2]) * geometry.inv_width();
+    proposals.ymax[index] = (center_y + distances[3]) * geometry.inv_height();
+    proposals.scores[index] = confidence;
+
+    // --- Decode keypoints ---
+    // Keypoints are (x, y, score) triplets normalized by 255 (keypoint_lut); offsets are amplified by keypoint_scale.
+    float *kpts_x = &proposals.keypoints_x[index * PoseProposals::NUM_KEYPOINTS];
+    float *kpts_y = &proposals.keypoints_y[index * PoseProposals::NUM_KEYPOINTS];
+    float *kpts_scores = &proposals.keypoints_scores[index * PoseProposals::NUM_KEYPOINTS];
+    for (size_t k = 0; k < PoseProposals::NUM_KEYPOINTS; k++) {
+        const uint8_t *kpt = keypoints_data + k * 3;
+        kpts_x[k] = stride * (keypoint_lut.dequantized[kpt[0]] * keypoint_scale - 0.5f) + center_x;
+        kpts_y[k] = stride * (keypoint_lut.dequantized[kpt[1]] * keypoint_scale - 0.5f) + center_y;
+        kpts_scores[k] = keypoint_lut.sigmoid[kpt[2]];
     }
-    for (uint index = 0; index < decodings.size(); index++)
-    {
-        if (decodings[index].detection_box.get_confidence() != 0.0f)
-        {
-            decodings_after_nms.push_back(Decodings{decodings[index].detection_box, decodings[index].keypoints, decodings[index].joint_pairs});
-        }
-    }
-    return decodings_after_nms;
 }
 
-float dequantize_value(uint8_t val, float32_t qp_scale, float32_t qp_zp){
-    return (float(val) - qp_zp) * qp_scale;
-}
-
-void dequantize_box_values(xt::xarray<float>& dequantized_outputs, int index, 
-                        xt::xarray<uint8_t>& quantized_outputs,
-                        size_t dim1, size_t dim2, float32_t qp_scale, float32_t qp_zp){
-    for (size_t i = 0; i < dim1; i++){
-        for (size_t j = 0; j < dim2; j++){
-            dequantized_outputs(i, j) = dequantize_value(quantized_outputs(index, i, j), qp_scale, qp_zp);
-        }
-    }
-}
+/**
+ * @brief Buffers and tables reused across frames, the buffers only grow. Each postprocess thread
+ *        has its own, so filter() may run on several threads at once, and the anchor grid and box
+ *        tables are looked up in the process-wide caches only when the model changes.
+ */
+struct PoseWorkspace {
+    PoseProposals proposals;
+    common::NmsEngine nms_engine;
+    common::AnchorGridSlot grid;
+    common::QuantLutSlots box_luts;     // One per output level
+};
 
-std::vector<xt::xarray<double>> get_centers(std::vector<int>& strides, std::vector<int>& network_dims,
-                                        std::size_t boxes_num, int strided_width, int strided_height){
-    std::vector<xt::xarray<double>> centers(boxes_num);
-    for (uint i = 0; i < boxes_num; i++) {
-        strided_width = network_dims[0] / strides[i];
-        strided_height = network_dims[1] / strides[i];
-        xt::xarray<int> grid_x = xt::arange(0, strided_width);
-        xt::xarray<int> grid_y = xt::arange(0, strided_height);
-        auto mesh = xt::meshgrid(grid_x, grid_y);
-        grid_x = std::get<1>(mesh);
-        grid_y = std::get<0>(mesh);
-        auto ct_row = (xt::flatten(grid_y) + 0.5) * strides[i];
-        auto ct_col = (xt::flatten(grid_x) + 0.5) * strides[i];
-        centers[i] = xt::stack(xt::xtuple(ct_col, ct_row, ct_col, ct_row), 1);
-    }
-    return centers;
+static PoseWorkspace &thread_workspace()
+{
+    thread_local PoseWorkspace workspace;
+    return workspace;
 }
 
-std::vector<Decodings> decode_boxes_and_keypoints(std::vector<HailoTensorPtr> raw_boxes_outputs,
-                                                    xt::xarray<float> scores,
-                                                    std::vector<HailoTensorPtr> raw_keypoints,
-                                                    std::vector<int> network_dims,
-                                                    std::vector<int> strides,
-                                                    int regression_length) {
-    int strided_width, strided_height, class_index;
-    std::vector<Decodings> decodings;
-    std::vector<PairPairs> joint_pairs;
-    int instance_index = 0;
-    float confidence = 0.0;
-    std::string label;
-    auto centers = get_centers(strides, network_dims, raw_boxes_outputs.size(), strided_width, strided_height);
-    auto regression_distance =  xt::reshape_view(xt::arange(0, regression_length + 1), {1, 1, regression_length + 1});
-
-    // Debug: Print the number of proposals from boxes and keypoints
-    for (uint i = 0; i < raw_boxes_outputs.size(); i++) {
-        auto output_b = common::get_xtensor(raw_boxes_outputs[i]);
-        int num_proposals = output_b.shape(0) * output_b.shape(1);
-        auto output_keypoints = common::get_xtensor(raw_keypoints[i]);        
-        int num_proposals_keypoints = output_keypoints.shape(0) * output_keypoints.shape(1);
-        std::cout << "For stream " << i << " - Number of proposals from boxes: " << num_proposals << std::endl;
-        std::cout << "For stream " << i << " - Number of proposals from keypoints: " << num_proposals_keypoints << std::endl;
+void decode_boxes_and_keypoints(const std::pmr::vector<common::TensorView> &raw_boxes_outputs,
+                                std::pmr::vector<common::Candidate> &candidates,
+                                const std::pmr::vector<common::TensorView> &raw_keypoints,
+                                const PosePostprocessConfig &config,
+                                const FrameDeadline &deadline,
+                                PoseWorkspace &workspace,
+                                PoseFrameStats &stats) {
+    // Anchor centers depend only on the geometry, they are built once and shared across frames
+    const common::ModelDescriptor &model = config.model;
+    const common::AnchorGrid &grid = workspace.grid.get(model.network_dims(), model.strides);
+    PoseProposals &proposals = workspace.proposals;
+    proposals.count = 0;
+    proposals.reserve(candidates.size());
+
+    // Tables are built once per quantization and shared across frames
+    static const auto keypoint_lut = common::QuantLutCache::get(1.0f / 255.0f, 0.0f);
+
+    if constexpr (common::trace_enabled<common::TraceLevel::FRAME>()) {
+        for (uint i = 0; i < raw_boxes_outputs.size(); i++)
+            common::trace<common::TraceLevel::FRAME>(common::TraceEvent::STREAM_PROPOSALS, i, static_cast<uint32_t>(raw_boxes_outputs[i].anchors()));
     }
 
-    for (uint i = 0; i < raw_boxes_outputs.size(); i++) {
-        // Boxes setup
-        float32_t qp_scale = raw_boxes_outputs[i]->vstream_info().quant_info.qp_scale;
-        float32_t qp_zp = raw_boxes_outputs[i]->vstream_info().quant_info.qp_zp;
-        auto output_b = common::get_xtensor(raw_boxes_outputs[i]);
-        int num_proposals = output_b.shape(0) * output_b.shape(1);
-        auto output_boxes = xt::view(output_b, xt::all(), xt::all(), xt::all());
-        xt::xarray<uint8_t> quantized_boxes = xt::reshape_view(output_boxes, {num_proposals, 4, regression_length + 1});
-        auto shape = {quantized_boxes.shape(1), quantized_boxes.shape(2)};
-
-        // --- Keypoints Setup ---
-        // Retrieve the keypoints tensor, reinterpret as FLOAT32, and normalize.
-        auto output_keypoints = common::get_xtensor(raw_keypoints[i]);
-        int num_proposals_keypoints = output_keypoints.shape(0) * output_keypoints.shape(1);
-        xt::xarray<float> keypoints_data = xt::reshape_view(output_keypoints, {num_proposals_keypoints, 17, 3});
-        keypoints_data = keypoints_data / 255.0f;  // Normalize to [0, 1]
-
-        for (uint j = 0; j < num_proposals; j++) {
-            confidence = xt::row(scores, instance_index)(0);
-            instance_index++;
-            if (confidence < SCORE_THRESHOLD)
-                continue;
-
-            // --- Decode bounding box ---
-            xt::xarray<float> box(shape);
-            dequantize_box_values(box, j, quantized_boxes, box.shape(0), box.shape(1), qp_scale, qp_zp);
-            common::softmax_2D(box.data(), box.shape(0), box.shape(1));
-            auto box_distance = box * regression_distance;
-            xt::xarray<float> reduced_distances = xt::sum(box_distance, {2});
-            auto strided_distances = reduced_distances * strides[i];
-            auto distance_view1 = xt::view(strided_distances, xt::all(), xt::range(_, 2)) * -1;
-            auto distance_view2 = xt::view(strided_distances, xt::all(), xt::range(2, _));
-            auto distance_view = xt::concatenate(xt::xtuple(distance_view1, distance_view2), 1);
-            auto decoded_box = centers[i] + distance_view;
-            HailoBBox bbox(decoded_box(j, 0) / network_dims[0],
-                           decoded_box(j, 1) / network_dims[1],
-                           (decoded_box(j, 2) - decoded_box(j, 0)) / network_dims[0],
-                           (decoded_box(j, 3) - decoded_box(j, 1)) / network_dims[1]);
-            label = common::coco_eighty[class_index + 1];
-            HailoDetection detected_instance(bbox, class_index, label, confidence);
-
-            // --- Decode keypoints ---
-            xt::xarray<float> kpts_corrdinates_and_scores = xt::view(keypoints_data, j);
-            // Debug: Print raw keypoints for the current proposal
-            std::cout << "Proposal " << j << " raw keypoints:" << std::endl;
-            for (size_t k = 0; k < kpts_corrdinates_and_scores.shape(0); k++) {
-                std::cout << "  Keypoint " << k << ": (" 
-                          << kpts_corrdinates_and_scores(k, 0) << ", " 
-                          << kpts_corrdinates_and_scores(k, 1) << ") score: " 
-                          << kpts_corrdinates_and_scores(k, 2) << std::endl;
+    // Only the candidates that passed the quantized score threshold are dequantized and decoded.
+    // They arrive sorted by score, so stopping on the budget keeps the best ones; the clock is read
+    // once every FrameDeadline::CHECK_INTERVAL candidates.
+    // The default 16-bin DFL gets a decoder with the bin count fixed at compile time.
+    common::dispatch_geometry(model, [&](const auto &geometry) {
+        for (const auto &candidate : candidates) {
+            if (0 == proposals.count % FrameDeadline::CHECK_INTERVAL && deadline.expired()) {
+                stats.degraded = true;
+                break;
             }
-            auto kpts_corrdinates = xt::view(kpts_corrdinates_and_scores, xt::all(), xt::range(0, 2));
-            auto keypoints_scores = xt::view(kpts_corrdinates_and_scores, xt::all(), xt::range(2, xt::placeholders::_));
-            // Amplify the offsets if they are too small.
-            kpts_corrdinates *= KEYPOINT_SCALE;
-            auto center = xt::view(centers[i], xt::all(), xt::range(0, 2));
-            auto center_values = xt::xarray<float>{(float)center(j,0), (float)center(j,1)};
-            kpts_corrdinates = strides[i] * (kpts_corrdinates - 0.5) + center_values;
-            // Debug: Print transformed keypoints for proposal j
-            std::cout << "Proposal " << j << " transformed keypoints:" << std::endl;
-            for (size_t k = 0; k < kpts_corrdinates.shape(0); k++) {
-                std::cout << "  Keypoint " << k << ": (" 
-                          << kpts_corrdinates(k, 0) << ", " 
-                          << kpts_corrdinates(k, 1) << ")" << std::endl;
+            const uint32_t i = candidate.stride_index;
+            const size_t j = candidate.index;
+            const uint8_t *box_data = raw_boxes_outputs[i].anchor<uint8_t>(j);
+            const uint8_t *keypoints_data = raw_keypoints[i].anchor<uint8_t>(j);
+            auto centers = grid.centers(i);
+            const common::QuantLut &box_lut = workspace.box_luts.get(i, raw_boxes_outputs[i].qp_scale(), raw_boxes_outputs[i].qp_zp());
+
+            size_t index = proposals.count++;
+            decode_proposal(geometry, box_data, keypoints_data, box_lut, *keypoint_lut,
+                            config.keypoint_scale, centers[2 * j], centers[2 * j + 1],
+                            static_cast<float>(model.strides[i]), candidate.score, proposals, index);
+            proposals.class_ids[index] = candidate.class_id;
+
+            common::trace<common::TraceLevel::PROPOSAL>(common::TraceEvent::PROPOSAL, i, static_cast<uint32_t>(j),
+                                                        proposals.xmin[index], proposals.ymin[index],
+                                                        proposals.xmax[index], proposals.ymax[index]);
+            if constexpr (common::trace_enabled<common::TraceLevel::KEYPOINT>()) {
+                for (size_t k = 0; k < PoseProposals::NUM_KEYPOINTS; k++) {
+                    size_t offset = index * PoseProposals::NUM_KEYPOINTS + k;
+                    common::trace<common::TraceLevel::KEYPOINT>(common::TraceEvent::KEYPOINT, static_cast<uint32_t>(j), static_cast<uint32_t>(k),
+                                                                proposals.keypoints_x[offset], proposals.keypoints_y[offset],
+                                                                proposals.keypoints_scores[offset]);
+                }
             }
-            auto sigmoided_scores = 1 / (1 + xt::exp(-keypoints_scores));
-            auto keypoint = std::make_pair(kpts_corrdinates, sigmoided_scores);
-            decodings.push_back(Decodings{detected_instance, keypoint, joint_pairs});
+        }
+    });
+}
+
+/**
+ * @brief Materializes the NMS survivors into Decodings for keypoint filtering.
+ *        Keypoint payloads are copied out of the SoA buffers only for the kept proposals.
+ */
+std::pmr::vector<Decodings> proposals_to_decodings(const PoseProposals &proposals, std::span<const uint32_t> keep,
+                                                   std::pmr::memory_resource *memory)
+{
+    std::pmr::vector<Decodings> decodings(memory);
+    decodings.reserve(keep.size());
+    for (size_t n : keep) {
+        HailoBBox bbox(proposals.xmin[n], proposals.ymin[n],
+                       proposals.xmax[n] - proposals.xmin[n],
+                       proposals.ymax[n] - proposals.ymin[n]);
+        decodings.push_back(Decodings{bbox, proposals.class_ids[n], proposals.scores[n], {}});
+
+        auto &coordinates = decodings.back().keypoints.first;
+        auto &keypoint_scores = decodings.back().keypoints.second;
+        for (size_t k = 0; k < PoseProposals::NUM_KEYPOINTS; k++) {
+            coordinates(k, 0) = proposals.keypoints_x[n * PoseProposals::NUM_KEYPOINTS + k];
+            coordinates(k, 1) = proposals.keypoints_y[n * PoseProposals::NUM_KEYPOINTS + k];
+            keypoint_scores(k, 0) = proposals.keypoints_scores[n * PoseProposals::NUM_KEYPOINTS + k];
         }
     }
     return decodings;
 }
 
-Triple get_boxes_scores_keypoints(std::vector<HailoTensorPtr> &tensors, int num_classes, int regression_length){
-    std::vector<HailoTensorPtr> outputs_boxes(tensors.size() / 3);
-    std::vector<HailoTensorPtr> outputs_keypoints(tensors.size() / 3);
-    int total_scores = 0;
-    for (uint i = 0; i < tensors.size(); i = i + 3) { 
-        total_scores += tensors[i+1]->width() * tensors[i+1]->height(); 
-    }
-    std::vector<size_t> scores_shape = { (long unsigned int)total_scores, (long unsigned int)num_classes};
-    xt::xarray<float> scores(scores_shape);
-    int view_index_scores = 0;
+Triple get_boxes_scores_keypoints(std::pmr::vector<HailoTensorPtr> &tensors, const PosePostprocessConfig &config,
+                                  std::pmr::memory_resource *memory){
+    // Built in place: copying a pmr vector out would allocate the copy from the default resource
+    Triple outputs{std::pmr::vector<common::TensorView>(tensors.size() / 3, memory),
+                   std::pmr::vector<common::Candidate>(memory),
+                   std::pmr::vector<common::TensorView>(tensors.size() / 3, memory)};
+    outputs.candidates.reserve(config.max_candidates);
     for (uint i = 0; i < tensors.size(); i = i + 3) {
-        outputs_boxes[i / 3] = tensors[i];
-        auto dequantized_output_s = common::dequantize(common::get_xtensor(tensors[i+1]), 
-                                                        tensors[i+1]->vstream_info().quant_info.qp_scale, 
-                                                        tensors[i+1]->vstream_info().quant_info.qp_zp);
-        int num_proposals_scores = dequantized_output_s.shape(0)*dequantized_output_s.shape(1);
-        auto output_scores = xt::view(dequantized_output_s, xt::all(), xt::all(), xt::all());
-        xt::view(scores, xt::range(view_index_scores, view_index_scores + num_proposals_scores), xt::all()) = xt::reshape_view(output_scores, {num_proposals_scores, num_classes});
-        view_index_scores += num_proposals_scores;
-        outputs_keypoints[i / 3] = tensors[i+2];
+        outputs.boxes[i / 3] = common::TensorView(tensors[i]);
+        // Scores are compared in the quantized domain, only survivors are dequantized
+        common::TensorView scores(tensors[i+1]);
+        common::gather_candidates(scores.data_uint8(), scores.anchors(), config.model.num_classes,
+                                  common::quantize_threshold(config.model.score_threshold, scores.qp_scale(), scores.qp_zp()),
+                                  scores.qp_scale(), scores.qp_zp(), i / 3, outputs.candidates);
+        outputs.keypoints[i / 3] = common::TensorView(tensors[i+2]);
     }
-    return Triple{outputs_boxes, scores, outputs_keypoints};
+    return outputs;
 }
 
-std::vector<Decodings> yolov8pose_postprocess(std::vector<HailoTensorPtr> &tensors,
-                                std::vector<int> network_dims,
-                                std::vector<int> strides,
-                                int regression_length,
-                                int num_classes)
+/**
+ * @brief Keeps the max_candidates best candidates and orders them by descending score.
+ *        Bounds the decode and NMS work no matter how many anchors pass the threshold.
+ */
+void select_top_candidates(std::pmr::vector<common::Candidate> &candidates, size_t max_candidates, PoseFrameStats &stats)
 {
-    std::vector<Decodings> decodings;
+    auto by_score = [](const common::Candidate &a, const common::Candidate &b) { return a.score > b.score; };
+    if (max_candidates > 0 && candidates.size() > max_candidates) {
+        stats.dropped_candidates = candidates.size() - max_candidates;
+        std::nth_element(candidates.begin(), candidates.begin() + max_candidates, candidates.end(), by_score);
+        candidates.resize(max_candidates);
+    }
+    std::sort(candidates.begin(), candidates.end(), by_score);
+}
+
+std::pmr::vector<Decodings> yolov8pose_postprocess(std::pmr::vector<HailoTensorPtr> &tensors,
+                                                   const PosePostprocessConfig &config,
+                                                   PoseFrameStats &stats,
+                                                   std::pmr::memory_resource *memory)
+{
+    FrameDeadline deadline(config.time_budget);
+    std::pmr::vector<Decodings> decodings(memory);
     if (tensors.size() == 0)
     {
         return decodings;
     }
-    Triple boxes_scores_keypoints = get_boxes_scores_keypoints(tensors, num_classes, regression_length);
-    std::vector<HailoTensorPtr> raw_boxes = boxes_scores_keypoints.boxes;
-    xt::xarray<float> scores = boxes_scores_keypoints.scores;
-    std::vector<HailoTensorPtr> raw_keypoints = boxes_scores_keypoints.keypoints;
-    decodings = decode_boxes_and_keypoints(raw_boxes, scores, raw_keypoints, network_dims, strides, regression_length);
-    auto decodings_after_nms = nms(decodings, IOU_THRESHOLD, true);
-    return decodings_after_nms;
+    const auto decode_start = std::chrono::steady_clock::now();
+    Triple boxes_scores_keypoints = get_boxes_scores_keypoints(tensors, config, memory);
+    const std::pmr::vector<common::TensorView> &raw_boxes = boxes_scores_keypoints.boxes;
+    std::pmr::vector<common::Candidate> &candidates = boxes_scores_keypoints.candidates;
+    const std::pmr::vector<common::TensorView> &raw_keypoints = boxes_scores_keypoints.keypoints;
+    stats.candidates = candidates.size();
+    select_top_candidates(candidates, config.max_candidates, stats);
+
+    PoseWorkspace &workspace = thread_workspace();
+    PoseProposals &proposals = workspace.proposals;
+    decode_boxes_and_keypoints(raw_boxes, candidates, raw_keypoints, config, deadline, workspace, stats);
+    const auto nms_start = std::chrono::steady_clock::now();
+    stats.decode_time = nms_start - decode_start;
+
+    // NMS always runs, even out of time: it is bounded by max_candidates, and skipping it would hand
+    // out every duplicate box of the same person
+    std::span<const uint32_t> keep = workspace.nms_engine.run(proposals.nms_boxes(), config.model.iou_threshold, config.nms_cross_classes);
+
+    const auto keypoints_start = std::chrono::steady_clock::now();
+    stats.nms_time = keypoints_start - nms_start;
+
+    size_t detections_count = keep.size();
+    if (config.max_detections > 0)
+        detections_count = std::min(detections_count, config.max_detections);
+    decodings = proposals_to_decodings(proposals, keep.first(detections_count), memory);
+    stats.detections = decodings.size();
+    stats.keypoint_time = std::chrono::steady_clock::now() - keypoints_start;
+    return decodings;
+}
+
+/**
+ * @brief Per-person box and keypoints of the kept decodings, normalized to the network dims.
+ */
+void decodings_to_persons(const std::pmr::vector<Decodings> &decodings, const std::array<int, 2> &network_dims,
+                          std::vector<PersonKeypoints> &persons)
+{
+    persons.clear();
+    persons.reserve(decodings.size());
+    for (auto &dec : decodings) {
+        PersonKeypoints person;
+        person.xmin = dec.box.xmin();
+        person.ymin = dec.box.ymin();
+        person.xmax = dec.box.xmax();
+        person.ymax = dec.box.ymax();
+        person.score = dec.score;
+        person.class_id = dec.class_id;
+        const auto &coordinates = dec.keypoints.first;
+        const auto &score = dec.keypoints.second;
+        for (size_t k = 0; k < person.keypoints.size(); k++) {
+            person.keypoints[k] = KeyPt({coordinates(k, 0) / network_dims[0], coordinates(k, 1) / network_dims[1], score(k, 0)});
+        }
+        persons.push_back(person);
+    }
 }
 
 /**
  * @brief yolov8 postprocess
  *        Provides network specific parameters.
  * 
- * @param roi  -  HailoROIPtr
+ * @param roi     -  HailoROIPtr
  *        The ROI that contains the output tensors.
+ * @param config  -  PosePostprocessConfig
+ *        Network geometry, thresholds and latency bounds.
+ * @param stats   -  PoseFrameStats
+ *        Filled with the per-frame counters and the degraded flag.
+ * @param persons -  std::vector<PersonKeypoints>*
+ *        Optional, filled with the box and all keypoints of every person.
+ * @param memory  -  std::pmr::memory_resource*
+ *        Source of the frame's temporaries and of the returned vectors.
  */
-std::pair<std::vector<KeyPt>, std::vector<PairPairs>> yolov8(HailoROIPtr roi)
+KeypointsAndPairs yolov8(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats,
+                         std::vector<PersonKeypoints> *persons, std::pmr::memory_resource *memory)
 {
-    int regression_length = 15;
-    std::vector<int> strides = {8, 16, 32};
-    std::vector<int> network_dims = {640, 640};
-    std::vector<HailoTensorPtr> tensors = roi->get_tensors();
-    auto filtered_decodings = yolov8pose_postprocess(tensors, network_dims, strides, regression_length, NUM_CLASSES);
-    std::vector<HailoDetection> detections;
+    stats = PoseFrameStats();
+    std::pmr::vector<HailoTensorPtr> tensors = roi->get_tensors(memory);
+    auto filtered_decodings = yolov8pose_postprocess(tensors, config, stats, memory);
     for (auto& dec : filtered_decodings){
-        detections.push_back(dec.detection_box);
+        hailo_common::add_object(roi, std::make_shared<HailoDetection>(dec.box, dec.class_id, common::coco_eighty[dec.class_id + 1], dec.score));
     }
-    hailo_common::add_detections(roi, detections);
-    std::pair<std::vector<KeyPt>, std::vector<PairPairs>> keypoints_and_pairs = filter_keypoints(filtered_decodings, network_dims);
+    const auto keypoints_start = std::chrono::steady_clock::now();
+    if (persons)
+        decodings_to_persons(filtered_decodings, config.model.network_dims(), *persons);
+    KeypointsAndPairs keypoints_and_pairs = filter_keypoints(filtered_decodings, config.model.network_dims(), config.joint_threshold, memory);
+    stats.keypoint_time += std::chrono::steady_clock::now() - keypoints_start;
     return keypoints_and_pairs;
 }
 
+// Copies the results out for the callers that keep them past the frame
+std::pair<std::vector<KeyPt>, std::vector<PairPairs>> to_std_vectors(const KeypointsAndPairs &keypoints_and_pairs)
+{
+    return std::make_pair(std::vector<KeyPt>(keypoints_and_pairs.first.begin(), keypoints_and_pairs.first.end()),
+                          std::vector<PairPairs>(keypoints_and_pairs.second.begin(), keypoints_and_pairs.second.end()));
+}
+
 //******************************************************************
 //  DEFAULT FILTER
 //******************************************************************
 std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter(HailoROIPtr roi)
 {
-    return yolov8(roi);
+    static const PosePostprocessConfig config;
+    PoseFrameStats stats;
+    return to_std_vectors(yolov8(roi, config, stats, nullptr, std::pmr::get_default_resource()));
+}
+
+std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats)
+{
+    return to_std_vectors(yolov8(roi, config, stats, nullptr, std::pmr::get_default_resource()));
+}
+
+std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats,
+                                                            std::vector<PersonKeypoints> &persons)
+{
+    return to_std_vectors(yolov8(roi, config, stats, &persons, std::pmr::get_default_resource()));
+}
+
+KeypointsAndPairs filter(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats,
+                         std::vector<PersonKeypoints> &persons, std::pmr::memory_resource *memory)
+{
+    return yolov8(roi, config, stats, &persons, memory);
 }
 
 
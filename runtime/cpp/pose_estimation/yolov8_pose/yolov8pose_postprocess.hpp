@@ -5,36 +5,142 @@
 #pragma once
 #include "common/hailo_objects.hpp"
 #include "common/hailo_common.hpp"
+#include "common/tensors.hpp"
+#include "common/candidates.hpp"
+#include "common/nms_engine.hpp"
+#include "common/model_descriptor.hpp"
+#include "common/frame_arena.hpp"
+#include "pose_keypoints.hpp"
 
+#include <chrono>
+#include <memory_resource>
+
+#include <xtensor/containers/xfixed.hpp>
 #include <xtensor/views/xview.hpp>
 #include <xtensor/misc/xsort.hpp>
 
-struct KeyPt {
-    float xs;
-    float ys;
-    float joints_scores;
+/**
+ * @brief Postprocess parameters, one instance per network.
+ *        `model` holds the geometry and thresholds; fill it from the HEF with common::describe_model.
+ *        max_candidates, max_detections and time_budget bound the per-frame work; 0 disables each of them.
+ *        The time budget only cuts decoding short, NMS always runs on what was decoded.
+ */
+struct PosePostprocessConfig {
+    PosePostprocessConfig()
+    {
+        model.num_classes = 1;
+        model.head_features = 51;       // 17 keypoints of (x, y, score)
+    }
+
+    common::ModelDescriptor model;
+    bool nms_cross_classes = true;
+    float keypoint_scale = 4.0f;        // Scaling factor for keypoints if they appear too clustered
+    float joint_threshold = 0.1f;
+    size_t max_candidates = 300;        // Best candidates kept before decoding and NMS
+    size_t max_detections = 20;         // Detections returned after NMS
+    std::chrono::microseconds time_budget{0};
 };
 
-struct PairPairs {
-    std::pair<float, float> pt1;
-    std::pair<float, float> pt2;
-    float s1;
-    float s2;
+/**
+ * @brief Per-frame postprocess counters.
+ *        `degraded` is set when the time budget ran out and the results are the best found so far
+ *        (not every candidate was decoded).
+ */
+struct PoseFrameStats {
+    size_t candidates = 0;              // Anchors that passed the score threshold
+    size_t dropped_candidates = 0;      // Cut by max_candidates
+    size_t detections = 0;
+    bool degraded = false;
+    std::chrono::nanoseconds decode_time{0};    // Score gather, candidate selection and decoding
+    std::chrono::nanoseconds nms_time{0};
+    std::chrono::nanoseconds keypoint_time{0};  // Decodings of the kept detections and keypoint filtering
+};
+
+/**
+ * @brief Monotonic deadline for one frame; a zero budget never expires.
+ *        Loops check it every CHECK_INTERVAL iterations rather than reading the clock each time.
+ */
+class FrameDeadline {
+public:
+    static constexpr size_t CHECK_INTERVAL = 16;
+
+    explicit FrameDeadline(std::chrono::microseconds budget)
+        : m_enabled(budget.count() > 0), m_deadline(std::chrono::steady_clock::now() + budget) {}
+
+    bool expired() const
+    {
+        return m_enabled && std::chrono::steady_clock::now() >= m_deadline;
+    }
+
+private:
+    bool m_enabled;
+    std::chrono::steady_clock::time_point m_deadline;
 };
 
 struct Triple {
-    std::vector<HailoTensorPtr> boxes;
-    xt::xarray<float> scores;
-    std::vector<HailoTensorPtr> keypoints;
+    std::pmr::vector<common::TensorView> boxes;
+    std::pmr::vector<common::Candidate> candidates;
+    std::pmr::vector<common::TensorView> keypoints;
 };
 
+/**
+ * @brief Structure-of-arrays holding the proposals that passed the score threshold.
+ *        Buffers are sized once for the largest grid and reused across frames.
+ *        Boxes are normalized to the network dims, keypoints are in network pixels.
+ */
+struct PoseProposals {
+    static constexpr size_t NUM_KEYPOINTS = 17;
+
+    std::vector<float> xmin, ymin, xmax, ymax;
+    std::vector<float> scores;
+    std::vector<int> class_ids;
+    std::vector<float> keypoints_x, keypoints_y, keypoints_scores;   // [capacity * NUM_KEYPOINTS]
+    size_t count = 0;
+
+    void reserve(size_t capacity)
+    {
+        if (scores.size() >= capacity)
+            return;
+        for (auto *column : {&xmin, &ymin, &xmax, &ymax, &scores})
+            column->resize(capacity);
+        class_ids.resize(capacity);
+        for (auto *column : {&keypoints_x, &keypoints_y, &keypoints_scores})
+            column->resize(capacity * NUM_KEYPOINTS);
+    }
+
+    common::NmsBoxes nms_boxes() const
+    {
+        return common::NmsBoxes{xmin.data(), ymin.data(), xmax.data(), ymax.data(), scores.data(), class_ids.data(), count};
+    }
+};
+
+/**
+ * @brief One kept detection. Plain values with fixed-size keypoints, so a frame's decodings live
+ *        entirely in the vector that holds them; the HailoDetection is only built when the result
+ *        is attached to the ROI.
+ */
 struct Decodings {
-    HailoDetection detection_box;
-    std::pair<xt::xarray<float>, xt::xarray<float>> keypoints;
-    std::vector<PairPairs> joint_pairs;
+    HailoBBox box;
+    int class_id;
+    float score;
+    std::pair<xt::xtensor_fixed<float, xt::xshape<PoseProposals::NUM_KEYPOINTS, 2>>,
+              xt::xtensor_fixed<float, xt::xshape<PoseProposals::NUM_KEYPOINTS, 1>>> keypoints;
 };
 
+using KeypointsAndPairs = std::pair<std::pmr::vector<KeyPt>, std::pmr::vector<PairPairs>>;
+
 
 __BEGIN_DECLS
 std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter(HailoROIPtr roi);
 __END_DECLS
+
+std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats);
+
+// Also fills `persons`, one entry per detection in descending score order
+std::pair<std::vector<KeyPt>, std::vector<PairPairs>> filter(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats,
+                                                            std::vector<PersonKeypoints> &persons);
+
+// Every temporary and the returned vectors are allocated from `memory`, usually a common::FrameArena
+// reset at the end of the frame. Detections attached to the ROI stay on the heap, they may outlive it.
+KeypointsAndPairs filter(HailoROIPtr roi, const PosePostprocessConfig &config, PoseFrameStats &stats,
+                         std::vector<PersonKeypoints> &persons, std::pmr::memory_resource *memory);